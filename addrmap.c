@@ -0,0 +1,187 @@
+/*
+ * This file is part of hx - a hex editor for the terminal.
+ *
+ * Copyright (c) 2016 Kevin Pors. See LICENSE for details.
+ */
+
+#include "addrmap.h"
+#include "mem.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct addr_map* addr_map_create() {
+	struct addr_map* map = mem_calloc(MEM_INDEX, 1, sizeof(struct addr_map));
+	if (map == NULL) {
+		perror("Could not allocate memory for the address map");
+		abort();
+	}
+	return map;
+}
+
+void addr_map_free(struct addr_map* map) {
+	mem_free(map->ranges);
+	mem_free(map->by_vaddr);
+	mem_free(map);
+}
+
+/*
+ * Returns the amount of ranges starting at or before `offset'.
+ */
+static unsigned int addr_map_count_offset(const struct addr_map* map, uint64_t offset) {
+	unsigned int lo = 0;
+	unsigned int hi = map->count;
+	while (lo < hi) {
+		unsigned int mid = lo + (hi - lo) / 2;
+		if (map->ranges[mid].offset <= offset) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return lo;
+}
+
+/*
+ * Returns the amount of ranges starting at or before virtual address `vaddr'.
+ */
+static unsigned int addr_map_count_vaddr(const struct addr_map* map, uint64_t vaddr) {
+	unsigned int lo = 0;
+	unsigned int hi = map->count;
+	while (lo < hi) {
+		unsigned int mid = lo + (hi - lo) / 2;
+		if (map->ranges[map->by_vaddr[mid]].vaddr <= vaddr) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return lo;
+}
+
+bool addr_map_add(struct addr_map* map, uint64_t offset, uint64_t vaddr, uint64_t size) {
+	if (size == 0 || size > UINT64_MAX - offset || size > UINT64_MAX - vaddr) {
+		return false;
+	}
+
+	// The range before this one must end before it, and the one after it
+	// must start after it; in the file as well as in memory.
+	unsigned int pos = addr_map_count_offset(map, offset);
+	if (pos > 0 && map->ranges[pos - 1].offset + map->ranges[pos - 1].size > offset) {
+		return false;
+	}
+	if (pos < map->count && offset + size > map->ranges[pos].offset) {
+		return false;
+	}
+	unsigned int vpos = addr_map_count_vaddr(map, vaddr);
+	if (vpos > 0) {
+		const struct addr_range* prev = &map->ranges[map->by_vaddr[vpos - 1]];
+		if (prev->vaddr + prev->size > vaddr) {
+			return false;
+		}
+	}
+	if (vpos < map->count && vaddr + size > map->ranges[map->by_vaddr[vpos]].vaddr) {
+		return false;
+	}
+
+	if (map->count == map->cap) {
+		map->cap = map->cap == 0 ? 16 : map->cap * 2;
+		map->ranges = mem_realloc(MEM_INDEX, map->ranges, map->cap * sizeof(struct addr_range));
+		map->by_vaddr = mem_realloc(MEM_INDEX, map->by_vaddr, map->cap * sizeof(unsigned int));
+		if (map->ranges == NULL || map->by_vaddr == NULL) {
+			perror("Could not allocate memory for the address map");
+			abort();
+		}
+	}
+
+	memmove(&map->ranges[pos + 1], &map->ranges[pos], (map->count - pos) * sizeof(struct addr_range));
+	map->ranges[pos].offset = offset;
+	map->ranges[pos].vaddr = vaddr;
+	map->ranges[pos].size = size;
+
+	// The ranges after the new one moved up by one.
+	for (unsigned int i = 0; i < map->count; i++) {
+		if (map->by_vaddr[i] >= pos) {
+			map->by_vaddr[i]++;
+		}
+	}
+	memmove(&map->by_vaddr[vpos + 1], &map->by_vaddr[vpos], (map->count - vpos) * sizeof(unsigned int));
+	map->by_vaddr[vpos] = pos;
+	map->count++;
+	return true;
+}
+
+void addr_map_shift(struct addr_map* map, uint64_t offset, int amount) {
+	if (map->count == 0) {
+		return;
+	}
+	const struct addr_range* last = &map->ranges[map->count - 1];
+	if (last->offset + last->size <= offset) {
+		return;
+	}
+
+	// The pieces the ranges fall apart in are added to the emptied map
+	// again; there are only a few ranges.
+	unsigned int count = map->count;
+	struct addr_range* old = mem_alloc(MEM_INDEX, count * sizeof(struct addr_range));
+	if (old == NULL) {
+		perror("Could not allocate memory for the address map");
+		abort();
+	}
+	memcpy(old, map->ranges, count * sizeof(struct addr_range));
+	map->count = 0;
+
+	for (unsigned int i = 0; i < count; i++) {
+		const struct addr_range* r = &old[i];
+		uint64_t end = r->offset + r->size;
+		if (amount > 0) {
+			if (end <= offset) {
+				addr_map_add(map, r->offset, r->vaddr, r->size);
+			} else if (r->offset >= offset) {
+				addr_map_add(map, r->offset + amount, r->vaddr, r->size);
+			} else {
+				addr_map_add(map, r->offset, r->vaddr, offset - r->offset);
+				addr_map_add(map, offset + amount, r->vaddr + (offset - r->offset), end - offset);
+			}
+			continue;
+		}
+
+		// The bytes before the deleted ones stay, those after them move.
+		uint64_t deleted_end = offset - amount;
+		if (r->offset < offset) {
+			addr_map_add(map, r->offset, r->vaddr, (end < offset ? end : offset) - r->offset);
+		}
+		if (end > deleted_end) {
+			uint64_t start = r->offset > deleted_end ? r->offset : deleted_end;
+			addr_map_add(map, start + amount, r->vaddr + (start - r->offset), end - start);
+		}
+	}
+	mem_free(old);
+}
+
+bool addr_map_to_vaddr(const struct addr_map* map, uint64_t offset, uint64_t* vaddr) {
+	unsigned int n = addr_map_count_offset(map, offset);
+	if (n == 0) {
+		return false;
+	}
+	const struct addr_range* r = &map->ranges[n - 1];
+	if (offset - r->offset >= r->size) {
+		return false;
+	}
+	*vaddr = r->vaddr + (offset - r->offset);
+	return true;
+}
+
+bool addr_map_to_offset(const struct addr_map* map, uint64_t vaddr, uint64_t* offset) {
+	unsigned int n = addr_map_count_vaddr(map, vaddr);
+	if (n == 0) {
+		return false;
+	}
+	const struct addr_range* r = &map->ranges[map->by_vaddr[n - 1]];
+	if (vaddr - r->vaddr >= r->size) {
+		return false;
+	}
+	*offset = r->offset + (vaddr - r->vaddr);
+	return true;
+}
@@ -0,0 +1,70 @@
+/*
+ * This file is part of hx - a hex editor for the terminal.
+ *
+ * Copyright (c) 2016 Kevin Pors. See LICENSE for details.
+ */
+
+#ifndef HX_ADDRMAP_H
+#define HX_ADDRMAP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * A map from offsets in a file to the virtual addresses they are loaded at,
+ * like the segments of an executable. Ranges overlap neither in the file nor
+ * in memory, so a range is found with a binary search either way: `ranges'
+ * is sorted by offset, and `by_vaddr' holds their indices sorted by virtual
+ * address. Translating the address of every row of a frame is cheap.
+ */
+
+struct addr_range {
+	uint64_t offset; // offset in the file.
+	uint64_t vaddr;  // the virtual address the offset is loaded at.
+	uint64_t size;
+};
+
+struct addr_map {
+	struct addr_range* ranges; // sorted by offset.
+	unsigned int* by_vaddr;    // indices of the ranges, sorted by virtual address.
+	unsigned int count;
+	unsigned int cap;
+};
+
+/*
+ * Creates an empty map.
+ */
+struct addr_map* addr_map_create();
+
+/*
+ * Frees the map.
+ */
+void addr_map_free(struct addr_map* map);
+
+/*
+ * Maps the `size' bytes at `offset' to `vaddr'. Returns false if the range
+ * is empty, wraps around, or overlaps a range already mapped (in the file or
+ * in memory).
+ */
+bool addr_map_add(struct addr_map* map, uint64_t offset, uint64_t vaddr, uint64_t size);
+
+/*
+ * Adjusts the map for `amount' bytes inserted (positive) or deleted
+ * (negative) at `offset'. A range they fall in is split, so every byte keeps
+ * its virtual address, and the inserted bytes are not mapped.
+ */
+void addr_map_shift(struct addr_map* map, uint64_t offset, int amount);
+
+/*
+ * Translates `offset' to the virtual address it's mapped at. Returns false
+ * if it's not mapped.
+ */
+bool addr_map_to_vaddr(const struct addr_map* map, uint64_t offset, uint64_t* vaddr);
+
+/*
+ * Translates the virtual address `vaddr' to the offset mapped there. Returns
+ * false if nothing is mapped there.
+ */
+bool addr_map_to_offset(const struct addr_map* map, uint64_t vaddr, uint64_t* offset);
+
+#endif // HX_ADDRMAP_H
@@ -0,0 +1,405 @@
+/*
+ * This file is part of hx - a hex editor for the terminal.
+ *
+ * Copyright (c) 2016 Kevin Pors. See LICENSE for details.
+ */
+
+/*
+ * Benchmark harness for the editor core. It runs without a terminal: files of
+ * various sizes are generated, opened, rendered into a charbuf, searched and
+ * edited, and every benchmark prints one JSON object per line with the
+ * throughput and latency percentiles of the operations measured.
+ *
+ * Build and run it with `make bench'. See print_help() for the options.
+ */
+
+// clock_gettime() and mkstemp() are part of POSIX.1-2008. The Makefile
+// defines _POSIX_SOURCE, which would otherwise limit us to POSIX.1.
+#define _XOPEN_SOURCE 700
+#define _POSIX_C_SOURCE 200809L
+
+#include "charbuf.h"
+#include "editor.h"
+#include "render.h"
+#include "search.h"
+
+#include <inttypes.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// Planted near the start and the end of every generated file. The remainder
+// is pseudo random, so this needle occurs nowhere else.
+static const char BENCH_NEEDLE[] = "hx-bench-needle";
+static const uint64_t BENCH_NEEDLE_DISTANCE = 64;
+
+// Screen size used when rendering.
+static const int BENCH_ROWS = 50;
+static const int BENCH_COLS = 300;
+
+// Maximum amount of file sizes given on the command line.
+#define BENCH_MAX_SIZES 16
+
+/*
+ * Latencies of the operations of a benchmark, in nanoseconds.
+ */
+struct samples {
+	uint64_t* ns;
+	size_t count;
+	size_t cap;
+};
+
+static uint64_t now_ns() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/*
+ * xorshift64, to generate data and offsets which are the same on every run.
+ */
+static uint64_t next_random(uint64_t* state) {
+	uint64_t x = *state;
+	x ^= x << 13;
+	x ^= x >> 7;
+	x ^= x << 17;
+	return *state = x;
+}
+
+static void samples_add(struct samples* s, uint64_t ns) {
+	if (s->count == s->cap) {
+		s->cap = s->cap == 0 ? 1024 : s->cap * 2;
+		s->ns = realloc(s->ns, s->cap * sizeof(uint64_t));
+		if (s->ns == NULL) {
+			perror("Could not allocate memory for samples");
+			abort();
+		}
+	}
+	s->ns[s->count++] = ns;
+}
+
+static int compare_u64(const void* a, const void* b) {
+	uint64_t x = *(const uint64_t*) a;
+	uint64_t y = *(const uint64_t*) b;
+	return x < y ? -1 : x > y;
+}
+
+/*
+ * Returns the p-th percentile (nearest rank) of the sorted samples in
+ * microseconds.
+ */
+static double percentile(const struct samples* s, unsigned int p) {
+	size_t rank = (s->count * p + 99) / 100;
+	return s->ns[rank > 0 ? rank - 1 : 0] / 1000.0;
+}
+
+/*
+ * Prints the results of a benchmark as a JSON object on a single line, and
+ * clears the samples. `params' are extra members describing the benchmark,
+ * `bytes' the total amount of bytes processed by all operations.
+ */
+static void report(const char* name, uint64_t size, const char* params, struct samples* s, uint64_t bytes) {
+	if (s->count == 0) {
+		return;
+	}
+	qsort(s->ns, s->count, sizeof(uint64_t), compare_u64);
+	uint64_t total = 0;
+	for (size_t i = 0; i < s->count; i++) {
+		total += s->ns[i];
+	}
+	double seconds = total / 1e9;
+
+	printf("{\"bench\":\"%s\",\"size\":%" PRIu64 "%s%s,\"ops\":%zu,\"total_ms\":%.3f,"
+	       "\"ops_per_s\":%.1f,\"mb_per_s\":%.1f,"
+	       "\"p50_us\":%.2f,\"p90_us\":%.2f,\"p99_us\":%.2f,\"max_us\":%.2f}\n",
+		name, size, params[0] != '\0' ? "," : "", params, s->count, seconds * 1000,
+		seconds > 0 ? s->count / seconds : 0, seconds > 0 ? bytes / seconds / (1024 * 1024) : 0,
+		percentile(s, 50), percentile(s, 90), percentile(s, 99), percentile(s, 100));
+	fflush(stdout);
+	s->count = 0;
+}
+
+/*
+ * Generates a file of `size' bytes of pseudo random data in `dir', with the
+ * needle planted near the start and the end. Returns the path of the file,
+ * which must be freed by the caller.
+ */
+static char* generate_file(const char* dir, uint64_t size) {
+	char* path = malloc(strlen(dir) + 32);
+	if (path == NULL) {
+		perror("Could not allocate memory for the path");
+		abort();
+	}
+	sprintf(path, "%s/hx-bench-XXXXXX", dir);
+	int fd = mkstemp(path);
+	if (fd == -1) {
+		perror("Unable to create a file to benchmark with");
+		exit(1);
+	}
+
+	size_t chunk = 1024 * 1024;
+	uint64_t* buf = malloc(chunk);
+	if (buf == NULL) {
+		perror("Could not allocate memory for the file data");
+		abort();
+	}
+	uint64_t state = 0x2545f4914f6cdd1d;
+	for (uint64_t written = 0; written < size; ) {
+		for (size_t i = 0; i < chunk / sizeof(uint64_t); i++) {
+			buf[i] = next_random(&state);
+		}
+		size_t n = size - written < chunk ? size - written : chunk;
+		char* p = (char*) buf;
+		uint64_t needles[2] = { BENCH_NEEDLE_DISTANCE, size - BENCH_NEEDLE_DISTANCE };
+		for (int i = 0; i < 2; i++) {
+			if (size >= 2 * BENCH_NEEDLE_DISTANCE && needles[i] >= written && needles[i] < written + n) {
+				memcpy(p + (needles[i] - written), BENCH_NEEDLE, strlen(BENCH_NEEDLE));
+			}
+		}
+		if (write(fd, p, n) != (ssize_t) n) {
+			perror("Unable to write the file to benchmark with");
+			exit(1);
+		}
+		written += n;
+	}
+	free(buf);
+	close(fd);
+	return path;
+}
+
+/*
+ * Opens `path' in a new editor. Files larger than the editor can hold in a
+ * single buffer are opened windowed, by following them.
+ */
+static struct editor* bench_editor(const char* path, uint64_t size) {
+	struct editor* e = editor_init();
+	e->screen_rows = BENCH_ROWS;
+	e->screen_cols = BENCH_COLS;
+	e->follow = size > INT_MAX;
+	editor_openfile(e, path);
+	return e;
+}
+
+static void bench_open(const char* path, uint64_t size) {
+	struct samples s = {0};
+	uint64_t bytes = 0;
+	int reps = size <= 16 * 1024 * 1024 ? 10 : 3;
+	for (int i = 0; i < reps; i++) {
+		uint64_t start = now_ns();
+		struct editor* e = bench_editor(path, size);
+		samples_add(&s, now_ns() - start);
+		bytes += e->content_length;
+		editor_free(e);
+	}
+	report("open", size, size > INT_MAX ? "\"windowed\":true" : "", &s, bytes);
+	free(s.ns);
+}
+
+static void bench_render(struct editor* e, uint64_t size) {
+	static const int layouts[][2] = {
+		{ 16, 2 }, { 16, 4 }, { 16, 8 }, { 32, 4 }, { 32, 8 }, { 64, 8 }, { 188, 4 },
+	};
+	struct samples s = {0};
+	for (size_t l = 0; l < sizeof(layouts) / sizeof(layouts[0]); l++) {
+		e->octets_per_line = layouts[l][0];
+		e->grouping = layouts[l][1];
+		int lines = e->content_length / e->octets_per_line;
+		int frames = 2000;
+		uint64_t frame_bytes = 0;
+		uint64_t state = 42;
+		for (int i = 0; i < frames; i++) {
+			// Jump around the file, like paging through it would.
+			e->line = lines > e->screen_rows ? next_random(&state) % (lines - e->screen_rows) : 0;
+			// Frames are built in the frame arena, like the editor does.
+			mem_arena_reset(&e->frame_arena);
+			struct charbuf* b = charbuf_create_in(&e->frame_arena);
+			uint64_t start = now_ns();
+			editor_render_contents(e, b);
+			samples_add(&s, now_ns() - start);
+			frame_bytes += b->len;
+		}
+		char params[128];
+		snprintf(params, sizeof(params), "\"octets\":%d,\"grouping\":%d,\"kernel\":%s,\"encoder\":\"%s\",\"frame_bytes\":%" PRIu64,
+			e->octets_per_line, e->grouping,
+			render_kernel(e->octets_per_line, e->grouping) != NULL ? "true" : "false",
+			render_encoder(), frame_bytes / frames);
+		// Throughput is measured in bytes of the file rendered.
+		report("render", size, params, &s, (uint64_t) frames * e->screen_rows * e->octets_per_line);
+	}
+	e->line = 0;
+	e->octets_per_line = 16;
+	e->grouping = 4;
+	free(s.ns);
+}
+
+/*
+ * Searches forward and backward, reported as `forward' and `backward'.
+ */
+static void bench_search_both(struct editor* e, uint64_t size, const char* forward,
+                              const char* backward, const char* params) {
+	struct samples s = {0};
+	int reps = size <= 16 * 1024 * 1024 ? 10 : 3;
+	uint64_t bytes = 0;
+
+	// Search from one needle to the other, scanning (nearly) the whole
+	// buffer. When windowed, the search stops at the end of the window.
+	unsigned int first = BENCH_NEEDLE_DISTANCE;
+	unsigned int last = e->content_length - BENCH_NEEDLE_DISTANCE;
+	for (int i = 0; i < reps; i++) {
+		editor_scroll_to_offset(e, first);
+		uint64_t start = now_ns();
+		editor_process_search(e, BENCH_NEEDLE, SEARCH_FORWARD);
+		samples_add(&s, now_ns() - start);
+		bytes += editor_offset_at_cursor(e) > (int) first ? editor_offset_at_cursor(e) - first : e->content_length - first;
+	}
+	report(forward, size, params, &s, bytes);
+
+	bytes = 0;
+	for (int i = 0; i < reps; i++) {
+		editor_scroll_to_offset(e, last);
+		uint64_t start = now_ns();
+		editor_process_search(e, BENCH_NEEDLE, SEARCH_BACKWARD);
+		samples_add(&s, now_ns() - start);
+		bytes += editor_offset_at_cursor(e) < (int) last ? last - editor_offset_at_cursor(e) : last;
+	}
+	report(backward, size, params, &s, bytes);
+	free(s.ns);
+}
+
+static void bench_search(struct editor* e, uint64_t size) {
+	bench_search_both(e, size, "search_forward", "search_backward", "");
+
+	// Records as large as the distance of the needles to the ends, so only
+	// the field the needles start at is compared, with search_strided().
+	e->record_size = BENCH_NEEDLE_DISTANCE;
+	e->record_field = 0;
+	char params[64];
+	snprintf(params, sizeof(params), "\"implementation\":\"%s\"", search_implementation());
+	bench_search_both(e, size, "search_strided_forward", "search_strided_backward", params);
+	e->record_size = 0;
+	e->record_field = -1;
+}
+
+static void bench_edit(struct editor* e, uint64_t size) {
+	struct samples s = {0};
+	int ops = size <= 16 * 1024 * 1024 ? 1000 : 100;
+	uint64_t state = 7;
+
+	for (int i = 0; i < ops; i++) {
+		editor_scroll_to_offset(e, next_random(&state) % e->content_length);
+		uint64_t start = now_ns();
+		editor_insert_byte(e, 'x', false);
+		samples_add(&s, now_ns() - start);
+	}
+	report("insert", size, "", &s, ops);
+
+	for (int i = 0; i < ops; i++) {
+		editor_scroll_to_offset(e, next_random(&state) % e->content_length);
+		uint64_t start = now_ns();
+		editor_delete_char_at_cursor(e);
+		samples_add(&s, now_ns() - start);
+	}
+	report("delete", size, "", &s, ops);
+
+	// Undo everything, then redo everything.
+	for (int i = 0; i < 2 * ops; i++) {
+		uint64_t start = now_ns();
+		editor_undo(e);
+		samples_add(&s, now_ns() - start);
+	}
+	report("undo", size, "", &s, 2 * ops);
+
+	for (int i = 0; i < 2 * ops; i++) {
+		uint64_t start = now_ns();
+		editor_redo(e);
+		samples_add(&s, now_ns() - start);
+	}
+	report("redo", size, "", &s, 2 * ops);
+	free(s.ns);
+}
+
+/*
+ * Parses a size like 4096, 16K, 256M or 4G. Returns 0 if it's invalid.
+ */
+static uint64_t parse_size(const char* s) {
+	char* end = NULL;
+	uint64_t size = strtoull(s, &end, 10);
+	switch (*end) {
+	case 'K': case 'k': size <<= 10; end++; break;
+	case 'M': case 'm': size <<= 20; end++; break;
+	case 'G': case 'g': size <<= 30; end++; break;
+	}
+	return *end == '\0' ? size : 0;
+}
+
+static void print_help(const char* explanation) {
+	fprintf(stderr,
+"%s"
+"usage: hx-bench [-d dir] [-s size]...\n"
+"\n"
+"Benchmarks opening, rendering, searching and editing files of the given\n"
+"sizes, generated in `dir' (default $TMPDIR or /tmp). Sizes may be suffixed\n"
+"with K, M or G, and default to 1M, 16M and 256M. Files larger than 2G are\n"
+"opened windowed. Results are printed as one JSON object per line.\n",
+		explanation);
+}
+
+int main(int argc, char* argv[]) {
+	const char* dir = getenv("TMPDIR") != NULL ? getenv("TMPDIR") : "/tmp";
+	uint64_t sizes[BENCH_MAX_SIZES] = { 1 << 20, 16 << 20, 256 << 20 };
+	int size_count = 0;
+
+	int ch;
+	while ((ch = getopt(argc, argv, "hd:s:")) != -1) {
+		switch (ch) {
+		case 'd':
+			dir = optarg;
+			break;
+		case 's':
+			if (size_count == BENCH_MAX_SIZES) {
+				print_help("error: too many sizes\n");
+				exit(1);
+			}
+			sizes[size_count] = parse_size(optarg);
+			if (sizes[size_count] < 2 * BENCH_NEEDLE_DISTANCE) {
+				print_help("error: invalid size\n");
+				exit(1);
+			}
+			size_count++;
+			break;
+		case 'h':
+			print_help("");
+			exit(0);
+		default:
+			print_help("");
+			exit(1);
+		}
+	}
+	if (size_count == 0) {
+		size_count = 3;
+	}
+
+	for (int i = 0; i < size_count; i++) {
+		char* path = generate_file(dir, sizes[i]);
+
+		bench_open(path, sizes[i]);
+		struct editor* e = bench_editor(path, sizes[i]);
+		bench_render(e, sizes[i]);
+		bench_search(e, sizes[i]);
+		// Windowed buffers cannot be resized.
+		if (!e->windowed) {
+			bench_edit(e, sizes[i]);
+		}
+		editor_free(e);
+
+		unlink(path);
+		free(path);
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,242 @@
+/*
+ * This file is part of hx - a hex editor for the terminal.
+ *
+ * Copyright (c) 2016 Kevin Pors. See LICENSE for details.
+ */
+
+// O_DIRECT and the block device ioctls are Linux specific. pread() and
+// pwrite() are part of POSIX.1-2008.
+#ifdef __linux__
+#define _GNU_SOURCE
+#else
+#define _XOPEN_SOURCE 700
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "blockdev.h"
+#include "mem.h"
+#include "perf.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/fs.h>
+#endif
+
+// Alignment of buffers used for O_DIRECT. A page is enough for any device.
+static const unsigned int BLOCKDEV_ALIGN = 4096;
+
+/*
+ * Opens the device with the given flags, and determines the size and the
+ * sector size. Returns the file descriptor, or -1.
+ */
+static int blockdev_open_fd(struct blockdev* bd, bool direct) {
+	int flags = 0;
+#ifdef O_DIRECT
+	if (direct) {
+		flags |= O_DIRECT;
+	}
+#else
+	(void) direct;
+#endif
+
+	bd->writable = true;
+	int fd = open(bd->path, O_RDWR | flags);
+	if (fd == -1) {
+		bd->writable = false;
+		fd = open(bd->path, O_RDONLY | flags);
+	}
+	return fd;
+}
+
+struct blockdev* blockdev_open(const char* path, bool direct) {
+	struct blockdev* bd = mem_alloc(MEM_OTHER, sizeof(struct blockdev));
+	if (bd == NULL) {
+		perror("Could not allocate memory for blockdev");
+		abort();
+	}
+	bd->path = mem_alloc(MEM_OTHER, strlen(path) + 1);
+	if (bd->path == NULL) {
+		perror("Could not allocate memory for the device path");
+		abort();
+	}
+	strcpy(bd->path, path);
+	bd->direct = direct;
+	bd->size = 0;
+	bd->sector_size = 512;
+	bd->dirty = NULL;
+	bd->dirty_count = 0;
+	bd->dirty_cap = 0;
+
+	bd->fd = blockdev_open_fd(bd, direct);
+	if (bd->fd == -1) {
+		int err = errno;
+		blockdev_free(bd);
+		errno = err;
+		return NULL;
+	}
+
+#ifdef __linux__
+	// stat() reports a size of zero for block devices, so ask the driver.
+	uint64_t size = 0;
+	int sector_size = 0;
+	if (ioctl(bd->fd, BLKGETSIZE64, &size) == 0) {
+		bd->size = size;
+	}
+	if (ioctl(bd->fd, BLKSSZGET, &sector_size) == 0 && sector_size > 0) {
+		bd->sector_size = sector_size;
+	}
+#endif
+	if (bd->size == 0) {
+		off_t end = lseek(bd->fd, 0, SEEK_END);
+		bd->size = end > 0 ? (uint64_t) end : 0;
+	}
+
+	return bd;
+}
+
+void blockdev_free(struct blockdev* bd) {
+	if (bd->fd != -1) {
+		close(bd->fd);
+	}
+	for (unsigned int i = 0; i < bd->dirty_count; i++) {
+		mem_free(bd->dirty[i].data);
+	}
+	mem_free(bd->dirty);
+	mem_free(bd->path);
+	mem_free(bd);
+}
+
+bool blockdev_set_direct(struct blockdev* bd, bool direct) {
+	bool writable = bd->writable;
+	int fd = blockdev_open_fd(bd, direct);
+	if (fd == -1) {
+		bd->writable = writable;
+		return false;
+	}
+	close(bd->fd);
+	bd->fd = fd;
+	bd->direct = direct;
+	return true;
+}
+
+char* blockdev_alloc(struct blockdev* bd, unsigned int len) {
+	(void) bd;
+	// Round up, so reading the last (full) sector never overflows.
+	char* buf = mem_aligned(MEM_CACHE, BLOCKDEV_ALIGN, len + BLOCKDEV_ALIGN);
+	if (buf == NULL) {
+		perror("Could not allocate memory for the device window");
+		abort();
+	}
+	return buf;
+}
+
+/*
+ * Finds the index of `sector' in the dirty store, or the index where it
+ * should be inserted when it's not in there.
+ */
+static unsigned int blockdev_find(struct blockdev* bd, uint64_t sector) {
+	unsigned int lo = 0;
+	unsigned int hi = bd->dirty_count;
+	while (lo < hi) {
+		unsigned int mid = lo + (hi - lo) / 2;
+		if (bd->dirty[mid].sector < sector) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return lo;
+}
+
+unsigned int blockdev_read(struct blockdev* bd, uint64_t start, char* dst, unsigned int len) {
+	unsigned int total = 0;
+	while (total < len) {
+		ssize_t n = pread(bd->fd, dst + total, len - total, start + total);
+		PERF_COUNT(PERF_SYSCALLS, 1);
+		if (n == -1 && errno == EINTR) {
+			continue;
+		}
+		if (n <= 0) {
+			break;
+		}
+		total += n;
+	}
+
+	// Lay the modified sectors in this range over what was read.
+	uint64_t first = start / bd->sector_size;
+	for (unsigned int i = blockdev_find(bd, first); i < bd->dirty_count; i++) {
+		uint64_t offset = bd->dirty[i].sector * bd->sector_size - start;
+		if (offset >= total) {
+			break;
+		}
+		memcpy(dst + offset, bd->dirty[i].data, bd->sector_size);
+	}
+
+	return total;
+}
+
+void blockdev_mark(struct blockdev* bd, uint64_t sector_start, const char* data) {
+	uint64_t sector = sector_start / bd->sector_size;
+	unsigned int idx = blockdev_find(bd, sector);
+
+	if (idx == bd->dirty_count || bd->dirty[idx].sector != sector) {
+		// Not modified before, insert it at the proper position.
+		if (bd->dirty_count == bd->dirty_cap) {
+			bd->dirty_cap = bd->dirty_cap == 0 ? 16 : bd->dirty_cap * 2;
+			bd->dirty = mem_realloc(MEM_CACHE, bd->dirty, bd->dirty_cap * sizeof(struct blockdev_sector));
+			if (bd->dirty == NULL) {
+				perror("Could not allocate memory for modified sectors");
+				abort();
+			}
+		}
+		memmove(&bd->dirty[idx + 1], &bd->dirty[idx], (bd->dirty_count - idx) * sizeof(struct blockdev_sector));
+		bd->dirty[idx].sector = sector;
+		bd->dirty[idx].data = blockdev_alloc(bd, bd->sector_size);
+		bd->dirty_count++;
+	}
+
+	memcpy(bd->dirty[idx].data, data, bd->sector_size);
+}
+
+int blockdev_flush(struct blockdev* bd) {
+	unsigned int written = 0;
+	for (; written < bd->dirty_count; written++) {
+		struct blockdev_sector* s = &bd->dirty[written];
+		unsigned int total = 0;
+		while (total < bd->sector_size) {
+			ssize_t n = pwrite(bd->fd, s->data + total, bd->sector_size - total,
+			                   s->sector * bd->sector_size + total);
+			PERF_COUNT(PERF_SYSCALLS, 1);
+			if (n == -1 && errno == EINTR) {
+				continue;
+			}
+			if (n <= 0) {
+				break;
+			}
+			total += n;
+		}
+		if (total < bd->sector_size) {
+			break;
+		}
+		mem_free(s->data);
+	}
+
+	// Remove the sectors which were written from the store.
+	memmove(bd->dirty, bd->dirty + written, (bd->dirty_count - written) * sizeof(struct blockdev_sector));
+	bd->dirty_count -= written;
+
+	if (bd->dirty_count > 0) {
+		return -1;
+	}
+	if (written > 0 && fsync(bd->fd) == -1) {
+		return -1;
+	}
+	return written;
+}
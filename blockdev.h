@@ -0,0 +1,92 @@
+/*
+ * This file is part of hx - a hex editor for the terminal.
+ *
+ * Copyright (c) 2016 Kevin Pors. See LICENSE for details.
+ */
+
+#ifndef HX_BLOCKDEV_H
+#define HX_BLOCKDEV_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Access to block devices (disks, partitions, loop devices). These can be
+ * far larger than what fits in memory, so the editor only loads a window of
+ * the device at a time. All I/O is done in whole sectors at sector aligned
+ * offsets, which allows using O_DIRECT to bypass the page cache.
+ *
+ * Modified sectors are kept in a store sorted by sector number until they
+ * are written with blockdev_flush(). The store outlives the loaded window:
+ * when a window is read again, the modified sectors are laid over it, so
+ * no changes get lost when navigating through the device.
+ */
+
+/*
+ * A sector which was modified, but not yet written to the device.
+ */
+struct blockdev_sector {
+	uint64_t sector; // the sector number.
+	char*    data;   // the modified contents, sector_size bytes.
+};
+
+struct blockdev {
+	char* path;    // path of the device.
+	int   fd;      // file descriptor of the opened device.
+	bool  writable; // whether fd was opened for writing as well.
+	bool  direct;  // whether fd was opened with O_DIRECT.
+
+	uint64_t     size;        // size of the device in bytes.
+	unsigned int sector_size; // logical sector size in bytes.
+
+	struct blockdev_sector* dirty; // modified sectors, sorted by sector number.
+	unsigned int dirty_count;      // amount of modified sectors.
+	unsigned int dirty_cap;        // capacity of the dirty array.
+};
+
+/*
+ * Opens the block device at `path'. Returns NULL when that fails, with
+ * errno set accordingly.
+ */
+struct blockdev* blockdev_open(const char* path, bool direct);
+
+/*
+ * Closes the device and frees the blockdev, including unwritten changes.
+ */
+void blockdev_free(struct blockdev* bd);
+
+/*
+ * Reopens the device with or without O_DIRECT. Returns false if that
+ * fails, in which case the device stays opened as it was.
+ */
+bool blockdev_set_direct(struct blockdev* bd, bool direct);
+
+/*
+ * Allocates a buffer for `len' bytes which is aligned well enough to be used
+ * for O_DIRECT I/O. The buffer can be released using mem_free(), and is
+ * accounted as a cache until it's retagged (see mem.h).
+ */
+char* blockdev_alloc(struct blockdev* bd, unsigned int len);
+
+/*
+ * Reads `len' bytes at offset `start' into `dst'. Both `start' and `len'
+ * must be multiples of the sector size, except for `len' at the end of the
+ * device. Modified sectors are laid over the data read. Returns the amount
+ * of bytes read.
+ */
+unsigned int blockdev_read(struct blockdev* bd, uint64_t start, char* dst, unsigned int len);
+
+/*
+ * Records the sector starting at offset `sector_start' as modified, with
+ * `data' as its new contents.
+ */
+void blockdev_mark(struct blockdev* bd, uint64_t sector_start, const char* data);
+
+/*
+ * Writes all modified sectors to the device, and only those. Returns the
+ * amount of sectors written, or -1 on failure (with errno set). Sectors
+ * that were written successfully are removed from the store.
+ */
+int blockdev_flush(struct blockdev* bd);
+
+#endif // HX_BLOCKDEV_H
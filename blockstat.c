@@ -0,0 +1,353 @@
+/*
+ * This file is part of hx - a hex editor for the terminal.
+ *
+ * Copyright (c) 2016 Kevin Pors. See LICENSE for details.
+ */
+
+// pthread_kill(), pthread_sigmask() and clock_gettime() are part of
+// POSIX.1-2008. The Makefile defines _POSIX_SOURCE, which would otherwise
+// limit us to POSIX.1.
+#define _XOPEN_SOURCE 700
+#define _POSIX_C_SOURCE 200809L
+
+#include "blockstat.h"
+#include "mem.h"
+#include "trace.h"
+
+#include <math.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// Amount of blocks a worker claims at once.
+#define BLOCKSTAT_CHUNK 64
+
+// Minimum time in milliseconds between two notifications.
+#define BLOCKSTAT_NOTIFY_MS 100
+
+/*
+ * Returns the current time of the monotonic clock in milliseconds.
+ */
+static uint64_t now_ms() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+void blockstat_compute(const char* p, size_t len, struct blockstat_block* dst) {
+	// Four histograms are filled in turns, so consecutive equal bytes do not
+	// wait for each other's increment. They're added up afterwards.
+	uint32_t hist[4][256];
+	memset(hist, 0, sizeof(hist));
+	const unsigned char* b = (const unsigned char*) p;
+	size_t i = 0;
+	for (; i + 4 <= len; i += 4) {
+		hist[0][b[i]]++;
+		hist[1][b[i + 1]]++;
+		hist[2][b[i + 2]]++;
+		hist[3][b[i + 3]]++;
+	}
+	for (; i < len; i++) {
+		hist[0][b[i]]++;
+	}
+
+	memset(dst->classes, 0, sizeof(dst->classes));
+	double sum = 0;
+	for (int c = 0; c < 256; c++) {
+		uint32_t n = hist[0][c] + hist[1][c] + hist[2][c] + hist[3][c];
+		if (n == 0) {
+			continue;
+		}
+		// H = -sum(p * log2(p)) = log2(len) - sum(n * log2(n)) / len
+		sum += n * log2(n);
+
+		if (c == 0) {
+			dst->classes[BLOCKSTAT_ZERO] += n;
+		} else if (c < 0x20 || c == 0x7f) {
+			dst->classes[BLOCKSTAT_CONTROL] += n;
+		} else if (c < 0x80) {
+			dst->classes[BLOCKSTAT_ASCII] += n;
+		} else {
+			dst->classes[BLOCKSTAT_HIGH] += n;
+		}
+	}
+	dst->entropy = len == 0 ? 0 : log2(len) - sum / len;
+	dst->valid = true;
+}
+
+struct blockstat* blockstat_create(int signo) {
+	struct blockstat* bs = mem_alloc(MEM_CACHE, sizeof(struct blockstat));
+	if (bs == NULL) {
+		perror("Could not allocate memory for block statistics");
+		abort();
+	}
+	bs->data = NULL;
+	bs->len = 0;
+	bs->blocks = NULL;
+	bs->block_count = 0;
+	bs->scan = 0;
+	bs->changed_from = 0;
+	bs->changed_to = 0;
+	pthread_mutex_init(&bs->lock, NULL);
+	pthread_cond_init(&bs->idle, NULL);
+	bs->running = 0;
+	bs->cancel = false;
+	bs->owner = pthread_self();
+	bs->signo = signo;
+	bs->notified = 0;
+	return bs;
+}
+
+void blockstat_free(struct blockstat* bs) {
+	blockstat_stop(bs);
+	pthread_cond_destroy(&bs->idle);
+	pthread_mutex_destroy(&bs->lock);
+	mem_free(bs->blocks);
+	mem_free(bs);
+}
+
+/*
+ * Records blocks [from, to) as changed. Must be called with the lock held.
+ */
+static void blockstat_changed(struct blockstat* bs, size_t from, size_t to) {
+	if (bs->changed_from >= bs->changed_to) {
+		bs->changed_from = from;
+		bs->changed_to = to;
+		return;
+	}
+	if (from < bs->changed_from) {
+		bs->changed_from = from;
+	}
+	if (to > bs->changed_to) {
+		bs->changed_to = to;
+	}
+}
+
+/*
+ * Sends the notification signal to the owner, if it's due. When `force' is
+ * set, it's sent regardless of the time of the previous one. Must be called
+ * with the lock held.
+ */
+static void blockstat_notify(struct blockstat* bs, bool force) {
+	if (bs->signo == 0) {
+		return;
+	}
+	uint64_t now = now_ms();
+	if (force || now - bs->notified >= BLOCKSTAT_NOTIFY_MS) {
+		bs->notified = now;
+		pthread_kill(bs->owner, bs->signo);
+	}
+}
+
+/*
+ * The worker thread. Claims a chunk of stale blocks at a time, and computes
+ * them without holding the lock. Exits when no stale blocks are left.
+ */
+static void* blockstat_worker(void* arg) {
+	struct blockstat* bs = arg;
+	size_t claimed[BLOCKSTAT_CHUNK];
+	uint32_t generations[BLOCKSTAT_CHUNK];
+
+	pthread_mutex_lock(&bs->lock);
+	while (!bs->cancel) {
+		unsigned int n = 0;
+		size_t i = bs->scan;
+		for (; i < bs->block_count && n < BLOCKSTAT_CHUNK; i++) {
+			if (bs->blocks[i].stale) {
+				bs->blocks[i].stale = false;
+				claimed[n] = i;
+				generations[n] = bs->blocks[i].generation;
+				n++;
+			}
+		}
+		bs->scan = i;
+		if (n == 0) {
+			break;
+		}
+		pthread_mutex_unlock(&bs->lock);
+
+		struct blockstat_block results[BLOCKSTAT_CHUNK];
+		TRACE_BEGIN(TRACE_ENTROPY);
+		for (unsigned int j = 0; j < n; j++) {
+			size_t offset = claimed[j] * BLOCKSTAT_BLOCK_SIZE;
+			size_t len = bs->len - offset < BLOCKSTAT_BLOCK_SIZE ? bs->len - offset : BLOCKSTAT_BLOCK_SIZE;
+			blockstat_compute(bs->data + offset, len, &results[j]);
+		}
+		TRACE_END(TRACE_ENTROPY);
+
+		pthread_mutex_lock(&bs->lock);
+		for (unsigned int j = 0; j < n; j++) {
+			struct blockstat_block* blk = &bs->blocks[claimed[j]];
+			if (bs->cancel) {
+				// The buffer may be gone already. Leave the block for
+				// the workers started after the reset.
+				blk->stale = true;
+				continue;
+			}
+			// The block may have changed while computing it, in which
+			// case it has been marked stale again.
+			if (blk->generation == generations[j]) {
+				results[j].generation = blk->generation;
+				results[j].stale = false;
+				*blk = results[j];
+				blockstat_changed(bs, claimed[j], claimed[j] + 1);
+			}
+		}
+		blockstat_notify(bs, false);
+	}
+
+	bs->running--;
+	if (bs->running == 0) {
+		if (!bs->cancel) {
+			blockstat_notify(bs, true);
+		}
+		pthread_cond_broadcast(&bs->idle);
+	}
+	pthread_mutex_unlock(&bs->lock);
+	return NULL;
+}
+
+/*
+ * Starts workers when none are running. Must be called with the lock held.
+ */
+static void blockstat_start(struct blockstat* bs) {
+	if (bs->running > 0 || bs->scan >= bs->block_count) {
+		return;
+	}
+
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	size_t threads = cpus < 1 ? 1 : (size_t) cpus;
+	if (threads > BLOCKSTAT_MAX_THREADS) {
+		threads = BLOCKSTAT_MAX_THREADS;
+	}
+	size_t chunks = (bs->block_count - bs->scan + BLOCKSTAT_CHUNK - 1) / BLOCKSTAT_CHUNK;
+	if (threads > chunks) {
+		threads = chunks;
+	}
+
+	// Signals must be handled by the main thread, where they interrupt
+	// reading the keyboard. Block them in the workers.
+	sigset_t all, old;
+	sigfillset(&all);
+	pthread_sigmask(SIG_SETMASK, &all, &old);
+
+	pthread_attr_t attr;
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	for (size_t i = 0; i < threads; i++) {
+		pthread_t thread;
+		if (pthread_create(&thread, &attr, blockstat_worker, bs) == 0) {
+			bs->running++;
+		}
+	}
+	pthread_attr_destroy(&attr);
+
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+}
+
+void blockstat_stop(struct blockstat* bs) {
+	pthread_mutex_lock(&bs->lock);
+	bs->cancel = true;
+	while (bs->running > 0) {
+		pthread_cond_wait(&bs->idle, &bs->lock);
+	}
+	bs->cancel = false;
+	pthread_mutex_unlock(&bs->lock);
+}
+
+void blockstat_reset(struct blockstat* bs, const char* data, size_t len, size_t from) {
+	blockstat_stop(bs);
+
+	pthread_mutex_lock(&bs->lock);
+	size_t count = (len + BLOCKSTAT_BLOCK_SIZE - 1) / BLOCKSTAT_BLOCK_SIZE;
+	if (count != bs->block_count) {
+		struct blockstat_block* blocks = mem_realloc(MEM_CACHE, bs->blocks, (count + 1) * sizeof(struct blockstat_block));
+		if (blocks == NULL) {
+			perror("Could not allocate memory for block statistics");
+			abort();
+		}
+		for (size_t i = bs->block_count; i < count; i++) {
+			blocks[i].generation = 0;
+			blocks[i].stale = false;
+			blocks[i].valid = false;
+		}
+		bs->blocks = blocks;
+		bs->block_count = count;
+	}
+	bs->data = data;
+	bs->len = len;
+
+	size_t first = from / BLOCKSTAT_BLOCK_SIZE;
+	if (first < count) {
+		blockstat_changed(bs, first, count);
+	}
+	for (size_t i = 0; i < count; i++) {
+		if (i >= first || !bs->blocks[i].valid) {
+			bs->blocks[i].stale = true;
+			bs->blocks[i].generation++;
+		}
+	}
+	bs->scan = 0;
+	blockstat_start(bs);
+	pthread_mutex_unlock(&bs->lock);
+}
+
+void blockstat_invalidate(struct blockstat* bs, size_t from, size_t to) {
+	if (from >= to || from >= bs->len) {
+		return;
+	}
+	pthread_mutex_lock(&bs->lock);
+	size_t first = from / BLOCKSTAT_BLOCK_SIZE;
+	size_t last = (to - 1) / BLOCKSTAT_BLOCK_SIZE;
+	for (size_t i = first; i <= last && i < bs->block_count; i++) {
+		bs->blocks[i].stale = true;
+		bs->blocks[i].generation++;
+	}
+	blockstat_changed(bs, first, last + 1 < bs->block_count ? last + 1 : bs->block_count);
+	if (first < bs->scan) {
+		bs->scan = first;
+	}
+	blockstat_start(bs);
+	pthread_mutex_unlock(&bs->lock);
+}
+
+bool blockstat_get(struct blockstat* bs, size_t offset, struct blockstat_block* dst) {
+	pthread_mutex_lock(&bs->lock);
+	size_t i = offset / BLOCKSTAT_BLOCK_SIZE;
+	bool ok = i < bs->block_count && bs->blocks[i].valid && !bs->blocks[i].stale;
+	if (ok) {
+		*dst = bs->blocks[i];
+	}
+	pthread_mutex_unlock(&bs->lock);
+	return ok;
+}
+
+bool blockstat_changes(struct blockstat* bs, size_t* from, size_t* to) {
+	pthread_mutex_lock(&bs->lock);
+	*from = bs->changed_from;
+	*to = bs->changed_to;
+	bs->changed_from = 0;
+	bs->changed_to = 0;
+	pthread_mutex_unlock(&bs->lock);
+	return *from < *to;
+}
+
+size_t blockstat_sum(struct blockstat* bs, size_t from, size_t to, uint64_t classes[BLOCKSTAT_CLASSES]) {
+	size_t pending = 0;
+	pthread_mutex_lock(&bs->lock);
+	for (size_t i = from; i < to && i < bs->block_count; i++) {
+		const struct blockstat_block* blk = &bs->blocks[i];
+		if (!blk->valid || blk->stale) {
+			pending++;
+			continue;
+		}
+		for (int c = 0; c < BLOCKSTAT_CLASSES; c++) {
+			classes[c] += blk->classes[c];
+		}
+	}
+	pthread_mutex_unlock(&bs->lock);
+	return pending;
+}
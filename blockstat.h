@@ -0,0 +1,124 @@
+/*
+ * This file is part of hx - a hex editor for the terminal.
+ *
+ * Copyright (c) 2016 Kevin Pors. See LICENSE for details.
+ */
+
+#ifndef HX_BLOCKSTAT_H
+#define HX_BLOCKSTAT_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Per-block statistics of a buffer: the Shannon entropy of the bytes, and
+ * how many bytes fall in each of a few byte classes. These are computed by
+ * worker threads in the background, and cached per block. When the buffer
+ * changes, only the affected blocks are computed again.
+ *
+ * The workers read the buffer directly. Therefore blockstat_stop() must be
+ * called before the buffer is reallocated or freed, followed by
+ * blockstat_reset() once the buffer is usable again. Bytes changed in place
+ * only need a blockstat_invalidate(): should a worker have read the block
+ * while it was being changed, its result is discarded.
+ */
+
+// Size of the blocks statistics are kept for.
+#define BLOCKSTAT_BLOCK_SIZE 4096
+
+// Maximum amount of worker threads.
+#define BLOCKSTAT_MAX_THREADS 8
+
+// Byte classes counted per block.
+enum blockstat_class {
+	BLOCKSTAT_ZERO,    // 0x00
+	BLOCKSTAT_CONTROL, // 0x01 - 0x1f and 0x7f
+	BLOCKSTAT_ASCII,   // printable ASCII, 0x20 - 0x7e
+	BLOCKSTAT_HIGH,    // 0x80 - 0xff
+	BLOCKSTAT_CLASSES,
+};
+
+struct blockstat_block {
+	uint32_t generation; // incremented every time the block changes.
+	bool     stale;      // whether the statistics need to be computed (again).
+	bool     valid;      // whether the statistics have been computed at all.
+	float    entropy;    // entropy in bits per byte, from 0 to 8.
+	uint16_t classes[BLOCKSTAT_CLASSES]; // amount of bytes in every class.
+};
+
+struct blockstat {
+	const char* data;   // the buffer.
+	size_t      len;    // length of the buffer.
+
+	struct blockstat_block* blocks; // statistics of every block.
+	size_t block_count;             // amount of blocks.
+	size_t scan;                    // no stale blocks exist before this one.
+	size_t changed_from;            // range of blocks changed since the last
+	size_t changed_to;              // call to blockstat_changes().
+
+	pthread_mutex_t lock;    // protects everything in here.
+	pthread_cond_t  idle;    // signalled when the last worker exits.
+	unsigned int    running; // amount of running workers.
+	bool            cancel;  // tells the workers to exit.
+
+	pthread_t owner;    // the thread to notify.
+	int       signo;    // signal sent to the owner when blocks were computed.
+	uint64_t  notified; // time (ms) of the last notification.
+};
+
+/*
+ * Creates an empty blockstat. The calling thread is sent signal `signo'
+ * when computed statistics become available (at most every 100 ms, and when
+ * everything has been computed). No signal is sent if `signo' is 0.
+ */
+struct blockstat* blockstat_create(int signo);
+
+/*
+ * Stops the workers and frees the blockstat.
+ */
+void blockstat_free(struct blockstat* bs);
+
+/*
+ * Stops the workers, and waits until they have exited.
+ */
+void blockstat_stop(struct blockstat* bs);
+
+/*
+ * Sets the buffer to `data' of `len' bytes. The statistics of blocks before
+ * offset `from' are kept, all others are computed again. Starts the workers.
+ */
+void blockstat_reset(struct blockstat* bs, const char* data, size_t len, size_t from);
+
+/*
+ * Marks the blocks overlapping the bytes [from, to) as changed, which were
+ * changed in place. Starts the workers when needed.
+ */
+void blockstat_invalidate(struct blockstat* bs, size_t from, size_t to);
+
+/*
+ * Copies the statistics of the block containing `offset' to `dst'. Returns
+ * false if they have not been computed yet.
+ */
+bool blockstat_get(struct blockstat* bs, size_t offset, struct blockstat_block* dst);
+
+/*
+ * Gets the range of blocks [from, to) which changed (were computed, became
+ * stale, or were added or removed) since the previous call. Returns false if
+ * nothing changed.
+ */
+bool blockstat_changes(struct blockstat* bs, size_t* from, size_t* to);
+
+/*
+ * Adds the class counts of the computed blocks in [from, to) to `classes'.
+ * Returns the amount of blocks in that range which are not computed yet.
+ */
+size_t blockstat_sum(struct blockstat* bs, size_t from, size_t to, uint64_t classes[BLOCKSTAT_CLASSES]);
+
+/*
+ * Computes the statistics of the `len' bytes at `p' into `dst'.
+ */
+void blockstat_compute(const char* p, size_t len, struct blockstat_block* dst);
+
+#endif // HX_BLOCKSTAT_H
@@ -5,6 +5,8 @@
  */
 
 #include "charbuf.h"
+#include "mem.h"
+#include "perf.h"
 
 #include <assert.h>
 #include <errno.h>
@@ -13,16 +15,19 @@
 #include <stdio.h>
 #include <unistd.h>
 
+// Where charbuf_draw() sends its contents instead of stdout, or NULL.
+static charbuf_sink draw_sink = NULL;
 
 /*
  * Create a charbuf on the heap and return it.
  */
 struct charbuf* charbuf_create() {
-	struct charbuf* b = malloc(sizeof(struct charbuf));
+	struct charbuf* b = mem_alloc(MEM_FRAME, sizeof(struct charbuf));
 	if (b) {
 		b->contents = NULL;
 		b->len = 0;
 		b->cap = 0;
+		b->arena = NULL;
 		return b;
 	} else {
 		perror("Unable to allocate size for struct charbuf");
@@ -30,12 +35,29 @@ struct charbuf* charbuf_create() {
 	}
 }
 
+struct charbuf* charbuf_create_in(struct mem_arena* arena) {
+	struct charbuf* b = mem_arena_alloc(arena, sizeof(struct charbuf));
+	if (b == NULL) {
+		perror("Unable to allocate size for struct charbuf");
+		exit(1);
+	}
+	b->contents = NULL;
+	b->len = 0;
+	b->cap = 0;
+	b->arena = arena;
+	return b;
+}
+
 /*
  * Deletes the charbuf's contents, and the charbuf itself.
  */
 void charbuf_free(struct charbuf* buf) {
-	free(buf->contents);
-	free(buf);
+	if (buf->arena != NULL) {
+		// Freed along with everything else in the arena.
+		return;
+	}
+	mem_free(buf->contents);
+	mem_free(buf);
 }
 
 /*
@@ -49,10 +71,15 @@ void charbuf_append(struct charbuf* buf, const char* what, size_t len) {
 	// Prevent reallocing a lot by using some sort of geometric progression
 	// by increasing the cap with len, then doubling it.
 	if ((int)(buf->len + len) >= buf->cap) {
+		int old_cap = buf->cap;
 		buf->cap += len;
 		buf->cap *= 2;
 		// reallocate with twice the capacity
-		buf->contents = realloc(buf->contents, buf->cap);
+		if (buf->arena != NULL) {
+			buf->contents = mem_arena_grow(buf->arena, buf->contents, old_cap, buf->cap);
+		} else {
+			buf->contents = mem_realloc(MEM_FRAME, buf->contents, buf->cap);
+		}
 		if (buf->contents == NULL) {
 			perror("Unable to realloc charbuf");
 			exit(1);
@@ -78,10 +105,22 @@ int charbuf_appendf(struct charbuf* buf, const char* fmt, ...) {
 	return len;
 }
 
+/*
+ * Sends what charbuf_draw() draws to `sink' instead, or to the screen if NULL.
+ */
+void charbuf_set_sink(charbuf_sink sink) {
+	draw_sink = sink;
+}
+
 /*
  * Draws (writes) the charbuf to the screen.
  */
 void charbuf_draw(struct charbuf* buf) {
+	if (draw_sink != NULL) {
+		draw_sink(buf->contents, buf->len);
+		return;
+	}
+	PERF_COUNT(PERF_SYSCALLS, 1);
 	if (write(STDOUT_FILENO, buf->contents, buf->len) == -1) {
 		perror("Can't write charbuf");
 		exit(1);
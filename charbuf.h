@@ -11,6 +11,8 @@
 
 static const unsigned int CHARBUF_APPENDF_SIZE = 1024;
 
+struct mem_arena;
+
 /*
  * This charbuf contains the character sequences to render the current
  * 'screen'. The charbuf is changed as a whole, then written to the screen
@@ -21,6 +23,7 @@ struct charbuf {
 	char* contents;
 	int len;        // actual length of what's in the buffer
 	int cap;        // capacity
+	struct mem_arena* arena; // where the contents live, or NULL for the heap
 };
 
 /*
@@ -29,7 +32,15 @@ struct charbuf {
 struct charbuf* charbuf_create();
 
 /*
- * Deletes the charbuf's contents, and the charbuf itself.
+ * Create a charbuf in `arena', which holds the charbuf and its contents
+ * until the arena is reset. Used for the frames, so drawing a frame does
+ * not need the allocator once the arena has grown large enough.
+ */
+struct charbuf* charbuf_create_in(struct mem_arena* arena);
+
+/*
+ * Deletes the charbuf's contents, and the charbuf itself. Does nothing for a
+ * charbuf in an arena.
  */
 void charbuf_free(struct charbuf* buf);
 
@@ -53,4 +64,15 @@ int charbuf_appendf(struct charbuf* buf, const char* what, ...);
  */
 void charbuf_draw(struct charbuf* buf);
 
+/*
+ * Receives the contents drawn by charbuf_draw() instead of the screen.
+ */
+typedef void (*charbuf_sink)(const char* contents, int len);
+
+/*
+ * Makes charbuf_draw() pass its contents to `sink' instead of writing them
+ * to the screen, like in headless mode. NULL draws to the screen again.
+ */
+void charbuf_set_sink(charbuf_sink sink);
+
 #endif // HX_CHARBUF_H
@@ -4,13 +4,37 @@
  * Copyright (c) 2016 Kevin Pors. See LICENSE for details.
  */
 
+// pread() is part of POSIX.1-2008.
+#define _XOPEN_SOURCE 700
+
 #include "editor.h"
+#include "addrmap.h"
+#include "blockdev.h"
+#include "blockstat.h"
+#include "elfindex.h"
+#include "inspector.h"
+#include "listview.h"
+#include "marks.h"
+#include "mem.h"
+#include "minimap.h"
+#include "perf.h"
+#include "procmem.h"
+#include "render.h"
+#include "search.h"
+#include "sparse.h"
+#include "strscan.h"
+#include "template.h"
+#include "trace.h"
 #include "util.h"
 #include "undo.h"
 
 #include <assert.h>
 #include <ctype.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <signal.h>
 #include <stdarg.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -19,6 +43,77 @@
 #include <sys/stat.h>
 #include <unistd.h>
 
+// Size of the blocks of a file which are fingerprinted, to be able to tell
+// which parts of a file were changed on disk by another process.
+static const unsigned int FINGERPRINT_BLOCK_SIZE = 4096;
+
+/*
+ * Rows hold octets_per_line bytes. When a record size is set, every record
+ * starts on a new row, and a record longer than a row spans several rows,
+ * of which the last one may be shorter. The layout of the rows repeats every
+ * stride bytes: every record, or every row otherwise. This keeps converting
+ * between rows and offsets a matter of a few divisions.
+ */
+static unsigned int editor_stride(struct editor* e) {
+	return e->record_size > 0 ? e->record_size : (unsigned int) e->octets_per_line;
+}
+
+/*
+ * Returns the amount of rows in a stride.
+ */
+static unsigned int editor_stride_rows(struct editor* e) {
+	return (editor_stride(e) + e->octets_per_line - 1) / e->octets_per_line;
+}
+
+/*
+ * Returns the offset of the first byte of row `row'.
+ */
+static unsigned int editor_row_offset(struct editor* e, unsigned int row) {
+	unsigned int rows = editor_stride_rows(e);
+	return row / rows * editor_stride(e) + row % rows * e->octets_per_line;
+}
+
+/*
+ * Returns the row the byte at `offset' is on.
+ */
+static int editor_offset_row(struct editor* e, unsigned int offset) {
+	unsigned int stride = editor_stride(e);
+	return offset / stride * editor_stride_rows(e) + offset % stride / e->octets_per_line;
+}
+
+/*
+ * Returns the amount of bytes on the row the byte at `offset' is on. The
+ * end of the contents is not taken into account.
+ */
+static unsigned int editor_row_length(struct editor* e, unsigned int offset) {
+	unsigned int stride = editor_stride(e);
+	unsigned int in_stride = offset % stride;
+	unsigned int rest = stride - (in_stride - in_stride % e->octets_per_line);
+	return rest < (unsigned int) e->octets_per_line ? rest : (unsigned int) e->octets_per_line;
+}
+
+/*
+ * Returns the highest line the screen may start with, so it does not
+ * scroll past the end of the contents. It can be negative when all of the
+ * contents fit on the screen.
+ */
+static int editor_last_line(struct editor* e) {
+	// Subtract the amount of screen rows (minus 2??) to prevent scrolling
+	// past the end of file.
+	return editor_offset_row(e, e->content_length) - (e->screen_rows - 2);
+}
+
+/*
+ * Keeps the cursor on the row it's on. Rows at the end of a record can be
+ * shorter than the row the cursor moved (or scrolled) from.
+ */
+static void editor_clamp_cursor(struct editor* e) {
+	unsigned int row_length = editor_row_length(e, editor_row_offset(e, e->cursor_y - 1 + e->line));
+	if ((unsigned int) e->cursor_x > row_length) {
+		e->cursor_x = row_length;
+	}
+}
+
 /*
  * This function looks convoluted as hell, but it works...
  */
@@ -31,7 +126,7 @@ void editor_move_cursor(struct editor* e, int dir, int amount) {
 	}
 	// Did we hit the start of the file? If so, stop moving and place
 	// the cursor on the top-left of the hex display.
-	if (e->cursor_x <= 1 && e->cursor_y <= 1 && e->line <= 0) {
+	if (e->cursor_x <= 1 && e->cursor_y <= 1 && e->line <= 0 && e->window_offset == 0) {
 		e->cursor_x = 1;
 		e->cursor_y = 1;
 		return;
@@ -48,9 +143,10 @@ void editor_move_cursor(struct editor* e, int dir, int amount) {
 		// Then we go up a row, cursor to the right. Like a text editor.
 		if (e->cursor_y >= 1) {
 			e->cursor_y--;
-			e->cursor_x = e->octets_per_line;
+			e->cursor_x = editor_row_length(e, editor_row_offset(e, e->cursor_y - 1 + e->line));
 		}
-	} else if (e->cursor_x > e->octets_per_line) {
+	} else if (dir != KEY_UP && dir != KEY_DOWN
+	           && (unsigned int) e->cursor_x > editor_row_length(e, editor_row_offset(e, e->cursor_y - 1 + e->line))) {
 		// Moving to the rightmost boundary?
 		//
 		// 000000000: 4d49 5420 4c69 6365 6e73 650a 0a43 6f70  MIT License..Cop
@@ -63,44 +159,767 @@ void editor_move_cursor(struct editor* e, int dir, int amount) {
 		e->cursor_x = 1;
 	}
 
-	// Did we try to move up when there's nothing? For example
-	//
-	//                       [up here]
-	// --------------------------^
-	// 000000000: 4d49 5420 4c69 6365 6e73 650a 0a43 6f70  MIT License..Cop
-	//
-	// Then stop moving upwards, do not scroll, return.
-	if (e->cursor_y <= 1 && e->line <= 0) {
-		e->cursor_y = 1;
+	// Did we try to move up when there's nothing? For example
+	//
+	//                       [up here]
+	// --------------------------^
+	// 000000000: 4d49 5420 4c69 6365 6e73 650a 0a43 6f70  MIT License..Cop
+	//
+	// Then stop moving upwards, do not scroll, return.
+	if (e->cursor_y <= 1 && e->line <= 0 && e->window_offset == 0) {
+		e->cursor_y = 1;
+	}
+
+	// Move the cursor over the y axis
+	if (e->cursor_y > e->screen_rows - 1) {
+		e->cursor_y = e->screen_rows - 1;
+		editor_scroll(e, 1);
+	} else if (e->cursor_y < 1 && (e->line > 0 || e->window_offset > 0)) {
+		e->cursor_y = 1;
+		editor_scroll(e, -1);
+	}
+
+	// When only a window of the file is loaded and the cursor moved to the
+	// row after the end of it, scroll down so the next part gets loaded.
+	if (e->windowed && e->window_offset + e->content_length < e->file_size
+	    && editor_row_offset(e, e->cursor_y - 1 + e->line) >= e->content_length) {
+		editor_scroll(e, 1);
+		e->cursor_y--;
+	}
+
+	editor_clamp_cursor(e);
+
+	// Did we hit the end of the file somehow? Set the cursor position
+	// to the maximum cursor position possible.
+	unsigned int offset = editor_offset_at_cursor(e);
+	if (offset >= e->content_length - 1) {
+		editor_cursor_at_offset(e, offset, &e->cursor_x, &e->cursor_y);
+		return;
+	}
+}
+
+/*
+ * Calculates a 32 bit FNV-1a hash of `len' bytes of `data'. This is cheap
+ * enough to fingerprint a complete file block by block.
+ */
+static unsigned int fingerprint(const char* data, unsigned int len) {
+	unsigned int hash = 2166136261u;
+	for (unsigned int i = 0; i < len; i++) {
+		hash ^= (unsigned char) data[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+/*
+ * Returns the amount of actions in the undo list which are applied.
+ */
+static unsigned int editor_undo_position(struct editor* e) {
+	if (e->undo_list->curr_status == AFTER_TAIL) {
+		return action_list_size(e->undo_list);
+	}
+	return action_list_curr_pos(e->undo_list);
+}
+
+/*
+ * Sets whether there are unsaved changes after undoing or redoing an action:
+ * undone or redone up to where the file was read or written, the contents are
+ * what is on disk again.
+ */
+static void editor_update_dirty(struct editor* e) {
+	if (e->bdev != NULL) {
+		e->dirty = true;
+	} else if (e->proc == NULL) {
+		e->dirty = e->saved_position != (int) editor_undo_position(e);
+	}
+}
+
+/*
+ * Adds an action to the undo list. That drops the actions which were undone,
+ * so when the file was written with some of them applied, what is on disk
+ * can no longer be told from the undo list.
+ */
+static void editor_add_action(struct editor* e, enum action_type type, unsigned int offset, unsigned char c) {
+	struct action_list* list = e->undo_list;
+	bool at_end = list->curr_status == AFTER_TAIL || (list->curr_status == NODE && list->curr == list->tail);
+	if (!at_end && e->saved_position > (int) editor_undo_position(e)) {
+		e->saved_position = -1;
+	}
+	action_list_add(list, type, offset, c);
+}
+
+/*
+ * Fingerprints all blocks of the editor's contents. Only call this when the
+ * contents are equal to what is on disk, i.e. after reading or writing it.
+ */
+static void editor_fingerprint_contents(struct editor* e) {
+	unsigned int count = (e->content_length + FINGERPRINT_BLOCK_SIZE - 1) / FINGERPRINT_BLOCK_SIZE;
+	unsigned int* prints = mem_realloc(MEM_INDEX, e->fingerprints, (count + 1) * sizeof(unsigned int));
+	if (prints == NULL) {
+		perror("Could not allocate memory for block fingerprints");
+		abort();
+	}
+
+	for (unsigned int i = 0; i < count; i++) {
+		unsigned int start = i * FINGERPRINT_BLOCK_SIZE;
+		unsigned int len = e->content_length - start;
+		if (len > FINGERPRINT_BLOCK_SIZE) {
+			len = FINGERPRINT_BLOCK_SIZE;
+		}
+		prints[i] = fingerprint(e->contents + start, len);
+	}
+
+	e->fingerprints = prints;
+	e->fingerprint_count = count;
+	e->saved_position = editor_undo_position(e);
+}
+
+/*
+ * Reads `len' bytes at `offset' of the file `fd' into `dst'. Returns the
+ * amount of bytes read, which is less than `len' at the end of the file.
+ */
+static size_t read_at(int fd, char* dst, size_t len, uint64_t offset) {
+	size_t total = 0;
+	while (total < len) {
+		ssize_t n = pread(fd, dst + total, len - total, offset + total);
+		PERF_COUNT(PERF_SYSCALLS, 1);
+		if (n == -1 && errno == EINTR) {
+			// Interrupted by SIGWINCH or SIGIO, just try again.
+			continue;
+		}
+		if (n <= 0) {
+			break;
+		}
+		total += n;
+	}
+	return total;
+}
+
+/*
+ * Writes the `len' bytes at `src' to the file `fd'. Returns false if that
+ * failed, with errno set.
+ */
+static bool write_all(int fd, const char* src, size_t len) {
+	size_t total = 0;
+	while (total < len) {
+		ssize_t n = write(fd, src + total, len - total);
+		PERF_COUNT(PERF_SYSCALLS, 1);
+		if (n == -1 && errno == EINTR) {
+			continue;
+		}
+		if (n <= 0) {
+			return false;
+		}
+		total += n;
+	}
+	return true;
+}
+
+/*
+ * Must be called before `contents' is reallocated or replaced, since the
+ * block statistics are computed from it in the background.
+ */
+static void editor_contents_changing(struct editor* e) {
+	if (e->blockstat != NULL) {
+		blockstat_stop(e->blockstat);
+	}
+}
+
+/*
+ * Must be called after `contents' was changed from offset `from' onwards,
+ * which involved editor_contents_changing().
+ */
+static void editor_contents_changed(struct editor* e, unsigned int from) {
+	if (e->blockstat != NULL) {
+		if (e->blockstat_pending < from) {
+			from = e->blockstat_pending;
+		}
+		blockstat_reset(e->blockstat, e->contents, e->content_length, from);
+		e->blockstat_pending = UINT_MAX;
+	}
+	if (e->tpl != NULL) {
+		template_invalidate(e->tpl);
+	}
+}
+
+// Time without inserts or deletes before the block statistics are computed
+// again, in microseconds.
+#define BLOCKSTAT_DEBOUNCE_US 300000
+
+/*
+ * Like editor_contents_changed(), after a byte was inserted or deleted at
+ * `offset'. Every block after it changes, so the block statistics are only
+ * reset when no more bytes were inserted or deleted for a while (see
+ * editor_flush_blockstat), rather than recomputed up to the end of the file
+ * for every key typed.
+ */
+static void editor_contents_edited(struct editor* e, unsigned int offset) {
+	if (e->blockstat != NULL) {
+		// The workers stay stopped until then.
+		if (offset < e->blockstat_pending) {
+			e->blockstat_pending = offset;
+		}
+		e->blockstat_pending_us = perf_now();
+	}
+	if (e->tpl != NULL) {
+		template_invalidate(e->tpl);
+	}
+}
+
+/*
+ * Resets the block statistics for the bytes inserted and deleted, once no
+ * more were for BLOCKSTAT_DEBOUNCE_US.
+ */
+static void editor_flush_blockstat(struct editor* e) {
+	if (e->blockstat == NULL || e->blockstat_pending == UINT_MAX ||
+			perf_now() - e->blockstat_pending_us < BLOCKSTAT_DEBOUNCE_US) {
+		return;
+	}
+	blockstat_reset(e->blockstat, e->contents, e->content_length, e->blockstat_pending);
+	e->blockstat_pending = UINT_MAX;
+}
+
+static void editor_window_read(struct editor* e, uint64_t start);
+
+/*
+ * Loads the window of the file starting at (about) `start', replacing the
+ * current contents.
+ */
+static void editor_window_load(struct editor* e, uint64_t start) {
+	TRACE_BEGIN(TRACE_LOAD);
+	editor_contents_changing(e);
+	editor_window_read(e, start);
+	editor_contents_changed(e, 0);
+	TRACE_END(TRACE_LOAD);
+}
+
+/*
+ * Loads a window of the file starting at offset `start'. The start is
+ * aligned to the amount of octets per line, so rows stay aligned with the
+ * offsets in the file. The window never starts beyond the offset at which
+ * the last window of the file would start, so passing UINT64_MAX loads
+ * the end of the file.
+ */
+static void editor_window_read(struct editor* e, uint64_t start) {
+	if (e->proc != NULL) {
+		// The window of process memory stays within one mapped region,
+		// and starts at a page boundary.
+		const struct procmem_region* r = procmem_region_at(e->proc, start, 1);
+		if (r == NULL) {
+			e->content_length = 0;
+			return;
+		}
+		uint64_t window = e->window_size;
+		if (start < r->start) {
+			start = r->start;
+		}
+		if (r->end - r->start <= window) {
+			start = r->start;
+		} else if (start > r->end - window) {
+			start = r->end - window;
+		}
+		start -= (start - r->start) % e->proc->page_size;
+		uint64_t len = r->end - start < window ? r->end - start : window;
+
+		char* contents = mem_realloc(MEM_CONTENTS, e->contents, len + 1);
+		if (contents == NULL) {
+			perror("Could not allocate memory for the memory window");
+			abort();
+		}
+		e->contents = contents;
+		e->content_length = len;
+		e->window_offset = start;
+		procmem_load(e->proc, start, e->contents, len);
+
+		// Undo offsets are relative to the window. Changes are written to
+		// the process right away, so there is nothing to lose.
+		action_list_free(e->undo_list);
+		e->undo_list = action_list_init();
+		e->saved_position = 0;
+
+		editor_statusmessage(e, STATUS_INFO, "%016" PRIx64 "-%016" PRIx64 " %s %s",
+			r->start, r->end, r->perms, r->name);
+		return;
+	}
+
+	int fd = -1;
+	if (e->bdev != NULL) {
+		e->file_size = e->bdev->size;
+	} else {
+		fd = open(e->filename, O_RDONLY);
+		if (fd == -1) {
+			editor_statusmessage(e, STATUS_ERROR, "Unable to open '%s': %s", e->filename, strerror(errno));
+			return;
+		}
+
+		struct stat statbuf;
+		if (fstat(fd, &statbuf) == -1) {
+			editor_statusmessage(e, STATUS_ERROR, "Cannot stat '%s': %s", e->filename, strerror(errno));
+			close(fd);
+			return;
+		}
+		e->file_size = statbuf.st_size;
+	}
+
+	// Keep the window a multiple of the line width (or the record size), so
+	// it only ends in the middle of a row at the end of the file. Windows of
+	// block devices consist of whole sectors as well.
+	unsigned int align = editor_stride(e);
+	if (e->bdev != NULL) {
+		unsigned int a = align;
+		unsigned int b = e->bdev->sector_size;
+		while (b != 0) {
+			unsigned int t = a % b;
+			a = b;
+			b = t;
+		}
+		align = align / a * e->bdev->sector_size;
+	}
+	unsigned int window = e->window_size - e->window_size % align;
+	if (window == 0) {
+		window = align;
+	}
+
+	// The last window starts at the first aligned offset from which the end
+	// of the file can be reached.
+	uint64_t tail = 0;
+	if (e->file_size > window) {
+		tail = e->file_size - window;
+		tail += (align - tail % align) % align;
+	}
+	if (start > tail) {
+		start = tail;
+	}
+	start -= start % align;
+
+	uint64_t len = e->file_size - start;
+	if (len > window) {
+		len = window;
+	}
+
+	if (e->bdev != NULL) {
+		// Block devices may be opened with O_DIRECT, which needs an
+		// aligned buffer.
+		char* contents = blockdev_alloc(e->bdev, len);
+		mem_retag(contents, MEM_CONTENTS);
+		mem_free(e->contents);
+		e->contents = contents;
+		e->content_length = blockdev_read(e->bdev, start, e->contents, len);
+		e->window_offset = start;
+
+		// Undo offsets are relative to the window. Modified sectors are
+		// kept by the blockdev until written, so no changes are lost.
+		action_list_free(e->undo_list);
+		e->undo_list = action_list_init();
+		e->saved_position = 0;
+		return;
+	}
+
+	char* contents = mem_realloc(MEM_CONTENTS, e->contents, len + 1);
+	if (contents == NULL) {
+		perror("Could not allocate memory for the file window");
+		abort();
+	}
+	e->contents = contents;
+	e->content_length = read_at(fd, e->contents, len, start);
+	e->window_offset = start;
+
+	close(fd);
+}
+
+unsigned int editor_window_seek(struct editor* e, uint64_t offset) {
+	if (!e->windowed) {
+		return offset;
+	}
+
+	if (offset < e->window_offset || offset >= e->window_offset + e->content_length) {
+		// Outside of the current window. Load a window with the offset
+		// positioned roughly in the middle of it.
+		uint64_t start = offset > e->window_size / 2 ? offset - e->window_size / 2 : 0;
+
+		if (e->proc != NULL) {
+			// Unmapped addresses are skipped in the direction we're
+			// moving, and the window stays within the mapped region.
+			const struct procmem_region* r = procmem_region_at(e->proc, offset, offset < e->window_offset ? -1 : 1);
+			if (r != NULL) {
+				if (offset < r->start) {
+					offset = r->start;
+				} else if (offset >= r->end) {
+					offset = r->end - 1;
+				}
+				start = offset > e->window_size / 2 ? offset - e->window_size / 2 : 0;
+				if (start < r->start) {
+					start = r->start;
+				}
+			}
+		}
+
+		editor_window_load(e, start);
+	}
+
+	if (e->content_length == 0 || offset < e->window_offset) {
+		return 0;
+	}
+	if (offset - e->window_offset >= e->content_length) {
+		return e->content_length - 1;
+	}
+	return offset - e->window_offset;
+}
+
+/*
+ * Moves the cursor to the last byte of the buffer, scrolling if necessary.
+ */
+static void editor_cursor_to_end(struct editor* e) {
+	if (e->content_length == 0) {
+		e->line = 0;
+		e->cursor_x = 1;
+		e->cursor_y = 1;
+		return;
+	}
+	editor_scroll(e, e->content_length);
+	editor_cursor_at_offset(e, e->content_length - 1, &e->cursor_x, &e->cursor_y);
+}
+
+void editor_follow(struct editor* e, bool enable) {
+	if (enable) {
+		if (e->dirty) {
+			editor_statusmessage(e, STATUS_ERROR, "No write since last change, cannot follow");
+			return;
+		}
+		e->follow = true;
+		e->windowed = true;
+		e->fingerprint_count = 0;
+		e->line = 0;
+		editor_window_load(e, UINT64_MAX);
+		editor_cursor_to_end(e);
+		editor_statusmessage(e, STATUS_INFO, "Following \"%s\" (%" PRIu64 " bytes)", e->filename, e->file_size);
+		return;
+	}
+
+	if (!e->windowed) {
+		e->follow = false;
+		return;
+	}
+
+	// Read the complete file again. A forced reload reads every block
+	// when there are no fingerprints.
+	uint64_t offset = e->window_offset + editor_offset_at_cursor(e);
+	e->follow = false;
+	e->windowed = false;
+	e->window_offset = 0;
+	e->fingerprint_count = 0;
+	editor_reload(e, true);
+	if (e->content_length > 0) {
+		editor_scroll_to_offset(e, offset < e->content_length ? offset : e->content_length - 1);
+	}
+	editor_statusmessage(e, STATUS_INFO, "Stopped following \"%s\" (%d bytes)", e->filename, e->content_length);
+}
+
+void editor_follow_update(struct editor* e) {
+	int fd = open(e->filename, O_RDONLY);
+	if (fd == -1) {
+		editor_statusmessage(e, STATUS_WARNING, "\"%s\" was removed from disk", e->filename);
+		return;
+	}
+
+	struct stat statbuf;
+	if (fstat(fd, &statbuf) == -1) {
+		close(fd);
+		return;
+	}
+
+	uint64_t size = statbuf.st_size;
+	uint64_t end = e->window_offset + e->content_length;
+	bool at_tail = end >= e->file_size;
+	bool at_eof = at_tail
+		&& (e->content_length == 0 || (unsigned int) editor_offset_at_cursor(e) == e->content_length - 1);
+
+	if (size < end) {
+		// Truncated, or replaced by a smaller file (rotated logs). Start
+		// over at the end of the file.
+		close(fd);
+		editor_window_load(e, UINT64_MAX);
+		editor_cursor_to_end(e);
+		editor_statusmessage(e, STATUS_WARNING, "\"%s\" was truncated", e->filename);
+		return;
+	}
+
+	e->file_size = size;
+	if (!at_tail || size == end) {
+		// Either nothing was appended, or we are looking at an older part
+		// of the file. In the latter case the new data is loaded when the
+		// user pages towards it.
+		close(fd);
+		return;
+	}
+
+	uint64_t appended = size - end;
+	if (at_eof && appended >= e->window_size) {
+		// So much was appended that none of the current window remains.
+		close(fd);
+		editor_window_load(e, UINT64_MAX);
+		editor_cursor_to_end(e);
+		return;
+	}
+
+	editor_contents_changing(e);
+	unsigned int changed_from = e->content_length;
+	if (at_eof && e->content_length + appended > e->window_size) {
+		// Drop the oldest rows from the window to make room for the new data.
+		unsigned int stride = editor_stride(e);
+		unsigned int drop = e->content_length + appended - e->window_size;
+		drop += (stride - drop % stride) % stride;
+		if (drop > e->content_length) {
+			drop = e->content_length - e->content_length % stride;
+		}
+		memmove(e->contents, e->contents + drop, e->content_length - drop);
+		e->content_length -= drop;
+		changed_from = 0;
+		e->window_offset += drop;
+		e->line -= editor_offset_row(e, drop);
+		if (e->line < 0) {
+			e->line = 0;
+		}
+	} else if (!at_eof) {
+		// Only fill up the window, without dropping what the user is
+		// looking at.
+		unsigned int room = e->content_length < e->window_size ? e->window_size - e->content_length : 0;
+		if (appended > room) {
+			appended = room;
+		}
+	}
+
+	if (appended > 0) {
+		char* contents = mem_realloc(MEM_CONTENTS, e->contents, e->content_length + appended + 1);
+		if (contents == NULL) {
+			perror("Could not allocate memory for the file window");
+			abort();
+		}
+		e->contents = contents;
+		e->content_length += read_at(fd, e->contents + e->content_length, appended, e->window_offset + e->content_length);
+	}
+	close(fd);
+	editor_contents_changed(e, changed_from);
+
+	if (at_eof) {
+		editor_cursor_to_end(e);
+	}
+}
+
+/*
+ * Must be called after the byte at `offset' was changed in place. When
+ * editing the memory of a live process, the byte is written to it. When
+ * editing a block device, the sector is recorded as modified.
+ */
+static void editor_byte_changed(struct editor* e, unsigned int offset) {
+	if (e->blockstat != NULL && e->blockstat_pending != UINT_MAX) {
+		// The workers are stopped until the pending reset, which has to
+		// include this byte.
+		if (offset < e->blockstat_pending) {
+			e->blockstat_pending = offset;
+		}
+	} else if (e->blockstat != NULL) {
+		blockstat_invalidate(e->blockstat, offset, offset + 1);
+	}
+	// Any byte may be a count the layout depends on.
+	if (e->tpl != NULL) {
+		template_invalidate(e->tpl);
+	}
+	if (e->bdev != NULL) {
+		// Windows start at a sector boundary.
+		unsigned int sector = offset - offset % e->bdev->sector_size;
+		blockdev_mark(e->bdev, e->window_offset + sector, e->contents + sector);
+	}
+	if (e->proc != NULL) {
+		if (!procmem_write(e->proc, e->window_offset + offset, e->contents + offset, 1)) {
+			editor_statusmessage(e, STATUS_ERROR, "Unable to write to process %d: %s", e->proc->pid, strerror(errno));
+		}
+		e->dirty = false;
+	}
+}
+
+/*
+ * Returns true when the buffer can be modified. `resize' indicates whether
+ * the modification changes the length of the buffer (inserting or deleting).
+ * When it can't, the reason is set as status message.
+ */
+static bool editor_check_writable(struct editor* e, bool resize) {
+	if (e->bdev != NULL) {
+		if (resize) {
+			editor_statusmessage(e, STATUS_ERROR, "Cannot insert or delete bytes on a block device");
+			return false;
+		}
+		if (!e->bdev->writable) {
+			editor_statusmessage(e, STATUS_ERROR, "Read-only: no permission to write to '%s'", e->filename);
+			return false;
+		}
+		return true;
+	}
+	if (e->proc != NULL) {
+		if (resize) {
+			editor_statusmessage(e, STATUS_ERROR, "Cannot insert or delete bytes in process memory");
+			return false;
+		}
+		if (!e->proc->writable) {
+			editor_statusmessage(e, STATUS_ERROR, "Read-only: no permission to write to process %d", e->proc->pid);
+			return false;
+		}
+		return true;
+	}
+	if (e->windowed) {
+		editor_statusmessage(e, STATUS_ERROR, "Read-only: only part of the file is loaded%s",
+			e->follow ? " (following)" : "");
+		return false;
+	}
+	return true;
+}
+
+void editor_openprocess(struct editor* e, int pid) {
+	e->proc = procmem_open(pid);
+	if (e->proc == NULL) {
+		fprintf(stderr, "Unable to open memory of process %d: %s\n", pid, strerror(errno));
+		exit(1);
+	}
+	if (e->proc->region_count == 0) {
+		fprintf(stderr, "Process %d has no readable memory\n", pid);
+		exit(1);
+	}
+
+	char name[32];
+	snprintf(name, sizeof(name), "pid:%d", pid);
+	e->filename = mem_alloc(MEM_OTHER, strlen(name) + 1);
+	if (e->filename == NULL) {
+		perror("Could not allocate memory for the filename");
+		abort();
+	}
+	strcpy(e->filename, name);
+
+	// The address space is treated like a sparse file, ending at the end of
+	// the last mapped region.
+	e->windowed = true;
+	e->file_size = e->proc->regions[e->proc->region_count - 1].end;
+	editor_window_load(e, e->proc->regions[0].start);
+}
+
+/*
+ * Opens the block device at `filename', or exits if that fails. A window of
+ * the device is loaded at a time, see blockdev.h.
+ */
+static void editor_openblockdev(struct editor* e, const char* filename) {
+	e->bdev = blockdev_open(filename, false);
+	if (e->bdev == NULL) {
+		perror("Unable to open block device");
+		exit(1);
+	}
+
+	e->filename = mem_alloc(MEM_OTHER, strlen(filename) + 1);
+	if (e->filename == NULL) {
+		perror("Could not allocate memory for the filename");
+		abort();
+	}
+	strcpy(e->filename, filename);
+
+	e->windowed = true;
+	editor_window_load(e, 0);
+
+	editor_statusmessage(e, e->bdev->writable ? STATUS_INFO : STATUS_WARNING,
+		"\"%s\" (block device, %" PRIu64 " bytes, %u byte sectors)%s",
+		e->filename, e->bdev->size, e->bdev->sector_size, e->bdev->writable ? "" : " [readonly]");
+}
+
+void editor_newfile(struct editor* e, const char* filename) {
+	e->filename = mem_alloc(MEM_OTHER, strlen(filename) + 1);
+	if (e->filename == NULL) {
+		perror("Could not allocate memory for the filename");
+		abort();
+	}
+	memcpy(e->filename, filename, strlen(filename) + 1);
+	e->contents = mem_alloc(MEM_CONTENTS, 0);
+	e->content_length = 0;
+}
+
+/*
+ * Indexes the sections, segments and symbols of the file opened as `fd',
+ * when it's an ELF file. Only its headers and tables are read.
+ */
+static void editor_index_elf(struct editor* e, int fd) {
+	if (e->elf != NULL) {
+		elf_free(e->elf);
+	}
+	e->elf = elf_open(fd);
+}
+
+/*
+ * Maps the loadable segments of an ELF file to the virtual addresses they
+ * are loaded at, along with the ranges mapped with :map. Relocatable files
+ * are not loaded as they are. Called again whenever the file is indexed
+ * again, since the segments may have moved.
+ */
+static void editor_map_elf(struct editor* e) {
+	if (e->vmap != NULL) {
+		addr_map_free(e->vmap);
+	}
+	e->vmap = addr_map_create();
+
+	if (e->elf != NULL && e->elf->type != 1) {
+		for (unsigned int i = 0; i < e->elf->segments.count; i++) {
+			const struct elf_region* segment = &e->elf->segments.regions[i];
+			if (segment->type == 1) { // PT_LOAD
+				addr_map_add(e->vmap, segment->offset, segment->vaddr, segment->size);
+			}
+		}
+	}
+	// The ranges overlapping a segment now are left out.
+	if (e->vmap_user != NULL) {
+		for (unsigned int i = 0; i < e->vmap_user->count; i++) {
+			const struct addr_range* r = &e->vmap_user->ranges[i];
+			addr_map_add(e->vmap, r->offset, r->vaddr, r->size);
+		}
 	}
 
-	// Move the cursor over the y axis
-	if (e->cursor_y > e->screen_rows - 1) {
-		e->cursor_y = e->screen_rows - 1;
-		editor_scroll(e, 1);
-	} else if (e->cursor_y < 1 && e->line > 0) {
-		e->cursor_y = 1;
-		editor_scroll(e, -1);
+	if (e->vmap->count == 0) {
+		addr_map_free(e->vmap);
+		e->vmap = NULL;
+		e->vaddr = false;
 	}
+}
 
-	// Did we hit the end of the file somehow? Set the cursor position
-	// to the maximum cursor position possible.
-	unsigned int offset = editor_offset_at_cursor(e);
-	if (offset >= e->content_length - 1) {
-		editor_cursor_at_offset(e, offset, &e->cursor_x, &e->cursor_y);
+/*
+ * Writes the path of the file the marks of the file are saved in to `dst'.
+ */
+static bool editor_marks_path(struct editor* e, char* dst, size_t len) {
+	return snprintf(dst, len, "%s.hxmarks", e->filename) < (int) len;
+}
+
+/*
+ * Reads the marks saved for the file, if any.
+ */
+static void editor_load_marks(struct editor* e) {
+	char path[4096];
+	if (!editor_marks_path(e, path, sizeof(path))) {
+		return;
+	}
+	struct marks* marks = marks_create();
+	if (!marks_load(marks, path) || marks->count == 0) {
+		marks_free(marks);
 		return;
 	}
+	e->marks = marks;
 }
 
-void editor_newfile(struct editor* e, const char* filename) {
-	e->filename = malloc(strlen(filename) + 1);
-	if (e->filename == NULL) {
-		perror("Could not allocate memory for the filename");
-		abort();
+/*
+ * Saves the marks next to the file. The offsets have to match the file on
+ * disk, so while there are unsaved changes they are saved when the file is
+ * written instead.
+ */
+static void editor_save_marks(struct editor* e) {
+	if (e->marks == NULL || e->dirty || e->proc != NULL || e->bdev != NULL) {
+		return;
+	}
+	char path[4096];
+	if (!editor_marks_path(e, path, sizeof(path)) || !marks_save(e->marks, path)) {
+		editor_statusmessage(e, STATUS_WARNING, "Could not save the marks of '%s': %s", e->filename, strerror(errno));
 	}
-	strncpy(e->filename, filename, strlen(filename) + 1);
-	e->contents = malloc(0);
-	e->content_length = 0;
 }
 
 void editor_openfile(struct editor* e, const char* filename) {
@@ -124,6 +943,12 @@ void editor_openfile(struct editor* e, const char* filename) {
 		perror("Cannot stat file");
 		exit(1);
 	}
+	if (S_ISBLK(statbuf.st_mode)) {
+		fclose(fp);
+		editor_openblockdev(e, filename);
+		return;
+	}
+
 	// S_ISREG is a a POSIX macro to check whether the given st_mode denotes a
 	// regular file. See `man 2 stat'.
 	if (!S_ISREG(statbuf.st_mode)) {
@@ -131,6 +956,19 @@ void editor_openfile(struct editor* e, const char* filename) {
 		exit(1);
 	}
 
+	if (e->follow) {
+		// When following a file, only the end of it is loaded.
+		fclose(fp);
+		e->filename = mem_alloc(MEM_OTHER, strlen(filename) + 1);
+		if (e->filename == NULL) {
+			perror("Could not allocate memory for the filename");
+			abort();
+		}
+		memcpy(e->filename, filename, strlen(filename) + 1);
+		editor_follow(e, true);
+		return;
+	}
+
 	// The content buffer. When stat() returns a non-zero length, this will
 	// be malloc'd. When <= 0, this will be assigned via a charbuf. This
 	// branching is done because 1) Otherwise /proc/ cannot be read, and 2)
@@ -153,76 +991,383 @@ void editor_openfile(struct editor* e, const char* filename) {
 		// Point contents to the charbuf's contents and set the length accordingly.
 		contents = buf->contents;
 		content_length = buf->len;
+		mem_retag(contents, MEM_CONTENTS);
+		mem_free(buf);
 	} else {
 		// stat() returned a size we can work with. Allocate memory for the
 		// buffer, No need for extra room for a null string terminator, since
 		// we're possibly reading binary data only anyway (which can contain 0x00).
-		contents = malloc(sizeof(char) * statbuf.st_size);
+		contents = mem_alloc(MEM_CONTENTS, sizeof(char) * statbuf.st_size);
 		if (contents == NULL) {
 			perror("Could not allocate memory for the file specified");
 			abort();
 		}
 		content_length = statbuf.st_size;
 
-		// fread() has a massive performance improvement when reading large files.
-		if (fread(contents, 1, statbuf.st_size, fp) < (size_t) statbuf.st_size) {
+		e->sparse = sparse_map_scan(fileno(fp), statbuf.st_size);
+		if (e->sparse != NULL) {
+			// Only read the data extents of a sparse file. The holes are
+			// left to calloc(), which maps zero pages on demand, so they
+			// never touch storage (nor memory, until they're displayed).
+			mem_free(contents);
+			contents = mem_calloc(MEM_CONTENTS, statbuf.st_size, 1);
+			if (contents == NULL) {
+				perror("Could not allocate memory for the file specified");
+				abort();
+			}
+			if (!sparse_map_read(e->sparse, fileno(fp), contents)) {
+				perror("Unable to read file contents");
+				mem_free(contents);
+				exit(1);
+			}
+		} else if (fread(contents, 1, statbuf.st_size, fp) < (size_t) statbuf.st_size) {
+			// fread() has a massive performance improvement when reading large files.
 			perror("Unable to read file contents");
-			free(contents);
+			mem_free(contents);
 			exit(1);
 		}
 	}
 
 	 // duplicate string without using gnu99 strdup().
-	e->filename = malloc(strlen(filename) + 1);
+	e->filename = mem_alloc(MEM_OTHER, strlen(filename) + 1);
 	if (e->filename == NULL) {
 		perror("Could not allocate memory for the filename");
 		abort();
 	}
-	strncpy(e->filename, filename, strlen(filename) + 1);
+	memcpy(e->filename, filename, strlen(filename) + 1);
 	e->contents = contents;
 	e->content_length = content_length;
+	editor_index_elf(e, fileno(fp));
+	editor_map_elf(e);
+	editor_load_marks(e);
 
 	// Check if the file is readonly, and warn the user about that.
+	const char* kind = e->sparse != NULL ? ", sparse" : e->elf != NULL ? ", ELF" : "";
 	if (access(filename, W_OK) == -1) {
-		editor_statusmessage(e, STATUS_WARNING, "\"%s\" (%d bytes) [readonly]", e->filename, e->content_length);
+		editor_statusmessage(e, STATUS_WARNING, "\"%s\" (%d bytes%s) [readonly]", e->filename, e->content_length, kind);
 	} else {
-		editor_statusmessage(e, STATUS_INFO, "\"%s\" (%d bytes)", e->filename, e->content_length);
+		editor_statusmessage(e, STATUS_INFO, "\"%s\" (%d bytes%s)", e->filename, e->content_length, kind);
 	}
 
+	editor_fingerprint_contents(e);
+
 	if (fclose(fp) != 0) {
 		perror("Could not close file properly");
 		abort();
 	}
 }
 
-void editor_writefile(struct editor* e) {
-	assert(e->filename != NULL);
+/*
+ * Does the work of editor_reload(), which wraps it for tracing.
+ */
+static void editor_reload_changes(struct editor* e, bool force) {
 
-	FILE* fp = fopen(e->filename, "wb");
+	FILE* fp = fopen(e->filename, "rb");
 	if (fp == NULL) {
+		editor_statusmessage(e, STATUS_WARNING, "\"%s\" was removed from disk", e->filename);
+		return;
+	}
+
+	struct stat statbuf;
+	if (fstat(fileno(fp), &statbuf) == -1 || !S_ISREG(statbuf.st_mode)) {
+		fclose(fp);
+		return;
+	}
+
+	unsigned int new_length = statbuf.st_size;
+	unsigned int count = (new_length + FINGERPRINT_BLOCK_SIZE - 1) / FINGERPRINT_BLOCK_SIZE;
+
+	// The new fingerprints, and for every block whether it changed. One extra
+	// element is allocated so empty files do not result in a malloc(0).
+	unsigned int* prints = mem_alloc(MEM_INDEX, (count + 1) * sizeof(unsigned int));
+	bool* changed = mem_alloc(MEM_INDEX, (count + 1) * sizeof(bool));
+	if (prints == NULL || changed == NULL) {
+		perror("Could not allocate memory for block fingerprints");
+		abort();
+	}
+
+	// First pass: fingerprint every block of the file on disk, and compare it
+	// with the fingerprint of that block when we read or wrote the file.
+	char block[FINGERPRINT_BLOCK_SIZE];
+	unsigned int nchanged = 0;
+	for (unsigned int i = 0; i < count; i++) {
+		unsigned int len = new_length - i * FINGERPRINT_BLOCK_SIZE;
+		if (len > FINGERPRINT_BLOCK_SIZE) {
+			len = FINGERPRINT_BLOCK_SIZE;
+		}
+		if (fread(block, 1, len, fp) < len) {
+			// File got truncated while reading it. Another event will
+			// follow, so just try again at that point.
+			mem_free(prints);
+			mem_free(changed);
+			fclose(fp);
+			return;
+		}
+		prints[i] = fingerprint(block, len);
+		changed[i] = force
+			|| i >= e->fingerprint_count
+			|| prints[i] != e->fingerprints[i];
+		if (changed[i]) {
+			nchanged++;
+		}
+	}
+
+	if (nchanged == 0 && count == e->fingerprint_count && !force) {
+		// Nothing changed. This happens for instance when we wrote the
+		// file ourselves.
+		mem_free(prints);
+		mem_free(changed);
+		fclose(fp);
+		return;
+	}
+
+	// Check the actions in the undo list against the changed blocks. When an
+	// action touched a changed block, undoing it afterwards makes no sense.
+	// The unsaved changes are the actions between the position the file was
+	// last read or written at and the current one (either way, since undoing
+	// an action changes the contents as well). Those must be replacements
+	// outside the changed blocks; anything else means the offsets in the
+	// buffer do not correspond with the offsets on disk anymore.
+	bool keep_undo = !force;
+	bool conflict = false;
+	int position = editor_undo_position(e);
+	int unsaved_from = e->saved_position < position ? e->saved_position : position;
+	int unsaved_to = e->saved_position < position ? position : e->saved_position;
+	int i = 0;
+	for (struct action* a = e->undo_list->head; a != NULL && !force; a = a->next) {
+		i++;
+		unsigned int idx = a->offset / FINGERPRINT_BLOCK_SIZE;
+		bool touched = idx >= count || changed[idx];
+		if (touched) {
+			keep_undo = false;
+		}
+		bool unsaved = e->saved_position == -1 || (i > unsaved_from && i <= unsaved_to);
+		if (e->dirty && unsaved && (touched || a->act != ACTION_REPLACE)) {
+			conflict = true;
+		}
+	}
+	if (e->dirty && new_length != e->content_length) {
+		conflict = true;
+	}
+
+	if (conflict && !force) {
+		editor_statusmessage(e, STATUS_WARNING,
+			"\"%s\" changed on disk, conflicts with unsaved changes (:e! to reload)", e->filename);
+		mem_free(prints);
+		mem_free(changed);
+		fclose(fp);
+		return;
+	}
+
+	unsigned int offset = editor_offset_at_cursor(e);
+
+	unsigned int first_changed = 0;
+	while (first_changed < count && !changed[first_changed]) {
+		first_changed++;
+	}
+	editor_contents_changing(e);
+
+	if (new_length != e->content_length) {
+		char* contents = mem_realloc(MEM_CONTENTS, e->contents, new_length + 1);
+		if (contents == NULL) {
+			perror("Could not allocate memory for the file specified");
+			abort();
+		}
+		e->contents = contents;
+		e->content_length = new_length;
+	}
+
+	// Second pass: read the changed blocks straight into the buffer.
+	for (unsigned int i = 0; i < count; i++) {
+		if (!changed[i]) {
+			continue;
+		}
+		unsigned int start = i * FINGERPRINT_BLOCK_SIZE;
+		unsigned int len = new_length - start;
+		if (len > FINGERPRINT_BLOCK_SIZE) {
+			len = FINGERPRINT_BLOCK_SIZE;
+		}
+		if (fseek(fp, start, SEEK_SET) != 0 || fread(e->contents + start, 1, len, fp) < len) {
+			// Contents are partially updated, so we can't trust them
+			// to be equal to the disk anymore. Make sure the next reload
+			// reads every block.
+			memset(prints, 0, count * sizeof(unsigned int));
+			break;
+		}
+	}
+
+	// Holes may have been filled or punched as well.
+	if (e->sparse != NULL) {
+		sparse_map_free(e->sparse);
+		e->sparse = sparse_map_scan(fileno(fp), new_length);
+	}
+
+	mem_free(e->fingerprints);
+	e->fingerprints = prints;
+	e->fingerprint_count = count;
+	mem_free(changed);
+	editor_contents_changed(e, first_changed * FINGERPRINT_BLOCK_SIZE);
+	editor_index_elf(e, fileno(fp));
+	editor_map_elf(e);
+	fclose(fp);
+
+	if (!keep_undo) {
+		action_list_free(e->undo_list);
+		e->undo_list = action_list_init();
+		// Unsaved changes no longer show in it.
+		e->saved_position = -1;
+	}
+	if (force) {
+		e->dirty = false;
+	}
+	if (!e->dirty) {
+		e->saved_position = editor_undo_position(e);
+	}
+
+	// Keep the cursor where it was, within the bounds of the new contents.
+	if (e->content_length == 0) {
+		e->line = 0;
+		e->cursor_x = 1;
+		e->cursor_y = 1;
+	} else {
+		if (offset >= e->content_length) {
+			offset = e->content_length - 1;
+		}
+		editor_scroll_to_offset(e, offset);
+	}
+
+	editor_statusmessage(e, STATUS_INFO, "\"%s\" reloaded from disk (%u of %u blocks changed%s)",
+		e->filename, nchanged, count, keep_undo ? "" : ", undo history cleared");
+}
+
+void editor_reload(struct editor* e, bool force) {
+	assert(e->filename != NULL);
+
+	TRACE_BEGIN(TRACE_RELOAD);
+	editor_reload_changes(e, force);
+	TRACE_END(TRACE_RELOAD);
+}
+
+/*
+ * Writes a file which was sparse when opened, keeping it sparse: blocks
+ * which only contain zeroes are not written, so they become holes.
+ */
+static void editor_writefile_sparse(struct editor* e) {
+	int fd = open(e->filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	PERF_COUNT(PERF_SYSCALLS, 1);
+	if (fd == -1) {
+		editor_statusmessage(e, STATUS_ERROR, "Unable to open '%s' for writing: %s", e->filename, strerror(errno));
+		return;
+	}
+
+	struct stat statbuf;
+	unsigned int blksize = 4096;
+	PERF_COUNT(PERF_SYSCALLS, 2); // fstat() and close()
+	if (fstat(fd, &statbuf) == 0 && statbuf.st_blksize > 0) {
+		blksize = statbuf.st_blksize;
+	}
+	if (!sparse_write(fd, e->contents, e->content_length, blksize)) {
+		editor_statusmessage(e, STATUS_ERROR, "Unable write to file: %s", strerror(errno));
+		close(fd);
+		return;
+	}
+
+	// The extents have changed with the edits, so scan them again. The file
+	// may have no holes left at all.
+	sparse_map_free(e->sparse);
+	e->sparse = sparse_map_scan(fd, e->content_length);
+	close(fd);
+
+	if (e->sparse != NULL) {
+		editor_statusmessage(e, STATUS_INFO, "\"%s\", %d bytes written (%u data extents)",
+			e->filename, e->content_length, e->sparse->count);
+	} else {
+		editor_statusmessage(e, STATUS_INFO, "\"%s\", %d bytes written (no holes left)",
+			e->filename, e->content_length);
+	}
+	e->dirty = false;
+	editor_fingerprint_contents(e);
+}
+
+/*
+ * Does the work of editor_writefile(), which wraps it for tracing.
+ */
+static void editor_writefile_contents(struct editor* e) {
+	if (e->proc != NULL) {
+		editor_statusmessage(e, STATUS_INFO, "Changes are written to process %d immediately", e->proc->pid);
+		return;
+	}
+	if (e->bdev != NULL) {
+		// Only the modified sectors are written.
+		int sectors = blockdev_flush(e->bdev);
+		if (sectors == -1) {
+			editor_statusmessage(e, STATUS_ERROR, "Unable to write to '%s': %s", e->filename, strerror(errno));
+			return;
+		}
+		editor_statusmessage(e, STATUS_INFO, "\"%s\", %d sectors (%d bytes) written",
+			e->filename, sectors, sectors * e->bdev->sector_size);
+		e->dirty = false;
+		return;
+	}
+	if (!editor_check_writable(e, false)) {
+		return;
+	}
+	if (e->sparse != NULL) {
+		editor_writefile_sparse(e);
+		return;
+	}
+
+	// Written without stdio, so the syscalls are counted for :perf.
+	int fd = open(e->filename, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+	PERF_COUNT(PERF_SYSCALLS, 1);
+	if (fd == -1) {
 		editor_statusmessage(e, STATUS_ERROR, "Unable to open '%s' for writing: %s", e->filename, strerror(errno));
 		return;
 	}
 
-	size_t bw = fwrite(e->contents, sizeof(char), e->content_length, fp);
-	if (bw <= 0) {
+	if (!write_all(fd, e->contents, e->content_length)) {
 		editor_statusmessage(e, STATUS_ERROR, "Unable write to file: %s", strerror(errno));
+		close(fd);
 		return;
 	}
 
 	editor_statusmessage(e, STATUS_INFO, "\"%s\", %d bytes written", e->filename, e->content_length);
 	e->dirty = false;
+	editor_fingerprint_contents(e);
 
-	if (fclose(fp) != 0) {
+	PERF_COUNT(PERF_SYSCALLS, 1);
+	if (close(fd) != 0) {
 		perror("Could not close file properly");
 		abort();
 	}
 }
 
+void editor_writefile(struct editor* e) {
+	assert(e->filename != NULL);
+
+	TRACE_BEGIN(TRACE_SAVE);
+	editor_writefile_contents(e);
+	TRACE_END(TRACE_SAVE);
+
+	// The sections may have moved, when bytes were inserted or deleted.
+	if (!e->dirty && e->proc == NULL && e->bdev == NULL) {
+		int fd = open(e->filename, O_RDONLY);
+		PERF_COUNT(PERF_SYSCALLS, 1);
+		if (fd != -1) {
+			editor_index_elf(e, fd);
+			editor_map_elf(e);
+			close(fd);
+			PERF_COUNT(PERF_SYSCALLS, 1);
+		}
+		editor_save_marks(e);
+	}
+}
+
 
 void editor_cursor_at_offset(struct editor* e, int offset, int* x, int* y) {
-	*x = offset % e->octets_per_line + 1;
-	*y = offset / e->octets_per_line - e->line + 1;
+	int row = editor_offset_row(e, offset);
+	*x = offset - editor_row_offset(e, row) + 1;
+	*y = row - e->line + 1;
 }
 
 
@@ -244,27 +1389,45 @@ void editor_delete_char_at_cursor(struct editor* e) {
 	if (offset >= old_length - 1) {
 		editor_move_cursor(e, KEY_LEFT, 1);
 	}
-	action_list_add(e->undo_list, ACTION_DELETE, offset, charat);
+	editor_add_action(e, ACTION_DELETE, offset, charat);
 }
 
 void editor_delete_char_at_offset(struct editor* e, unsigned int offset) {
+	editor_contents_changing(e);
+
 	// Remove an element from the contents buffer by moving memory.
 	// The character at the current offset is supposed to be removed.
 	// Take the offset + 1, until the end of the buffer. Copy that
 	// part over the offset, reallocate the contents buffer with one
 	// character in size less.
 	memmove(e->contents + offset, e->contents + offset + 1 , e->content_length - offset - 1);
-	e->contents = realloc(e->contents, e->content_length - 1);
+	e->contents = mem_realloc(MEM_CONTENTS, e->contents, e->content_length - 1);
 	e->content_length--;
 
+	if (e->sparse != NULL) {
+		sparse_map_shift(e->sparse, offset, -1);
+	}
+	if (e->marks != NULL) {
+		marks_shift(e->marks, offset, -1);
+	}
+	if (e->vmap != NULL) {
+		addr_map_shift(e->vmap, offset, -1);
+	}
+	if (e->vmap_user != NULL) {
+		addr_map_shift(e->vmap_user, offset, -1);
+	}
+	editor_contents_edited(e, offset);
+
 }
 
 void editor_increment_byte(struct editor* e, int amount) {
 	unsigned int offset = editor_offset_at_cursor(e);
 	unsigned char prev = e->contents[offset];
 	e->contents[offset] += amount;
+	e->dirty = true;
+	editor_byte_changed(e, offset);
 
-	action_list_add(e->undo_list, ACTION_REPLACE, offset, prev);
+	editor_add_action(e, ACTION_REPLACE, offset, prev);
 }
 
 
@@ -272,9 +1435,14 @@ inline int editor_offset_at_cursor(struct editor* e) {
 	// Calculate the offset based on the cursors' x and y coord (which is bound
 	// between (1 .. line width) and (1 .. max screen rows). Take the current displayed
 	// line into account (which is incremented when we are paging the content).
-	// Multiply it by octets_per_line since we're effectively addressing a one dimensional
+	// Convert the row to an offset since we're effectively addressing a one dimensional
 	// array.
-	unsigned int offset = (e->cursor_y - 1 + e->line) * e->octets_per_line + (e->cursor_x - 1);
+	unsigned int row_offset = editor_row_offset(e, e->cursor_y - 1 + e->line);
+	unsigned int column = e->cursor_x - 1;
+	if (column >= editor_row_length(e, row_offset)) {
+		column = editor_row_length(e, row_offset) - 1;
+	}
+	unsigned int offset = row_offset + column;
 	// Safety measure. Since we're using the value of this function to
 	// index the content array, we must not go out of bounds.
 	if (offset <= 0) {
@@ -288,25 +1456,231 @@ inline int editor_offset_at_cursor(struct editor* e) {
 
 
 void editor_scroll(struct editor* e, int units) {
+	// When only a window of the file is loaded, scrolling past the bounds of
+	// that window loads the part of the file we're scrolling to instead.
+	if (e->windowed) {
+		int upper_limit = editor_last_line(e);
+		int64_t line = (int64_t) e->line + units;
+		if ((line < 0 && e->window_offset > 0)
+		    || (line > upper_limit && e->window_offset + e->content_length < e->file_size)) {
+			// Rows of records differ in length, so this is where the
+			// line would be on average. That's close enough.
+			int64_t top = (int64_t) e->window_offset + line * editor_stride(e) / editor_stride_rows(e);
+			if (top < 0) {
+				top = 0;
+			}
+			e->line = editor_offset_row(e, editor_window_seek(e, top));
+			units = 0;
+		}
+	}
+
 	e->line += units;
 
 	// If we wanted to scroll past the end of the file, calculate the line
-	// properly. Subtract the amount of screen rows (minus 2??) to prevent
-	// scrolling past the end of file.
-	int upper_limit = e->content_length / e->octets_per_line - (e->screen_rows - 2);
+	// properly.
+	int upper_limit = editor_last_line(e);
 	if (e->line >= upper_limit) {
 		e->line = upper_limit;
 	}
 
-	// If we scroll past the beginning of the file (offset 0 of course),
-	// set our line to zero and return. This particular condition is also
-	// necessary when the upper_limit calculated goes negative, because
-	// This is either some weird calculation failure from my part, but
-	// this seems to work. Failing to cap this will result in bad addressing
-	// of the content in render_contents().
-	if (e->line <= 0) {
-		e->line = 0;
+	// If we scroll past the beginning of the file (offset 0 of course),
+	// set our line to zero and return. This particular condition is also
+	// necessary when the upper_limit calculated goes negative, because
+	// This is either some weird calculation failure from my part, but
+	// this seems to work. Failing to cap this will result in bad addressing
+	// of the content in render_contents().
+	if (e->line <= 0) {
+		e->line = 0;
+	}
+
+	editor_clamp_cursor(e);
+}
+
+/*
+ * Moves the cursor to the start of the next (dir > 0) or previous (dir < 0)
+ * data extent of a sparse file, skipping the holes.
+ */
+static void editor_jump_extent(struct editor* e, int dir) {
+	if (e->sparse == NULL) {
+		editor_statusmessage(e, STATUS_WARNING, "File has no holes");
+		return;
+	}
+	const struct sparse_extent* ext = sparse_map_find(e->sparse, editor_offset_at_cursor(e), dir);
+	if (ext == NULL || ext->start >= e->content_length) {
+		editor_statusmessage(e, STATUS_WARNING, "No %s data extent", dir > 0 ? "next" : "previous");
+		return;
+	}
+	editor_scroll_to_offset(e, ext->start);
+	editor_statusmessage(e, STATUS_INFO, "Data extent %u/%u: 0x%09" PRIx64 "-0x%09" PRIx64 " (%" PRIu64 " bytes)",
+		(unsigned int) (ext - e->sparse->extents) + 1, e->sparse->count, ext->start, ext->end, ext->end - ext->start);
+}
+
+/*
+ * Moves the cursor past the run of `byte' at (dir > 0) or before (dir < 0)
+ * the cursor, to the first byte which differs from it. When only part of the
+ * file is loaded, the run is followed through the next windows.
+ */
+static void editor_skip_run(struct editor* e, unsigned char byte, int dir) {
+	if (e->content_length == 0) {
+		return;
+	}
+
+	unsigned int offset = editor_offset_at_cursor(e);
+	uint64_t from = e->window_offset + offset;
+	bool found = false;
+	for (;;) {
+		uint64_t pos = e->window_offset + offset;
+		if (dir > 0) {
+			offset += run_length(e->contents + offset, e->content_length - offset, byte);
+			if (offset < e->content_length) {
+				found = true;
+				break;
+			}
+			// The run continues up to the end of the window.
+			uint64_t next = e->window_offset + e->content_length;
+			if (!e->windowed || next >= e->file_size) {
+				break;
+			}
+			offset = editor_window_seek(e, next);
+			if (e->window_offset + offset <= pos) {
+				break;
+			}
+		} else {
+			size_t run = run_length_back(e->contents, offset + 1, byte);
+			if (run <= offset) {
+				offset -= run;
+				found = true;
+				break;
+			}
+			// The run continues down to the start of the window.
+			if (!e->windowed || e->window_offset == 0) {
+				break;
+			}
+			offset = editor_window_seek(e, e->window_offset - 1);
+			if (e->window_offset + offset >= pos) {
+				break;
+			}
+		}
+	}
+
+	if (!found) {
+		// Stay where we were.
+		editor_scroll_to_offset(e, editor_window_seek(e, from));
+		editor_statusmessage(e, STATUS_WARNING, "Only %02x until the %s of the file", byte, dir > 0 ? "end" : "start");
+		return;
+	}
+
+	uint64_t to = e->window_offset + offset;
+	editor_scroll_to_offset(e, offset);
+	editor_statusmessage(e, STATUS_INFO, "Skipped %" PRIu64 " bytes of %02x",
+		dir > 0 ? to - from : from - to, byte);
+}
+
+/*
+ * Reports the entropy and byte classes of the block at the cursor in the
+ * status bar. Uses the statistics computed in the background when they are
+ * available, or computes them right away otherwise.
+ */
+static void editor_report_entropy(struct editor* e) {
+	if (e->content_length == 0) {
+		editor_statusmessage(e, STATUS_WARNING, "File is empty");
+		return;
+	}
+	unsigned int offset = editor_offset_at_cursor(e);
+	unsigned int start = offset - offset % BLOCKSTAT_BLOCK_SIZE;
+	unsigned int len = e->content_length - start < BLOCKSTAT_BLOCK_SIZE ? e->content_length - start : BLOCKSTAT_BLOCK_SIZE;
+
+	struct blockstat_block blk;
+	if (e->blockstat == NULL || e->blockstat_pending != UINT_MAX || !blockstat_get(e->blockstat, offset, &blk)) {
+		blockstat_compute(e->contents + start, len, &blk);
+	}
+	editor_statusmessage(e, STATUS_INFO,
+		"Block 0x%09" PRIx64 ": entropy %.2f bits/byte, %u%% zero, %u%% control, %u%% ASCII, %u%% high",
+		e->window_offset + start, blk.entropy,
+		blk.classes[BLOCKSTAT_ZERO] * 100 / len, blk.classes[BLOCKSTAT_CONTROL] * 100 / len,
+		blk.classes[BLOCKSTAT_ASCII] * 100 / len, blk.classes[BLOCKSTAT_HIGH] * 100 / len);
+}
+
+/*
+ * Formats a string found by :strings for the list. Strings which are not in
+ * the loaded window (anymore) are listed without their text.
+ */
+static void editor_format_string(void* data, size_t item, char* dst, size_t len) {
+	struct editor* e = data;
+	const struct string_entry* s = &e->strings->entries[item];
+	bool utf16 = s->encoding == STRING_UTF16LE;
+
+	int n = snprintf(dst, len, "0x%09" PRIx64 " %6" PRIu32 " %s  ", s->offset,
+		utf16 ? s->length / 2 : s->length, utf16 ? "utf16" : "ascii");
+	if (n < 0 || (size_t) n >= len) {
+		return;
+	}
+	if (s->offset < e->window_offset || s->offset + s->length > e->window_offset + e->content_length) {
+		snprintf(dst + n, len - n, "(not loaded)");
+		return;
+	}
+
+	// Only printable ASCII was matched, and for UTF-16LE every other byte.
+	const char* p = e->contents + (s->offset - e->window_offset);
+	size_t step = utf16 ? 2 : 1;
+	for (size_t i = 0; i < s->length && (size_t) n < len - 1; i += step) {
+		dst[n++] = p[i];
+	}
+	dst[n] = '\0';
+}
+
+static uint64_t editor_string_offset(void* data, size_t item) {
+	struct editor* e = data;
+	return e->strings->entries[item].offset;
+}
+
+/*
+ * Extracts the strings of at least `minlen' characters from the contents,
+ * and shows them in a list.
+ */
+static void editor_extract_strings(struct editor* e, unsigned int minlen) {
+	if (e->list != NULL) {
+		listview_free(e->list);
+		e->list = NULL;
+	}
+	if (e->strings != NULL) {
+		strings_free(e->strings);
+	}
+	e->strings = strings_extract(e->contents, e->content_length, minlen, e->window_offset);
+	if (e->strings->count == 0) {
+		editor_statusmessage(e, STATUS_WARNING, "No strings of at least %u characters found", minlen);
+		return;
+	}
+
+	char title[128];
+	snprintf(title, sizeof(title), "%zu strings of at least %u characters%s",
+		e->strings->count, minlen, e->windowed ? " in the loaded window" : "");
+	e->list = listview_create(title, e->strings->count, e, editor_format_string, editor_string_offset);
+	editor_setmode(e, MODE_LIST);
+}
+
+/*
+ * Formats the memory held by one kind of allocation (see mem.h) for the list
+ * shown by :stats. The last item is the total.
+ */
+static void editor_format_stat(void* data, size_t item, char* dst, size_t len) {
+	(void) data;
+	struct mem_counter c;
+	mem_stats(item, &c);
+	snprintf(dst, len, "%-9s %12" PRIu64 " bytes %10.1f KiB %9" PRIu64 " blocks %11" PRIu64 " allocations",
+		mem_kind_name(item), c.bytes, c.bytes / 1024.0, c.blocks, c.allocations);
+}
+
+/*
+ * Shows the memory held by every part of the editor in a list. The counters
+ * are read whenever the list is drawn, so it stays current.
+ */
+static void editor_show_stats(struct editor* e) {
+	if (e->list != NULL) {
+		listview_free(e->list);
 	}
+	e->list = listview_create("Memory allocated, by use", MEM_KINDS + 1, e, editor_format_stat, NULL);
+	editor_setmode(e, MODE_LIST);
 }
 
 void editor_scroll_to_offset(struct editor* e, unsigned int offset) {
@@ -319,8 +1693,8 @@ void editor_scroll_to_offset(struct editor* e, unsigned int offset) {
 	// Calculate the minimum offset visible, and the maximum. If
 	// the requested offset is within that range, do not update
 	// the e->line yet (i.e. do not scroll).
-	unsigned int offset_min = e->line * e->octets_per_line;
-	unsigned int offset_max = offset_min + (e->screen_rows * e->octets_per_line);
+	unsigned int offset_min = editor_row_offset(e, e->line);
+	unsigned int offset_max = editor_row_offset(e, e->line + e->screen_rows);
 
 	if (offset >= offset_min && offset <= offset_max) {
 		// We're within range! Update the cursor position, but
@@ -329,15 +1703,12 @@ void editor_scroll_to_offset(struct editor* e, unsigned int offset) {
 		return;
 	}
 
-	// Determine what 'line' to set, by dividing the offset to
-	// be displayed by the number of octets per line. The line
-	// is subtracted with the number of rows in the screen, divided
-	// by 2 so the cursor can be centered on the screen.
-	e->line = offset / e->octets_per_line - (e->screen_rows / 2);
+	// Determine what 'line' to set, by finding the row of the offset to
+	// be displayed. The line is subtracted with the number of rows in
+	// the screen, divided by 2 so the cursor can be centered on the screen.
+	e->line = editor_offset_row(e, offset) - (e->screen_rows / 2);
 
-	// TODO: editor_scroll uses this same limit. Probably better to refactor
-	// this part on way or another to prevent dupe.
-	int upper_limit = e->content_length / e->octets_per_line - (e->screen_rows - 2);
+	int upper_limit = editor_last_line(e);
 	if (e->line >= upper_limit) {
 		e->line = upper_limit;
 	}
@@ -361,6 +1732,7 @@ void editor_setmode(struct editor* e, enum editor_mode mode) {
 	case MODE_REPLACE:       editor_statusmessage(e, STATUS_INFO, "-- REPLACE --"); break;
 	case MODE_COMMAND: break;
 	case MODE_SEARCH:  break;
+	case MODE_LIST:    break;
 	}
 }
 
@@ -380,36 +1752,206 @@ int editor_statusmessage(struct editor* e, enum status_severity sev, const char*
 	return x;
 }
 
-void editor_render_ascii(struct editor* e, int rownum, unsigned int start_offset, struct charbuf* b) {
-	int cc = 0; // cursor counter, to check whether we should highlight the current offset.
+/*
+ * Pointers into the row scratch space of the editor.
+ */
+struct row_scratch {
+	uint64_t* printable; // whether every octet is printable, one bit each
+	char*     hex;       // two hex digits per octet
+	char*     ascii;     // the octet or a dot, one per octet
+	char*     line;      // the ASCII column with its escape sequences
+};
 
-	for (unsigned int offset = start_offset; offset < start_offset + e->octets_per_line; offset++) {
-		// Make sure we do not go out of bounds.
-		if (offset >= e->content_length) {
-			return;
+/*
+ * Returns the scratch space to render a row of the current line width. It is
+ * only reallocated when the line width grows, so rendering a row does not
+ * allocate anything.
+ */
+static struct row_scratch editor_row_scratch(struct editor* e) {
+	unsigned int n = e->octets_per_line;
+	unsigned int words = (n + 63) / 64;
+	if (e->row_scratch == NULL || e->row_scratch_octets < n) {
+		size_t size = words * sizeof(uint64_t) + 2 * n + n + 10 * n + 7;
+		e->row_scratch = mem_realloc(MEM_FRAME, e->row_scratch, size);
+		if (e->row_scratch == NULL) {
+			perror("Could not allocate memory for rendering rows");
+			abort();
 		}
+		e->row_scratch_octets = n;
+	}
 
-		cc++;
+	struct row_scratch rs;
+	rs.printable = (uint64_t*) e->row_scratch;
+	rs.hex = e->row_scratch + words * sizeof(uint64_t);
+	rs.ascii = rs.hex + 2 * n;
+	rs.line = rs.ascii + n;
+	return rs;
+}
 
-		char c =  e->contents[offset];
+/*
+ * Returns the amount of bytes of the row starting at `start_offset' there
+ * are, and sets `complete' to whether the row is not cut short by the end of
+ * the contents.
+ */
+static unsigned int editor_row_bytes(struct editor* e, unsigned int start_offset, bool* complete) {
+	unsigned int n = editor_row_length(e, start_offset);
+	*complete = start_offset + n <= e->content_length;
+	if (!*complete) {
+		n = start_offset < e->content_length ? e->content_length - start_offset : 0;
+	}
+	return n;
+}
 
+/*
+ * Renders the ASCII of the row starting at `start_offset', which is encoded
+ * in `rs' already.
+ */
+static void editor_render_ascii_encoded(struct editor* e, int rownum, unsigned int start_offset,
+                                        struct row_scratch* rs, struct charbuf* b) {
+	// A row cut short by the end of the contents is not terminated.
+	bool complete;
+	unsigned int n = editor_row_bytes(e, start_offset, &complete);
+
+	char* dst = rs->line;
+	for (unsigned int i = 0; i < n; i++) {
 		// If we need to highlight the cursor in the current iteration,
 		// do so by inverting the color (7m). In all other cases, reset (0m).
-		if (rownum == e->cursor_y && cc == e->cursor_x) {
-			charbuf_append(b, "\x1b[7m", 4);
+		if (rownum == e->cursor_y && (int) i + 1 == e->cursor_x) {
+			memcpy(dst, "\x1b[7m", 4);
 		} else {
-			charbuf_appendf(b, "\x1b[0m", 4);
+			memcpy(dst, "\x1b[0m", 4);
 		}
-
 		// Printable characters use a different color from non-printable characters.
-		if (isprint(c)) {
-			charbuf_appendf(b, "\x1b[33m%c", c);
+		memcpy(dst + 4, (rs->printable[i / 64] >> (i % 64)) & 1 ? "\x1b[33m" : "\x1b[36m", 5);
+		dst[9] = rs->ascii[i];
+		dst += 10;
+	}
+	if (complete) {
+		// Clear formatting, erase until the end of the line: \x1b[K
+		memcpy(dst, "\x1b[0m\x1b[K", 7);
+		dst += 7;
+	}
+	charbuf_append(b, rs->line, dst - rs->line);
+}
+
+void editor_render_ascii(struct editor* e, int rownum, unsigned int start_offset, struct charbuf* b) {
+	bool complete;
+	unsigned int n = editor_row_bytes(e, start_offset, &complete);
+	struct row_scratch rs = editor_row_scratch(e);
+	render_encode((unsigned char*) e->contents + start_offset, n, rs.hex, rs.ascii, rs.printable);
+	editor_render_ascii_encoded(e, rownum, start_offset, &rs, b);
+}
+
+/*
+ * Returns the width of the hex column of rows of `octets' bytes: two digits
+ * per byte, and a space in front of every group. The last group of a row
+ * may be shorter than the others.
+ */
+static int editor_hex_width(struct editor* e, int octets) {
+	return octets * 2 + (octets + e->grouping - 1) / e->grouping;
+}
+
+/*
+ * Returns the width of a line of `octets' bytes: the address, the hex column,
+ * two spaces and the ASCII column.
+ */
+static int editor_line_width(struct editor* e, int octets) {
+	return 10 + editor_hex_width(e, octets) + 2 + octets;
+}
+
+int editor_max_octets(struct editor* e) {
+	// Every octet takes at least three columns, which bounds the search.
+	int lo = 64;
+	int hi = e->screen_cols / 3 < EDITOR_MAX_OCTETS ? e->screen_cols / 3 : EDITOR_MAX_OCTETS;
+	while (lo < hi) {
+		int mid = hi - (hi - lo) / 2;
+		if (editor_line_width(e, mid) <= e->screen_cols) {
+			lo = mid;
 		} else {
-			charbuf_append(b, "\x1b[36m.", 6);
+			hi = mid - 1;
 		}
 	}
-	// Clear formatting, erase until the end of the line: \x1b[K
-	charbuf_append(b, "\x1b[0m\x1b[K", 7);
+	return lo;
+}
+
+/*
+ * Returns the first screen column to the right of the ASCII column, with
+ * one column of space in between. The side bars and panels start here.
+ */
+static int editor_side_column(struct editor* e) {
+	return editor_line_width(e, e->octets_per_line) + 2;
+}
+
+/*
+ * Renders the cell of the entropy heat bar for the row starting at `offset',
+ * colored by the entropy of the block containing it: from black (no entropy,
+ * e.g. padding) through blue, green and yellow to red (compressed or
+ * encrypted data). Blocks which are not computed yet are rendered grey.
+ */
+static void editor_render_heat(struct editor* e, unsigned int offset, struct charbuf* b) {
+	// 256 color palette indices, one per bit of entropy.
+	static const int heat_colors[] = { 16, 19, 21, 30, 34, 142, 214, 202, 196 };
+
+	charbuf_appendf(b, "\x1b[%dG", editor_side_column(e));
+	struct blockstat_block blk;
+	if (!blockstat_get(e->blockstat, offset, &blk)) {
+		PERF_COUNT(PERF_CACHE_MISSES, 1);
+		charbuf_appendf(b, "\x1b[0;90m?\x1b[0m");
+		return;
+	}
+	PERF_COUNT(PERF_CACHE_HITS, 1);
+	int idx = (int) blk.entropy;
+	if (blk.entropy >= 7.9) {
+		idx = 8;
+	} else if (idx > 7) {
+		idx = 7;
+	}
+	charbuf_appendf(b, "\x1b[48;5;%dm \x1b[0m", heat_colors[idx]);
+}
+
+/*
+ * Appends `n' spaces to `b'.
+ */
+static void editor_render_padding(struct charbuf* b, int n) {
+	static const char spaces[] = "                                ";
+	while (n > 0) {
+		int len = n < (int) sizeof(spaces) - 1 ? n : (int) sizeof(spaces) - 1;
+		charbuf_append(b, spaces, len);
+		n -= len;
+	}
+}
+
+/*
+ * Returns the address shown for the byte at `offset': the virtual address it
+ * is loaded at when virtual addresses are shown and it's mapped, or else its
+ * offset in the file (or its address in the process). Sets `mapped' when it
+ * is a virtual address.
+ */
+static uint64_t editor_address(struct editor* e, unsigned int offset, bool* mapped) {
+	uint64_t address = e->window_offset + offset;
+	uint64_t vaddr = 0;
+	*mapped = e->vaddr && addr_map_to_vaddr(e->vmap, address, &vaddr);
+	return *mapped ? vaddr : address;
+}
+
+/*
+ * Renders the address of the row starting at `offset'. When a record size is
+ * set, the first row of a record shows the index of the record instead, and
+ * the other rows of it the offset in the record.
+ */
+static void editor_render_address(struct editor* e, unsigned int offset, struct charbuf* b) {
+	uint64_t address = e->window_offset + offset;
+	if (e->record_size == 0) {
+		// With virtual addresses shown, rows which are not mapped show
+		// their offset dimmed.
+		bool mapped;
+		address = editor_address(e, offset, &mapped);
+		charbuf_appendf(b, "%s%09" PRIx64 "\x1b[0m:", e->vaddr && !mapped ? "\x1b[2;35m" : "\x1b[1;35m", address);
+	} else if (offset % e->record_size == 0) {
+		charbuf_appendf(b, "\x1b[1;35m#%08" PRIu64 "\x1b[0m:", address / e->record_size);
+	} else {
+		charbuf_appendf(b, "\x1b[0;35m+%08x\x1b[0m:", offset % e->record_size);
+	}
 }
 
 void editor_render_contents(struct editor* e, struct charbuf* b) {
@@ -419,11 +1961,9 @@ void editor_render_contents(struct editor* e, struct charbuf* b) {
 		return;
 	}
 
-	// FIXME: proper sizing of these arrays (malloc?)
-	char hex[ 32 + 1];  // example: 65
-	int  hexlen = 0;    // assigned by snprintf - we need to know the amount of chars written.
-	char asc[256 + 1];  // example: Hello.World!
-
+	// The hex digits, ASCII and printable bytes of the row being rendered,
+	// encoded all at once when the row starts.
+	struct row_scratch rs = editor_row_scratch(e);
 
 	// Counter to indicate how many chars have been written for the current
 	// row of data. This is used for later for padding, when the iteration
@@ -433,63 +1973,132 @@ void editor_render_contents(struct editor* e, struct charbuf* b) {
 	// start_offset is to determine where we should start reading from
 	// the buffer. This is dependent on where the cursor is, and on the
 	// octets which are visible per line.
-	unsigned int start_offset = e->line * e->octets_per_line;
+	unsigned int start_offset = editor_row_offset(e, e->line);
 	if (start_offset >= e->content_length) {
-		start_offset = e->content_length - e->octets_per_line;
+		start_offset = editor_row_offset(e, editor_offset_row(e, e->content_length - 1));
 	}
 
-	// Determine the end offset for displaying. There is only so much
-	// to be displayed 'per screen'. I.e. if you can only display 1024
-	// bytes, you only have to read a maximum of 1024 bytes.
-	int bytes_per_screen = e->screen_rows * e->octets_per_line;
-	unsigned int end_offset = bytes_per_screen + start_offset - e->octets_per_line;
-	if (end_offset > e->content_length) {
-		end_offset = e->content_length;
-	}
+	// The first byte of the row being rendered, and of the row after it.
+	unsigned int row_start = start_offset;
+	unsigned int row_next = start_offset;
+
+	// Runs of identical bytes spanning at least this many rows are collapsed
+	// into a single line. Rows up to the cursor are never collapsed, so the
+	// cursor stays on the screen row it's supposed to be on.
+	unsigned int collapse_min = e->collapse * e->octets_per_line;
+	unsigned int stride = editor_stride(e);
+
+	// With a structure template, the hex of every field gets one of two
+	// backgrounds, alternating from field to field. The template is only
+	// looked up once per field. It describes the file from its start, so
+	// it's not used when a window further on is loaded.
+	bool tpl = e->tpl != NULL && e->window_offset == 0;
+	unsigned int field_start = 0;
+	unsigned int field_end = 0;
+	int field_bg = 0;
+
+	// Full rows are rendered by a specialized kernel when there's one for
+	// this layout. The kernels know nothing about records or templates.
+	render_row_fn kernel = e->record_size == 0 && !tpl ? render_kernel(e->octets_per_line, e->grouping) : NULL;
+	char kernel_row[RENDER_ROW_SIZE(RENDER_KERNEL_MAX_OCTETS)];
 
 	unsigned int offset;
+	bool mapped;
 
 	int row = 0; // Row counter, from 0 to term height
 	int col = 0; // Col counter, from 0 to number of octets per line. Used to render
 	             // a colored cursor per byte.
 
-	for (offset = start_offset; offset < end_offset; offset++) {
+	for (offset = start_offset; offset < e->content_length; offset++) {
 		unsigned char curr_byte = e->contents[offset];
 
-		if (offset % e->octets_per_line == 0) {
+		if (offset == row_next) {
+			// There is only so much to be displayed 'per screen'. Stop
+			// when the screen is full.
+			if (row >= e->screen_rows - 1) {
+				break;
+			}
+
+			if (collapse_min > 0 && offset % stride == 0 && row >= e->cursor_y) {
+				// Only whole rows (or records) are collapsed.
+				size_t run = run_length(e->contents + offset, e->content_length - offset, curr_byte);
+				run -= run % stride;
+				if (run > 0 && run >= collapse_min) {
+					editor_render_address(e, offset, b);
+					charbuf_appendf(b, " \x1b[36m... %zu bytes of %02x ...\x1b[0m\x1b[K", run, curr_byte);
+					if (e->heatbar) {
+						editor_render_heat(e, offset, b);
+					}
+					charbuf_append(b, "\r\n", 2);
+					row++;
+					offset += run - 1;
+					row_next = offset + 1;
+					continue;
+				}
+			}
+
+			row_start = offset;
+			row_next = offset + editor_row_length(e, offset);
+
+			// The kernels show the address like any other. Rows which
+			// are not mapped, when virtual addresses are shown, are not.
+			uint64_t address = editor_address(e, offset, &mapped);
+			if (kernel != NULL && row_next <= e->content_length && (mapped || !e->vaddr)) {
+				row++;
+				unsigned int cursor = e->cursor_y == row ? e->cursor_x : 0;
+				size_t len = kernel(address, (unsigned char*) e->contents + offset, cursor, kernel_row);
+				charbuf_append(b, kernel_row, len);
+				if (e->heatbar) {
+					editor_render_heat(e, offset, b);
+				}
+				charbuf_append(b, "\r\n", 2);
+				offset = row_next - 1;
+				continue;
+			}
+
+			// Encode the row at once.
+			unsigned int n = (row_next < e->content_length ? row_next : e->content_length) - offset;
+			render_encode((unsigned char*) e->contents + offset, n, rs.hex, rs.ascii, rs.printable);
+
 			// start of a new row, beginning with an offset address in hex.
-			charbuf_appendf(b, "\x1b[1;35m%09x\x1b[0m:", offset);
-			// Initialize the ascii buffer to all zeroes, and reset the row char count.
-			memset(asc, '\0', sizeof(asc));
+			editor_render_address(e, offset, b);
+			// Reset the row char count.
 			row_char_count = 0;
 			col = 0;
 			row++;
 		}
 		col++;
-
-		// Format a hex string of the current character in the offset.
-		if (isprint(curr_byte)) {
-			// If the character is printable, use a different color.
-			hexlen = snprintf(hex, sizeof(hex), "\x1b[1;34m%02x", curr_byte);
-		} else {
-			// Non printable: use default color.
-			hexlen = snprintf(hex, sizeof(hex), "%02x", curr_byte);
+		unsigned int idx = offset - row_start;
+
+		if (tpl && offset >= field_end) {
+			struct template_path path;
+			if (template_find(e->tpl, (unsigned char*) e->contents, e->content_length, offset, &path)) {
+				const struct template_level* field = &path.levels[path.depth - 1];
+				field_start = field->offset;
+				field_end = field->offset + field->size;
+				field_bg = path.ordinal % 2 == 0 ? 236 : 239;
+			} else {
+				// The fields are contiguous from the start, so none
+				// of the following bytes are covered either.
+				tpl = false;
+				field_bg = 0;
+			}
 		}
 
-		// Every iteration, set the ascii value in the buffer, until
-		// 16 bytes are set. This will be written later when the hex
-		// values are drawn to screen.
-		if (isprint(curr_byte)) {
-			asc[offset % e->octets_per_line] = curr_byte;
-		} else {
-			// non-printable characters are represented by a dot.
-			asc[offset % e->octets_per_line] = '.';
+		// Every 'group' count, write a separator space. Groups start over
+		// on every row, in case the line width is not a multiple of them.
+		// Within a field, the separator gets its background as well.
+		if (idx % e->grouping == 0) {
+			if (field_bg != 0 && idx != 0 && offset != field_start) {
+				charbuf_appendf(b, "\x1b[48;5;%dm \x1b[0m", field_bg);
+			} else {
+				charbuf_append(b, " ", 1);
+			}
+			row_char_count++;
 		}
 
-		// Every 'group' count, write a separator space.
-		if (offset % e->grouping == 0) {
-			charbuf_append(b, " ", 1);
-			row_char_count++;
+		if (field_bg != 0) {
+			charbuf_appendf(b, "\x1b[48;5;%dm", field_bg);
 		}
 
 		// Cursor rendering.
@@ -500,45 +2109,47 @@ void editor_render_contents(struct editor* e, struct charbuf* b) {
 				charbuf_append(b, "\x1b[7m", 4);
 			}
 		}
-		// Write the hex value of the byte at the current offset, and reset attributes.
-		charbuf_append(b, hex, hexlen);
+		// Write the hex value of the byte at the current offset, and reset
+		// attributes. Printable characters use a different color.
+		if ((rs.printable[idx / 64] >> (idx % 64)) & 1) {
+			charbuf_append(b, "\x1b[1;34m", 7);
+		}
+		charbuf_append(b, rs.hex + 2 * idx, 2);
 		charbuf_append(b, "\x1b[0m", 4);
 
 		row_char_count += 2;
 
 		// If we reached the end of a 'row', start writing the ASCII equivalents.
-		if ((offset+1) % e->octets_per_line == 0) {
+		if (offset + 1 == row_next) {
+			// The last row of a record can be shorter than the others.
+			// Pad it, so the ASCII of all rows lines up.
+			editor_render_padding(b, editor_hex_width(e, e->octets_per_line) - row_char_count);
 			// Two spaces "gap" between the hexadecimal display, and the ASCII equiv.
 			charbuf_append(b, "  ", 2);
-			// Calculate the 'start offset' of the ASCII part to write. Delegate
-			// this to the render_ascii function.
-			int the_offset = offset + 1 - e->octets_per_line;
-			editor_render_ascii(e, row, the_offset, b);
+			// The ASCII of the row was encoded along with its hex digits.
+			editor_render_ascii_encoded(e, row, row_start, &rs, b);
+			if (e->heatbar) {
+				editor_render_heat(e, row_start, b);
+			}
 			charbuf_append(b, "\r\n", 2);
 		}
 	}
 
-	// Check remainder of the last offset. If its bigger than zero,
-	// we got a last line to write (ASCII only).
-	unsigned int leftover = offset % e->octets_per_line;
-	if (leftover > 0) {
+	// When the row was cut short by the end of the contents, we got a
+	// last line to write (ASCII only).
+	if (offset < row_next) {
 		// Padding characters, to align the ASCII properly. For example, this
 		// could be the output at the end of the file:
 		// 000000420: 0a53 4f46 5457 4152 452e 0a              .SOFTWARE..
 		//                                       ^^^^^^^^^^^^
 		//                                       padding chars
-		int padding_size = (e->octets_per_line * 2) + (e->octets_per_line / e->grouping) - row_char_count;
-		char* padding = malloc(padding_size * sizeof(char));
-		if (padding == NULL) {
-			perror("Could not allocate memory for padding");
-			abort();
-		}
-		memset(padding, ' ', padding_size);
-		charbuf_append(b, padding, padding_size);
+		editor_render_padding(b, editor_hex_width(e, e->octets_per_line) - row_char_count);
 		charbuf_append(b, "\x1b[0m  ", 6);
 		// render cursor on the ascii when applicable.
-		editor_render_ascii(e, row, offset - leftover, b);
-		free(padding);
+		editor_render_ascii_encoded(e, row, row_start, &rs, b);
+		if (e->heatbar) {
+			editor_render_heat(e, row_start, b);
+		}
 	}
 
 	// clear everything up until the end
@@ -546,13 +2157,200 @@ void editor_render_contents(struct editor* e, struct charbuf* b) {
 
 #ifndef NDEBUG
 	charbuf_appendf(b, "\x1b[0m\x1b[1;35m\x1b[1;80HRows: %d", e->screen_rows);
-	charbuf_appendf(b, "\x1b[0K\x1b[2;80HOffset: %09x - %09x", start_offset, end_offset);
+	charbuf_appendf(b, "\x1b[0K\x1b[2;80HOffset: %09x - %09x", start_offset, offset);
 	charbuf_appendf(b, "\x1b[0K\x1b[3;80H(y,x)=(%d,%d)", e->cursor_y, e->cursor_x);
 	unsigned int curr_offset = editor_offset_at_cursor(e);
 	charbuf_appendf(b, "\x1b[0K\x1b[5;80H\x1b[0KLine: %d, cursor offset: %d (hex: %02x)", e->line, curr_offset, (unsigned char) e->contents[curr_offset]);
 #endif
 }
 
+/*
+ * Returns the screen column of the data inspector panel, which is placed to
+ * the right of the ASCII column.
+ */
+static int editor_inspector_column(struct editor* e) {
+	// Leave room for the heat bar and the minimap when they're shown.
+	return editor_side_column(e) + 1 + (e->heatbar ? 1 : 0) + (e->minimap != NULL ? 1 : 0);
+}
+
+/*
+ * Renders the minimap: an overview of the whole buffer in one column, with a
+ * slice of the buffer per screen row. Every slice is colored by the class of
+ * most of its bytes: zeroes (dark grey), control characters (blue), ASCII
+ * (green) or bytes with the high bit set (red). The slices on the screen are
+ * marked. Slices are only added up again when their blocks changed.
+ */
+void editor_render_minimap(struct editor* e, struct charbuf* b) {
+	// 256 color palette indices for every byte class.
+	static const int class_colors[BLOCKSTAT_CLASSES] = { 238, 26, 28, 124 };
+
+	unsigned int slices = e->screen_rows - 1;
+	minimap_update(e->minimap, e->blockstat, slices);
+
+	// Blocks which are visible on the screen.
+	size_t top = editor_row_offset(e, e->line);
+	size_t bottom = editor_row_offset(e, e->line + e->screen_rows - 1);
+	size_t first = top / BLOCKSTAT_BLOCK_SIZE;
+	size_t last = (bottom - 1) / BLOCKSTAT_BLOCK_SIZE;
+
+	int col = editor_side_column(e) + (e->heatbar ? 1 : 0);
+	for (unsigned int i = 0; i < slices; i++) {
+		size_t start = minimap_slice_start(e->minimap, i);
+		size_t end = minimap_slice_start(e->minimap, i + 1);
+		if (end <= start) {
+			end = start + 1;
+		}
+		bool visible = start <= last && end > first;
+		int dominant = minimap_dominant(e->minimap, i);
+
+		charbuf_appendf(b, "\x1b[%d;%dH", i + 1, col);
+		if (dominant == -1) {
+			charbuf_appendf(b, "\x1b[0;90m%c\x1b[0m", visible ? '|' : '?');
+		} else {
+			charbuf_appendf(b, "\x1b[1;97;48;5;%dm%c\x1b[0m", class_colors[dominant], visible ? '|' : ' ');
+		}
+	}
+}
+
+/*
+ * Renders the data inspector panel with the values decoded at the cursor.
+ * The values are only decoded again when the bytes at the cursor changed.
+ */
+void editor_render_inspector(struct editor* e, struct charbuf* b) {
+	unsigned int offset = editor_offset_at_cursor(e);
+	unsigned int avail = offset < e->content_length ? e->content_length - offset : 0;
+	if (inspector_update(e->inspector, e->window_offset + offset, e->contents + offset, avail)) {
+		PERF_COUNT(PERF_CACHE_MISSES, 1);
+	} else {
+		PERF_COUNT(PERF_CACHE_HITS, 1);
+	}
+
+	int col = editor_inspector_column(e);
+	for (int i = 0; i < INSPECTOR_LINES && i < e->screen_rows - 1; i++) {
+		charbuf_appendf(b, "\x1b[%d;%dH\x1b[0m%s%s\x1b[0m\x1b[K", i + 1, col,
+			i == 0 ? "\x1b[1;35m" : "", e->inspector->lines[i]);
+	}
+}
+
+// Width of the template panel.
+#define TEMPLATE_PANEL_WIDTH 48
+
+/*
+ * Returns the screen column of the template panel, which is placed to the
+ * right of the data inspector when that's shown.
+ */
+static int editor_template_column(struct editor* e) {
+	return editor_inspector_column(e) + (e->inspector != NULL ? INSPECTOR_WIDTH + 1 : 0);
+}
+
+/*
+ * Renders the template panel: the path to the struct at the cursor, and the
+ * fields of that struct with the one at the cursor marked. Only the struct
+ * at the cursor is decoded.
+ */
+void editor_render_template(struct editor* e, struct charbuf* b) {
+	int col = editor_template_column(e);
+	if (col + TEMPLATE_PANEL_WIDTH > e->screen_cols + 1) {
+		return;
+	}
+	int rows = e->screen_rows - 1;
+	char line[TEMPLATE_PANEL_WIDTH + 1];
+
+	unsigned int offset = editor_offset_at_cursor(e);
+	struct template_path path;
+	if (e->window_offset != 0 ||
+			!template_find(e->tpl, (unsigned char*) e->contents, e->content_length, offset, &path)) {
+		for (int i = 0; i < rows; i++) {
+			charbuf_appendf(b, "\x1b[%d;%dH\x1b[0m%s\x1b[K", i + 1, col,
+				i == 0 ? "\x1b[1;35m(not covered by the template)\x1b[0m" : "");
+		}
+		return;
+	}
+
+	// The path to the struct, like "frames[12].header".
+	size_t len = 0;
+	line[0] = '\0';
+	for (unsigned int i = 1; i + 1 < path.depth && len < sizeof(line); i++) {
+		const struct template_level* level = &path.levels[i];
+		len += snprintf(line + len, sizeof(line) - len, "%s%s", i > 1 ? "." : "", level->name);
+		if (level->index >= 0 && len < sizeof(line)) {
+			len += snprintf(line + len, sizeof(line) - len, "[%" PRId64 "]", level->index);
+		}
+	}
+	charbuf_appendf(b, "\x1b[1;%dH\x1b[0m\x1b[1;35m%s\x1b[0m\x1b[K", col,
+		path.depth > 2 ? line : path.levels[0].type);
+
+	struct template_member members[TEMPLATE_MAX_FIELDS];
+	unsigned int count = template_members(e->tpl, (unsigned char*) e->contents, e->content_length,
+		&path, members, TEMPLATE_MAX_FIELDS);
+	unsigned int current = 0;
+	while (current + 1 < count && members[current + 1].offset <= offset) {
+		current++;
+	}
+	// Scroll the fields so the one at the cursor is shown.
+	unsigned int shown = rows > 1 ? rows - 1 : 0;
+	unsigned int first = current < shown ? 0 : current - shown + 1;
+	for (unsigned int i = 0; i < shown; i++) {
+		unsigned int m = first + i;
+		if (m >= count) {
+			charbuf_appendf(b, "\x1b[%d;%dH\x1b[0m\x1b[K", i + 2, col);
+			continue;
+		}
+		// The value is cut off at the edge of the panel: the marker, the
+		// name, the type and the spaces take 25 columns.
+		snprintf(line, sizeof(line), "%c%-12.12s %-10.10s %.*s", m == current ? '>' : ' ',
+			members[m].name, members[m].type, (int) sizeof(line) - 26, members[m].value);
+		charbuf_appendf(b, "\x1b[%d;%dH\x1b[0m%s%s\x1b[0m\x1b[K", i + 2, col,
+			m == current ? "\x1b[1m" : "", line);
+	}
+}
+
+void editor_render_perf(struct editor* e, struct charbuf* b) {
+	// Width of the overlay, including a space on both sides.
+	static const int width = 32;
+
+	uint64_t hits = perf_counters[PERF_CACHE_HITS];
+	uint64_t lookups = hits + perf_counters[PERF_CACHE_MISSES];
+	char lines[5][64];
+	snprintf(lines[0], sizeof(lines[0]), "frame   %6" PRIu64 " us %7.1f KiB",
+		perf_stats.frame_us, perf_stats.frame_bytes / 1024.0);
+	snprintf(lines[1], sizeof(lines[1]), "syscalls/key %" PRIu64, perf_stats.key_syscalls);
+	if (perf_stats.search_us > 0) {
+		snprintf(lines[2], sizeof(lines[2]), "search  %9.1f MiB/s",
+			perf_stats.search_bytes / (perf_stats.search_us / 1e6) / (1024 * 1024));
+	} else {
+		snprintf(lines[2], sizeof(lines[2]), "search  -");
+	}
+	if (lookups > 0) {
+		snprintf(lines[3], sizeof(lines[3]), "cache   %9.1f%% hits", hits * 100.0 / lookups);
+	} else {
+		snprintf(lines[3], sizeof(lines[3]), "cache   -");
+	}
+	snprintf(lines[4], sizeof(lines[4]), "rss     %9.1f MiB", perf_rss() / (1024.0 * 1024.0));
+
+	// Keep the cursor where it was, e.g. on the command line.
+	charbuf_append(b, "\x1b" "7", 2);
+	int col = e->screen_cols - width + 1 > 1 ? e->screen_cols - width + 1 : 1;
+	for (int i = 0; i < 5 && i < e->screen_rows - 1; i++) {
+		charbuf_appendf(b, "\x1b[%d;%dH\x1b[0;30;46m %-*.*s\x1b[0m", i + 1, col, width - 1, width - 2, lines[i]);
+	}
+	charbuf_append(b, "\x1b" "8", 2);
+}
+
+void editor_render_list(struct editor* e, struct charbuf* b) {
+	struct listview* lv = e->list;
+	charbuf_appendf(b, "\x1b[0m\x1b[1;35m%s\x1b[0m\x1b[K\r\n", lv->title);
+	listview_render(lv, b, e->screen_rows - 2, e->screen_cols);
+
+	if (lv->filtering) {
+		charbuf_appendf(b, "\x1b[2K/%s\x1b[?25h", lv->filter);
+		return;
+	}
+	charbuf_appendf(b, "\x1b[2K\x1b[7m%zu of %zu shown%s%s. Enter: jump, /: filter, q: close\x1b[0m",
+		lv->shown_count > 0 ? lv->selected + 1 : 0, lv->shown_count,
+		lv->filter[0] != '\0' ? ", filter: " : "", lv->filter);
+}
+
 void editor_render_help(struct editor* e) {
 	(void) e;
 	struct charbuf* b = charbuf_create();
@@ -574,6 +2372,13 @@ void editor_render_help(struct editor* e) {
 		"b       : Skip one group of bytes to the left.\r\n"
 		"gg      : Move to start of file.\r\n"
 		"G       : Move to end of file.\r\n"
+		"} / {   : Move to next/previous data extent of a sparse file.\r\n"
+		") / (   : Move past the run of the byte at the cursor.\r\n"
+		"p       : Follow the pointer at the cursor (see :pointer).\r\n"
+		"CTRL+O  : Go back to where the cursor was before the last jump.\r\n"
+		"CTRL+I  : Go forward again (TAB).\r\n"
+		"ma      : Set mark a (any of a to z) at the cursor.\r\n"
+		"'a      : Go to mark a.\r\n"
 		"x / DEL : Delete byte at cursor position.\r\n"
 		"/       : Start search input.\r\n"
 		"n       : Search for next occurrence.\r\n"
@@ -614,12 +2419,14 @@ void editor_render_ruler(struct editor* e, struct charbuf* b) {
 		return;
 	}
 
-	char rulermsg[80]; // buffer for the actual message.
+	char rulermsg[128]; // buffer for the actual message.
 	char buf[20];      // buffer for the cursor positioning
 
 	unsigned int offset_at_cursor = editor_offset_at_cursor(e);
 	unsigned char val = e->contents[offset_at_cursor];
-	int percentage = (float)(offset_at_cursor + 1) / (float)e->content_length * 100;
+	uint64_t file_offset = e->window_offset + offset_at_cursor;
+	uint64_t length = e->windowed ? e->file_size : e->content_length;
+	int percentage = (float)(file_offset + 1) / (float)length * 100;
 
 	// TODO: move cursor down etc to remain independent on the previous cursor
 	// movement in refresh_screen().
@@ -627,9 +2434,34 @@ void editor_render_ruler(struct editor* e, struct charbuf* b) {
 	// Create a ruler string. We need to calculate the amount of bytes
 	// we've actually written, to subtract that from the screen_cols to
 	// align the string properly.
-	int rmbw = snprintf(rulermsg, sizeof(rulermsg),
-			"0x%09x,%d (%02x)  %d%%",
-			offset_at_cursor, offset_at_cursor, val, percentage);
+	int rmbw = 0;
+	if (e->elf != NULL) {
+		// The section of the cursor, and the function or object.
+		const struct elf_region* section = elf_lookup(&e->elf->sections, file_offset);
+		const struct elf_region* symbol = elf_lookup(&e->elf->symbols, file_offset);
+		if (section != NULL && section->name[0] != '\0') {
+			rmbw += snprintf(rulermsg + rmbw, sizeof(rulermsg) - rmbw, "[%.20s] ", section->name);
+		}
+		if (symbol != NULL) {
+			rmbw += snprintf(rulermsg + rmbw, sizeof(rulermsg) - rmbw, "%.24s+0x%" PRIx64 " ",
+					symbol->name, file_offset - symbol->offset);
+		}
+		if (rmbw > 0) {
+			rulermsg[rmbw++] = ' ';
+		}
+	}
+	uint64_t vaddr;
+	if (e->vaddr && addr_map_to_vaddr(e->vmap, file_offset, &vaddr)) {
+		rmbw += snprintf(rulermsg + rmbw, sizeof(rulermsg) - rmbw, "v0x%" PRIx64 "  ", vaddr);
+	}
+	if (e->record_size > 0) {
+		// The record of the cursor, and the offset in it.
+		rmbw += snprintf(rulermsg + rmbw, sizeof(rulermsg) - rmbw, "#%" PRIu64 "+%" PRIu64 "  ",
+				file_offset / e->record_size, file_offset % e->record_size);
+	}
+	rmbw += snprintf(rulermsg + rmbw, sizeof(rulermsg) - rmbw,
+			"0x%09" PRIx64 ",%" PRIu64 " (%02x)  %d%%",
+			file_offset, file_offset, val, percentage);
 	if (rmbw < 0) {
 		fprintf(stderr, "Could not create ruler string!");
 		return;
@@ -675,7 +2507,22 @@ void editor_render_status(struct editor* e, struct charbuf* b) {
 
 
 void editor_refresh_screen(struct editor* e) {
-	struct charbuf* b = charbuf_create();
+	TRACE_BEGIN(TRACE_RENDER);
+	uint64_t perf_start = perf_enabled ? perf_now() : 0;
+	editor_flush_blockstat(e);
+	if (e->proc != NULL) {
+		// Memory of a live process changes. Re-read the visible pages when
+		// they're getting stale.
+		unsigned int from = editor_row_offset(e, e->line);
+		unsigned int to = editor_row_offset(e, e->line + e->screen_rows);
+		if (procmem_refresh(e->proc, e->contents, from, to) && e->blockstat != NULL) {
+			blockstat_invalidate(e->blockstat, from, to);
+		}
+	}
+
+	// The previous frame has been drawn, so its memory can be reused.
+	mem_arena_reset(&e->frame_arena);
+	struct charbuf* b = charbuf_create_in(&e->frame_arena);
 
 	charbuf_append(b, "\x1b[?25l", 6);
 	charbuf_append(b, "\x1b[H", 3); // move the cursor top left
@@ -690,6 +2537,15 @@ void editor_refresh_screen(struct editor* e) {
 			 MODE_INSERT_ASCII)) {
 
 		editor_render_contents(e, b);
+		if (e->minimap != NULL) {
+			editor_render_minimap(e, b);
+		}
+		if (e->inspector != NULL) {
+			editor_render_inspector(e, b);
+		}
+		if (e->tpl != NULL) {
+			editor_render_template(e, b);
+		}
 		editor_render_status(e, b);
 
 		// Ruler: move to the right of the screen etc.
@@ -705,6 +2561,8 @@ void editor_refresh_screen(struct editor* e) {
 			"\x1b[2K:",  // clear line, write a colon.
 			e->screen_rows);
 		charbuf_append(b, e->inputbuffer, e->inputbuffer_index);
+	} else if (e->mode & MODE_LIST) {
+		editor_render_list(e, b);
 	} else if (e->mode & MODE_SEARCH) {
 		charbuf_appendf(b,
 			"\x1b[0m"    // reset attributes
@@ -715,8 +2573,15 @@ void editor_refresh_screen(struct editor* e) {
 		charbuf_append(b, e->inputbuffer, e->inputbuffer_index);
 	}
 
+	if (perf_enabled) {
+		// The overlay itself is not part of the measurements.
+		perf_frame(perf_start, b->len);
+		editor_render_perf(e, b);
+	}
+
 	charbuf_draw(b);
 	charbuf_free(b);
+	TRACE_END(TRACE_RENDER);
 }
 
 
@@ -725,16 +2590,18 @@ void editor_insert_byte(struct editor* e, char x, bool after) {
 	editor_insert_byte_at_offset(e, offset, x, after);
 
 	if (after) {
-		action_list_add(e->undo_list, ACTION_APPEND, offset, x);
+		editor_add_action(e, ACTION_APPEND, offset, x);
 	} else {
-		action_list_add(e->undo_list, ACTION_INSERT, offset, x);
+		editor_add_action(e, ACTION_INSERT, offset, x);
 	}
 }
 
 void editor_insert_byte_at_offset(struct editor* e, unsigned int offset, char x, bool after) {
+	editor_contents_changing(e);
+
 	// We are inserting a single character. Reallocate memory to contain
 	// this extra byte.
-	e->contents = realloc(e->contents, e->content_length + 1);
+	e->contents = mem_realloc(MEM_CONTENTS, e->contents, e->content_length + 1);
 
 	if (after && e->content_length) { // append is the same as insert when buffer is empty
 		offset++;
@@ -746,32 +2613,366 @@ void editor_insert_byte_at_offset(struct editor* e, unsigned int offset, char x,
 
 	e->contents[offset] = x;
 
-	// Increase the content length since we inserted a character.
-	e->content_length++;
+	// Increase the content length since we inserted a character.
+	e->content_length++;
+
+	if (e->sparse != NULL) {
+		sparse_map_shift(e->sparse, offset, 1);
+	}
+	if (e->marks != NULL) {
+		marks_shift(e->marks, offset, 1);
+	}
+	if (e->vmap != NULL) {
+		addr_map_shift(e->vmap, offset, 1);
+	}
+	if (e->vmap_user != NULL) {
+		addr_map_shift(e->vmap_user, offset, 1);
+	}
+	editor_contents_edited(e, offset);
+
+	e->dirty = true;
+
+}
+
+
+void editor_replace_byte(struct editor* e, char x) {
+	unsigned int offset = editor_offset_at_cursor(e);
+	unsigned char prev = e->contents[offset];
+	e->contents[offset] = x;
+	editor_move_cursor(e, KEY_RIGHT, 1);
+	editor_statusmessage(e, STATUS_INFO, "Replaced byte at offset %09x with %02x", offset, (unsigned char) x);
+	e->dirty = true;
+	editor_byte_changed(e, offset);
+
+	editor_add_action(e, ACTION_REPLACE, offset, prev);
+}
+
+/*
+ * Starts computing block statistics in the background when the heat bar or
+ * the minimap is shown, or stops it when neither is.
+ */
+static void editor_update_blockstat(struct editor* e) {
+	bool needed = e->heatbar || e->minimap != NULL;
+	if (needed && e->blockstat == NULL) {
+		e->blockstat = blockstat_create(SIGUSR1);
+		blockstat_reset(e->blockstat, e->contents, e->content_length, 0);
+		e->blockstat_pending = UINT_MAX;
+	} else if (!needed && e->blockstat != NULL) {
+		blockstat_free(e->blockstat);
+		e->blockstat = NULL;
+		e->blockstat_pending = UINT_MAX;
+	}
+}
+
+/*
+ * Goes to `offset', recording where the cursor was in the jump list.
+ */
+static void editor_jump(struct editor* e, uint64_t offset) {
+	jump_list_push(&e->jumps, e->window_offset + editor_offset_at_cursor(e));
+	editor_scroll_to_offset(e, editor_window_seek(e, offset));
+}
+
+/*
+ * Goes to the offset mapped at virtual address `vaddr'.
+ */
+static void editor_goto_vaddr(struct editor* e, uint64_t vaddr) {
+	uint64_t length = e->windowed ? e->file_size : e->content_length;
+	uint64_t offset;
+	if (!addr_map_to_offset(e->vmap, vaddr, &offset)) {
+		editor_statusmessage(e, STATUS_ERROR, "Nothing is mapped at 0x%" PRIx64, vaddr);
+		return;
+	}
+	if (offset >= length) {
+		editor_statusmessage(e, STATUS_ERROR, "0x%" PRIx64 " is mapped beyond the end, at offset 0x%09" PRIx64,
+			vaddr, offset);
+		return;
+	}
+	editor_jump(e, offset);
+	editor_statusmessage(e, STATUS_INFO, "Positioned to 0x%" PRIx64 " at offset 0x%09" PRIx64 " (%" PRIu64 ")",
+		vaddr, offset, offset);
+}
+
+/*
+ * Reads the pointer at the cursor and goes to where it points: the offset
+ * it holds minus the base set with :pointer, or the virtual address it
+ * holds when virtual addresses are shown.
+ */
+static void editor_follow_pointer(struct editor* e) {
+	uint64_t length = e->windowed ? e->file_size : e->content_length;
+	unsigned int offset = editor_offset_at_cursor(e);
+	if (e->content_length < e->pointer_size || offset > e->content_length - e->pointer_size) {
+		editor_statusmessage(e, STATUS_ERROR, "Not enough bytes at the cursor for a %u byte pointer", e->pointer_size);
+		return;
+	}
+
+	uint64_t value = 0;
+	for (unsigned int i = 0; i < e->pointer_size; i++) {
+		unsigned int at = e->pointer_big_endian ? i : e->pointer_size - 1 - i;
+		value = value << 8 | (unsigned char) e->contents[offset + at];
+	}
+	if (e->vaddr) {
+		editor_goto_vaddr(e, value);
+		return;
+	}
+	if (value < e->pointer_base || value - e->pointer_base >= length) {
+		editor_statusmessage(e, STATUS_ERROR, "Pointer 0x%" PRIx64 " points outside of the file", value);
+		return;
+	}
+	editor_jump(e, value - e->pointer_base);
+	editor_statusmessage(e, STATUS_INFO, "Followed 0x%" PRIx64 " to offset 0x%09" PRIx64,
+		value, value - e->pointer_base);
+}
+
+/*
+ * Goes back to where the cursor was before the last jump (CTRL-O), or
+ * forward again (CTRL-I).
+ */
+static void editor_jump_back(struct editor* e, bool back) {
+	uint64_t length = e->windowed ? e->file_size : e->content_length;
+	uint64_t current = e->window_offset + editor_offset_at_cursor(e);
+	uint64_t offset;
+	if (back ? !jump_list_back(&e->jumps, current, &offset) : !jump_list_forward(&e->jumps, current, &offset)) {
+		editor_statusmessage(e, STATUS_INFO, "At the %s jump", back ? "oldest" : "newest");
+		return;
+	}
+	// The file may have shrunk since.
+	if (offset >= length) {
+		offset = length > 0 ? length - 1 : 0;
+	}
+	editor_scroll_to_offset(e, editor_window_seek(e, offset));
+	editor_statusmessage(e, STATUS_INFO, "Positioned to offset 0x%09" PRIx64 " (%" PRIu64 ")", offset, offset);
+}
+
+/*
+ * Sets the mark (or bookmark) `name' at the cursor.
+ */
+static void editor_set_mark(struct editor* e, const char* name, const char* comment) {
+	if (e->marks == NULL) {
+		e->marks = marks_create();
+	}
+	uint64_t offset = e->window_offset + editor_offset_at_cursor(e);
+	marks_set(e->marks, name, offset, comment);
+	editor_statusmessage(e, STATUS_INFO, "Mark %s set at offset 0x%09" PRIx64, name, offset);
+	editor_save_marks(e);
+}
+
+/*
+ * Goes to the mark (or bookmark) `name'. Returns false if it's not set.
+ */
+static bool editor_goto_mark(struct editor* e, const char* name) {
+	uint64_t length = e->windowed ? e->file_size : e->content_length;
+	int i = e->marks != NULL ? marks_find(e->marks, name) : -1;
+	if (i == -1) {
+		return false;
+	}
+	// The marks of bytes deleted at the end are just past it.
+	uint64_t offset = marks_offset(e->marks, i);
+	if (offset >= length) {
+		offset = length > 0 ? length - 1 : 0;
+	}
+	editor_jump(e, offset);
+	editor_statusmessage(e, STATUS_INFO, "Positioned to %s at offset 0x%09" PRIx64 " (%" PRIu64 ")",
+		name, offset, offset);
+	return true;
+}
+
+/*
+ * Handles m{a-z}, which sets a mark at the cursor, and '{a-z}, which goes to
+ * the mark.
+ */
+static void editor_mark_key(struct editor* e, int key) {
+	// Read the name of the mark. Signals are not a reason to stop waiting.
+	int c;
+	while ((c = read_key()) == -1);
+	if (c < 'a' || c > 'z') {
+		editor_statusmessage(e, STATUS_ERROR, "Marks are named a to z");
+		return;
+	}
+	char name[2] = { (char) c, '\0' };
+	if (key == 'm') {
+		editor_set_mark(e, name, "");
+	} else if (!editor_goto_mark(e, name)) {
+		editor_statusmessage(e, STATUS_ERROR, "Mark %s is not set", name);
+	}
+}
+
+/*
+ * Formats a mark for the list shown by :bookmarks.
+ */
+static void editor_format_mark(void* data, size_t item, char* dst, size_t len) {
+	struct editor* e = data;
+	if (e->marks == NULL || item >= e->marks->count) {
+		// Removed since the list was made.
+		snprintf(dst, len, "-");
+		return;
+	}
+	const struct mark* mark = &e->marks->marks[item];
+	snprintf(dst, len, "%-12s 0x%09" PRIx64 "  %s", mark->name, marks_offset(e->marks, item), mark->comment);
+}
+
+static uint64_t editor_mark_offset(void* data, size_t item) {
+	struct editor* e = data;
+	if (e->marks == NULL || item >= e->marks->count) {
+		return e->window_offset + editor_offset_at_cursor(e);
+	}
+	return marks_offset(e->marks, item);
+}
+
+/*
+ * Handles :bookmark, which sets a bookmark with an optional comment at the
+ * cursor, like `:bookmark header the first header'.
+ */
+static void editor_bookmark(struct editor* e, const char* args) {
+	size_t n = strcspn(args, " ");
+	if (n == 0 || n >= MARK_NAME_SIZE) {
+		editor_statusmessage(e, STATUS_ERROR, "bookmark command format: `bookmark name [comment]'");
+		return;
+	}
+	char name[MARK_NAME_SIZE];
+	memcpy(name, args, n);
+	name[n] = '\0';
+	const char* comment = args + n;
+	while (*comment == ' ') {
+		comment++;
+	}
+	editor_set_mark(e, name, comment);
+}
+
+/*
+ * Formats a range of the address map for the list shown by :map.
+ */
+static void editor_format_range(void* data, size_t item, char* dst, size_t len) {
+	struct editor* e = data;
+	const struct addr_range* r = &e->vmap->ranges[item];
+	snprintf(dst, len, "0x%09" PRIx64 "-0x%09" PRIx64 "  at 0x%" PRIx64 "-0x%" PRIx64 "  %" PRIu64 " bytes",
+		r->offset, r->offset + r->size, r->vaddr, r->vaddr + r->size, r->size);
+}
 
-	e->dirty = true;
+static uint64_t editor_range_offset(void* data, size_t item) {
+	struct editor* e = data;
+	return e->vmap->ranges[item].offset;
+}
 
+/*
+ * Parses the number (base 10, or base 16 with 0x) at `*p', and moves `*p'
+ * past it and the spaces after it.
+ */
+static bool editor_parse_number(const char** p, uint64_t* value) {
+	if (!isdigit((unsigned char) **p)) {
+		return false;
+	}
+	char* end;
+	errno = 0;
+	*value = strtoull(*p, &end, 0);
+	if (errno == ERANGE || (*end != '\0' && *end != ' ')) {
+		return false;
+	}
+	while (*end == ' ') {
+		end++;
+	}
+	*p = end;
+	return true;
 }
 
+/*
+ * Handles :map, which maps a range of the file to virtual addresses, or
+ * lists the ranges mapped without arguments.
+ */
+static void editor_map(struct editor* e, const char* args) {
+	if (*args == '\0') {
+		if (e->vmap == NULL || e->vmap->count == 0) {
+			editor_statusmessage(e, STATUS_WARNING, "Nothing is mapped, use :map offset vaddr size");
+			return;
+		}
+		if (e->list != NULL) {
+			listview_free(e->list);
+		}
+		char title[80];
+		snprintf(title, sizeof(title), "%u ranges mapped to virtual addresses", e->vmap->count);
+		e->list = listview_create(title, e->vmap->count, e, editor_format_range, editor_range_offset);
+		editor_setmode(e, MODE_LIST);
+		return;
+	}
 
-void editor_replace_byte(struct editor* e, char x) {
-	unsigned int offset = editor_offset_at_cursor(e);
-	unsigned char prev = e->contents[offset];
-	e->contents[offset] = x;
-	editor_move_cursor(e, KEY_RIGHT, 1);
-	editor_statusmessage(e, STATUS_INFO, "Replaced byte at offset %09x with %02x", offset, (unsigned char) x);
-	e->dirty = true;
+	uint64_t offset;
+	uint64_t vaddr;
+	uint64_t size;
+	if (!editor_parse_number(&args, &offset) || !editor_parse_number(&args, &vaddr) ||
+			!editor_parse_number(&args, &size) || *args != '\0') {
+		editor_statusmessage(e, STATUS_ERROR, "map command format: `map offset vaddr size'");
+		return;
+	}
+	if (e->vmap == NULL) {
+		e->vmap = addr_map_create();
+	}
+	if (!addr_map_add(e->vmap, offset, vaddr, size)) {
+		editor_statusmessage(e, STATUS_ERROR, "The range is empty, or overlaps one already mapped");
+		return;
+	}
+	if (e->vmap_user == NULL) {
+		e->vmap_user = addr_map_create();
+	}
+	addr_map_add(e->vmap_user, offset, vaddr, size);
+	e->vaddr = true;
+	clear_screen();
+	editor_statusmessage(e, STATUS_INFO, "Mapped 0x%" PRIx64 "-0x%" PRIx64 " to 0x%" PRIx64,
+		offset, offset + size, vaddr);
+}
 
-	action_list_add(e->undo_list, ACTION_REPLACE, offset, prev);
+/*
+ * Handles :pointer, which sets the size, byte order and base of the pointers
+ * followed with `p', like `:pointer 4 be 0x8000000'. Without arguments, it
+ * shows them.
+ */
+static void editor_pointer(struct editor* e, const char* args) {
+	if (*args != '\0') {
+		uint64_t size;
+		uint64_t base = e->pointer_base;
+		bool big_endian = e->pointer_big_endian;
+		bool valid = editor_parse_number(&args, &size) && (size == 4 || size == 8);
+		if (valid && (strncmp(args, "le", 2) == 0 || strncmp(args, "be", 2) == 0) &&
+				(args[2] == '\0' || args[2] == ' ')) {
+			big_endian = args[0] == 'b';
+			args += 2;
+			while (*args == ' ') {
+				args++;
+			}
+		}
+		if (valid && *args != '\0') {
+			valid = editor_parse_number(&args, &base) && *args == '\0';
+		}
+		if (!valid) {
+			editor_statusmessage(e, STATUS_ERROR, "pointer command format: `pointer 4|8 [le|be] [base]'");
+			return;
+		}
+		e->pointer_size = size;
+		e->pointer_big_endian = big_endian;
+		e->pointer_base = base;
+	}
+	editor_statusmessage(e, STATUS_INFO, "Pointers are %u bytes, %s endian, based at 0x%" PRIx64,
+		e->pointer_size, e->pointer_big_endian ? "big" : "little", e->pointer_base);
 }
 
 void editor_process_command(struct editor* e, const char* cmd) {
+	// Offsets given by the user are offsets in the file (or addresses of the
+	// process). When only a window is loaded, those are translated with
+	// editor_window_seek().
+	uint64_t length = e->windowed ? e->file_size : e->content_length;
+
 	// Command: go to base 10 offset
 	bool b = is_pos_num(cmd);
 	if (b) {
-		int offset = str2int(cmd, 0, e->content_length, e->content_length - 1);
-		editor_scroll_to_offset(e, offset);
-		editor_statusmessage(e, STATUS_INFO, "Positioned to offset 0x%09x (%d)", offset, offset);
+		errno = 0;
+		uint64_t offset = strtoull(cmd, NULL, 10);
+		if (e->vaddr) {
+			editor_goto_vaddr(e, errno == ERANGE ? UINT64_MAX : offset);
+			return;
+		}
+		if (errno == ERANGE || offset >= length) {
+			offset = length > 0 ? length - 1 : 0;
+		}
+		editor_jump(e, offset);
+		editor_statusmessage(e, STATUS_INFO, "Positioned to offset 0x%09" PRIx64 " (%" PRIu64 ")", offset, offset);
 		return;
 	}
 
@@ -783,9 +2984,100 @@ void editor_process_command(struct editor* e, const char* cmd) {
 			return;
 		}
 
-		int offset = hex2int(ptr);
-		editor_scroll_to_offset(e, offset);
-		editor_statusmessage(e, STATUS_INFO, "Positioned to offset 0x%09x (%d)", offset, offset);
+		uint64_t offset = strtoull(ptr, NULL, 16);
+		if (e->vaddr) {
+			editor_goto_vaddr(e, offset);
+			return;
+		}
+		editor_jump(e, offset);
+		editor_statusmessage(e, STATUS_INFO, "Positioned to offset 0x%09" PRIx64 " (%" PRIu64 ")", offset, offset);
+		return;
+	}
+
+	// Command: go to a record. The offset is known right away, since all
+	// records have the same size.
+	if (cmd[0] == '#') {
+		if (e->record_size == 0) {
+			editor_statusmessage(e, STATUS_ERROR, "No record size set, use :set record=N first");
+			return;
+		}
+		if (!is_pos_num(cmd + 1)) {
+			editor_statusmessage(e, STATUS_ERROR, "Error: %s is not a record number", cmd + 1);
+			return;
+		}
+		errno = 0;
+		uint64_t record = strtoull(cmd + 1, NULL, 10);
+		uint64_t records = (length + e->record_size - 1) / e->record_size;
+		if (errno == ERANGE || record >= records) {
+			record = records > 0 ? records - 1 : 0;
+		}
+		editor_jump(e, record * e->record_size);
+		editor_statusmessage(e, STATUS_INFO, "Positioned to record %" PRIu64 " at offset 0x%09" PRIx64,
+			record, record * e->record_size);
+		return;
+	}
+
+	// Command: go to a bookmark, or a section or symbol of an ELF file.
+	if (strncmp(cmd, "goto ", 5) == 0) {
+		if (editor_goto_mark(e, cmd + 5)) {
+			return;
+		}
+		if (e->elf == NULL) {
+			editor_statusmessage(e, STATUS_ERROR, "No bookmark called %s (and no ELF sections or symbols)", cmd + 5);
+			return;
+		}
+		const struct elf_region* region = elf_find(e->elf, cmd + 5);
+		if (region == NULL) {
+			editor_statusmessage(e, STATUS_ERROR, "No bookmark, section or symbol called %s", cmd + 5);
+			return;
+		}
+		if (region->offset >= length) {
+			editor_statusmessage(e, STATUS_ERROR, "%s is beyond the end at 0x%09" PRIx64, cmd + 5, region->offset);
+			return;
+		}
+		editor_jump(e, region->offset);
+		editor_statusmessage(e, STATUS_INFO, "Positioned to %s at offset 0x%09" PRIx64 " (%" PRIu64 " bytes)",
+			region->name, region->offset, region->size);
+		return;
+	}
+
+	if (strncmp(cmd, "bookmarks", INPUT_BUF_SIZE) == 0) {
+		if (e->marks == NULL || e->marks->count == 0) {
+			editor_statusmessage(e, STATUS_WARNING, "No marks or bookmarks, use m{a-z} or :bookmark name");
+			return;
+		}
+		if (e->list != NULL) {
+			listview_free(e->list);
+		}
+		char title[80];
+		snprintf(title, sizeof(title), "%u marks and bookmarks", e->marks->count);
+		e->list = listview_create(title, e->marks->count, e, editor_format_mark, editor_mark_offset);
+		editor_setmode(e, MODE_LIST);
+		return;
+	}
+
+	if (strncmp(cmd, "bookmark ", 9) == 0) {
+		editor_bookmark(e, cmd + 9);
+		return;
+	}
+
+	if (strncmp(cmd, "delmark ", 8) == 0) {
+		if (e->marks == NULL || !marks_remove(e->marks, cmd + 8)) {
+			editor_statusmessage(e, STATUS_ERROR, "No mark or bookmark called %s", cmd + 8);
+			return;
+		}
+		editor_statusmessage(e, STATUS_INFO, "Removed %s", cmd + 8);
+		editor_save_marks(e);
+		return;
+	}
+
+	if (strncmp(cmd, "pointer", 7) == 0 && (cmd[7] == '\0' || cmd[7] == ' ')) {
+		editor_pointer(e, cmd[7] == ' ' ? cmd + 8 : cmd + 7);
+		return;
+	}
+
+	if (strncmp(cmd, "map", 3) == 0 && (cmd[3] == '\0' || cmd[3] == ' ')) {
+		editor_map(e, cmd[3] == ' ' ? cmd + 4 : cmd + 3);
 		return;
 	}
 
@@ -813,6 +3105,117 @@ void editor_process_command(struct editor* e, const char* cmd) {
 		return;
 	}
 
+	if (strncmp(cmd, "e!", INPUT_BUF_SIZE) == 0) {
+		if (e->windowed) {
+			editor_statusmessage(e, STATUS_ERROR, "Cannot reload when only part of the file is loaded");
+			return;
+		}
+		editor_reload(e, true);
+		return;
+	}
+
+	// Skip to the next byte which differs from the given byte value.
+	if (strncmp(cmd, "skip ", 5) == 0) {
+		const char* arg = cmd + 5;
+		if (strncmp(arg, "0x", 2) == 0) {
+			arg += 2;
+		}
+		if (strlen(arg) != 2 || !is_hex(arg)) {
+			editor_statusmessage(e, STATUS_ERROR, "skip command format: `skip XY' (hexadecimal byte)");
+			return;
+		}
+		editor_skip_run(e, hex2int(arg), 1);
+		return;
+	}
+
+	if (strncmp(cmd, "entropy", INPUT_BUF_SIZE) == 0) {
+		editor_report_entropy(e);
+		return;
+	}
+
+	if (strncmp(cmd, "inspect", INPUT_BUF_SIZE) == 0) {
+		if (e->inspector != NULL) {
+			inspector_free(e->inspector);
+			e->inspector = NULL;
+			clear_screen();
+			return;
+		}
+		if (editor_inspector_column(e) + INSPECTOR_WIDTH > e->screen_cols + 1) {
+			editor_statusmessage(e, STATUS_ERROR, "Terminal is too narrow for the data inspector");
+			return;
+		}
+		e->inspector = inspector_create();
+		return;
+	}
+
+	if (strncmp(cmd, "template", 8) == 0 && (cmd[8] == '\0' || cmd[8] == ' ')) {
+		if (cmd[8] == '\0') {
+			if (e->tpl == NULL) {
+				editor_statusmessage(e, STATUS_ERROR, "template command format: `template file'");
+				return;
+			}
+			template_free(e->tpl);
+			e->tpl = NULL;
+			clear_screen();
+			return;
+		}
+		char err[80];
+		struct template* tpl = template_load(cmd + 9, err, sizeof(err));
+		if (tpl == NULL) {
+			editor_statusmessage(e, STATUS_ERROR, "Cannot load template %s: %s", cmd + 9, err);
+			return;
+		}
+		if (e->tpl != NULL) {
+			template_free(e->tpl);
+		}
+		e->tpl = tpl;
+		if (editor_template_column(e) + TEMPLATE_PANEL_WIDTH > e->screen_cols + 1) {
+			editor_statusmessage(e, STATUS_WARNING, "Template loaded, but the terminal is too narrow for its panel");
+		} else if (e->windowed) {
+			editor_statusmessage(e, STATUS_INFO, "Template loaded, it covers the file while its start is loaded");
+		} else {
+			editor_statusmessage(e, STATUS_INFO, "Template %s loaded", cmd + 9);
+		}
+		return;
+	}
+
+	if (strncmp(cmd, "strings", 7) == 0 && (cmd[7] == '\0' || cmd[7] == ' ')) {
+		unsigned int minlen = 4;
+		if (cmd[7] == ' ') {
+			if (!is_pos_num(cmd + 8) || (minlen = atoi(cmd + 8)) == 0) {
+				editor_statusmessage(e, STATUS_ERROR, "strings command format: `strings [minlen]'");
+				return;
+			}
+		}
+		editor_extract_strings(e, minlen);
+		return;
+	}
+
+	if (strncmp(cmd, "stats", INPUT_BUF_SIZE) == 0) {
+		editor_show_stats(e);
+		return;
+	}
+
+	if (strncmp(cmd, "list", INPUT_BUF_SIZE) == 0) {
+		if (e->list == NULL) {
+			editor_statusmessage(e, STATUS_ERROR, "No list to show, use :strings or :stats first");
+			return;
+		}
+		editor_setmode(e, MODE_LIST);
+		return;
+	}
+
+	if (strncmp(cmd, "perf", INPUT_BUF_SIZE) == 0) {
+		perf_enable(!perf_enabled);
+		clear_screen();
+		return;
+	}
+
+	if (strncmp(cmd, "follow", INPUT_BUF_SIZE) == 0) {
+		editor_follow(e, !e->follow);
+		return;
+	}
+
 	if (strncmp(cmd, "help", INPUT_BUF_SIZE) == 0) {
 		editor_render_help(e);
 		return;
@@ -833,7 +3236,7 @@ void editor_process_command(struct editor* e, const char* cmd) {
 		}
 
 		if (strcmp(setcmd, "octets") == 0 || strcmp(setcmd, "o") == 0) {
-			int octets = clampi(setval, 16, 64);
+			int octets = clampi(setval, 1, editor_max_octets(e));
 
 			clear_screen();
 			int offset = editor_offset_at_cursor(e);
@@ -845,6 +3248,117 @@ void editor_process_command(struct editor* e, const char* cmd) {
 			return;
 		}
 
+		// Start every record of this size on a new row. Zero disables it.
+		if (strcmp(setcmd, "record") == 0) {
+			uint64_t offset = e->window_offset + editor_offset_at_cursor(e);
+			e->record_size = setval < 0 ? 0 : setval;
+			if (e->record_field >= 0 && (unsigned int) e->record_field >= e->record_size) {
+				e->record_field = -1;
+			}
+			if (e->windowed && e->proc == NULL) {
+				// Load a window starting at a record, since rows and
+				// records are counted from the start of the window.
+				editor_window_load(e, e->window_offset);
+			}
+			clear_screen();
+			e->line = 0;
+			editor_scroll_to_offset(e, editor_window_seek(e, offset));
+			if (e->record_size == 0) {
+				editor_statusmessage(e, STATUS_INFO, "Records disabled");
+			} else {
+				editor_statusmessage(e, STATUS_INFO, "Record size set to %u", e->record_size);
+			}
+			return;
+		}
+
+		// Only match searches at this offset in every record. A negative
+		// offset searches everywhere again.
+		if (strcmp(setcmd, "field") == 0) {
+			if (setval >= 0 && (e->record_size == 0 || (unsigned int) setval >= e->record_size)) {
+				editor_statusmessage(e, STATUS_ERROR, "Field offset must be within the record size");
+				return;
+			}
+			e->record_field = setval < 0 ? -1 : setval;
+			if (e->record_field < 0) {
+				editor_statusmessage(e, STATUS_INFO, "Searching everywhere");
+			} else {
+				editor_statusmessage(e, STATUS_INFO, "Searching at offset %d of every record", e->record_field);
+			}
+			return;
+		}
+
+		// Set the size of the window (in KiB) used when only part of the
+		// file is loaded. Takes effect when the next window is loaded.
+		if (strcmp(setcmd, "window") == 0 || strcmp(setcmd, "win") == 0) {
+			int kib = clampi(setval, 64, 1024 * 1024);
+			e->window_size = kib * 1024;
+			editor_statusmessage(e, STATUS_INFO, "Window size set to %d KiB", kib);
+			return;
+		}
+
+		// Collapse runs of identical bytes spanning at least this many rows
+		// into a single line. Zero disables it.
+		if (strcmp(setcmd, "collapse") == 0) {
+			e->collapse = setval <= 0 ? 0 : clampi(setval, 2, 1024);
+			if (e->collapse == 0) {
+				editor_statusmessage(e, STATUS_INFO, "Collapsing runs disabled");
+			} else {
+				editor_statusmessage(e, STATUS_INFO, "Collapsing runs of %u rows or more", e->collapse);
+			}
+			return;
+		}
+
+		// Show the entropy heat bar, computing the statistics of all blocks
+		// in the background.
+		if (strcmp(setcmd, "entropy") == 0) {
+			e->heatbar = setval != 0;
+			editor_update_blockstat(e);
+			clear_screen();
+			editor_statusmessage(e, STATUS_INFO, "Entropy heat bar %s", setval != 0 ? "enabled" : "disabled");
+			return;
+		}
+
+		// Show the minimap, which is built from the same statistics.
+		if (strcmp(setcmd, "minimap") == 0) {
+			if (setval != 0 && e->minimap == NULL) {
+				e->minimap = minimap_create();
+			} else if (setval == 0 && e->minimap != NULL) {
+				minimap_free(e->minimap);
+				e->minimap = NULL;
+			}
+			editor_update_blockstat(e);
+			clear_screen();
+			editor_statusmessage(e, STATUS_INFO, "Minimap %s", setval != 0 ? "enabled" : "disabled");
+			return;
+		}
+
+		// Use O_DIRECT for reading and writing block devices, bypassing
+		// the page cache.
+		if (strcmp(setcmd, "direct") == 0) {
+			if (e->bdev == NULL) {
+				editor_statusmessage(e, STATUS_ERROR, "Direct I/O is only available for block devices");
+				return;
+			}
+			if (!blockdev_set_direct(e->bdev, setval != 0)) {
+				editor_statusmessage(e, STATUS_ERROR, "Unable to reopen '%s': %s", e->filename, strerror(errno));
+				return;
+			}
+			editor_statusmessage(e, STATUS_INFO, "Direct I/O %s", setval != 0 ? "enabled" : "disabled");
+			return;
+		}
+
+		// Show (and enter) virtual addresses instead of offsets.
+		if (strcmp(setcmd, "vaddr") == 0) {
+			if (setval != 0 && (e->vmap == NULL || e->vmap->count == 0)) {
+				editor_statusmessage(e, STATUS_ERROR, "Nothing is mapped, use :map offset vaddr size");
+				return;
+			}
+			e->vaddr = setval != 0;
+			clear_screen();
+			editor_statusmessage(e, STATUS_INFO, "Showing %s", e->vaddr ? "virtual addresses" : "offsets");
+			return;
+		}
+
 		// Set the grouping of bytes to a different value.
 		if (strcmp(setcmd, "grouping") == 0 || strcmp(setcmd, "g") == 0) {
 			int grouping = clampi(setval, 4, 16);
@@ -883,7 +3397,7 @@ void editor_process_search(struct editor* e, const char* str, enum search_direct
 		return;
 	}
 
-	struct charbuf *parsedstr = charbuf_create();
+	struct charbuf *parsedstr = charbuf_create_in(&e->scratch_arena);
 	const char* parse_err;
 	int parse_errno = editor_parse_search_string(str, parsedstr,
 						     &parse_err);
@@ -917,13 +3431,47 @@ void editor_process_search(struct editor* e, const char* str, enum search_direct
 
 	if (parse_errno != PARSE_SUCCESS) {
 		// We printed an error message but we didn't return.
-		charbuf_free(parsedstr);
+		mem_arena_reset(&e->scratch_arena);
 		return;
 	}
 
 	unsigned int current_offset = editor_offset_at_cursor(e);
+	unsigned int search_start = current_offset;
+	uint64_t perf_start = perf_enabled ? perf_now() : 0;
 	bool found = false;
-	if (dir == SEARCH_FORWARD) {
+	TRACE_BEGIN(TRACE_SEARCH);
+	if (e->record_size > 0 && e->record_field >= 0) {
+		// Only compare the field at the same offset of every record.
+		unsigned int stride = e->record_size;
+		unsigned int field = (e->record_field + stride - e->window_offset % stride) % stride;
+		const unsigned char* p = (const unsigned char*) e->contents;
+		const unsigned char* pattern = (const unsigned char*) parsedstr->contents;
+		unsigned int at = e->content_length;
+		if (dir == SEARCH_FORWARD) {
+			// The first field after the cursor.
+			unsigned int from = current_offset + 1;
+			from += (field + stride - from % stride) % stride;
+			if (from < e->content_length) {
+				at = search_strided(p, e->content_length, from, stride, pattern, parsedstr->len);
+			}
+			current_offset = at;
+		} else {
+			// The last field before the cursor.
+			unsigned int from = current_offset - 1;
+			unsigned int back = (from % stride + stride - field) % stride;
+			if (from >= back) {
+				at = search_strided_back(p, e->content_length, from - back, stride, pattern, parsedstr->len);
+			}
+			if (at < e->content_length) {
+				current_offset = at;
+			}
+		}
+		if (at < e->content_length) {
+			editor_statusmessage(e, STATUS_INFO, "");
+			editor_scroll_to_offset(e, at);
+			found = true;
+		}
+	} else if (dir == SEARCH_FORWARD) {
 		current_offset++;
 		for (; current_offset < e->content_length; current_offset++) {
 			if (memcmp(e->contents + current_offset,
@@ -951,8 +3499,19 @@ void editor_process_search(struct editor* e, const char* str, enum search_direct
 			}
 		}
 	}
+	TRACE_END(TRACE_SEARCH);
+
+	if (perf_enabled) {
+		perf_stats.search_us = perf_now() - perf_start;
+		// A backward search which found nothing wrapped around zero.
+		if (dir == SEARCH_FORWARD) {
+			perf_stats.search_bytes = current_offset - search_start;
+		} else {
+			perf_stats.search_bytes = found ? search_start - current_offset : search_start;
+		}
+	}
 
-	charbuf_free(parsedstr);
+	mem_arena_reset(&e->scratch_arena);
 	if (!found) editor_statusmessage(e, STATUS_WARNING,
 					 "String not found: '%s'", str);
 }
@@ -1016,6 +3575,10 @@ int editor_read_hex_input(struct editor* e, char* out) {
 	static char hexstr[2 + 1];  // the actual string updated with the keypress.
 
 	int next = read_key();
+	if (next == -1) {
+		// Interrupted by a signal, no key was read.
+		return -1;
+	}
 
 	if (next == KEY_ESC) {
 		// escape the current mode to NORMAL, reset the hexstr and index so
@@ -1098,6 +3661,79 @@ int editor_read_string(struct editor* e, char* dst, int len) {
 }
 
 
+/*
+ * Handles a key while browsing a list: moving the selection, typing a
+ * filter, or jumping to the offset of the selected item.
+ */
+static void editor_process_list_key(struct editor* e) {
+	struct listview* lv = e->list;
+	unsigned int rows = e->screen_rows > 2 ? e->screen_rows - 2 : 1;
+	int c = read_key();
+	if (c == -1) {
+		return;
+	}
+
+	if (lv->filtering) {
+		char filter[sizeof(lv->filter)];
+		size_t len = strlen(lv->filter);
+		snprintf(filter, sizeof(filter), "%s", lv->filter);
+		if (c == KEY_ENTER) {
+			lv->filtering = false;
+			return;
+		} else if (c == KEY_ESC) {
+			lv->filtering = false;
+			filter[0] = '\0';
+		} else if (c == KEY_BACKSPACE && len > 0) {
+			filter[len - 1] = '\0';
+		} else if (c < 0x80 && isprint(c) && len < sizeof(filter) - 1) {
+			filter[len] = c;
+			filter[len + 1] = '\0';
+		} else {
+			return;
+		}
+		listview_set_filter(lv, filter);
+		return;
+	}
+
+	size_t item;
+	switch (c) {
+	case KEY_DOWN:
+	case 'j': listview_move(lv, 1, rows); break;
+	case KEY_UP:
+	case 'k': listview_move(lv, -1, rows); break;
+	case KEY_CTRL_D:
+	case KEY_CTRL_F:
+	case KEY_PAGEDOWN: listview_move(lv, rows, rows); break;
+	case KEY_CTRL_U:
+	case KEY_CTRL_B:
+	case KEY_PAGEUP: listview_move(lv, -(long) rows, rows); break;
+	case 'G': listview_move(lv, lv->shown_count, rows); break;
+	case 'g':
+		while ((c = read_key()) == -1);
+		if (c == 'g') {
+			listview_move(lv, -(long) lv->shown_count, rows);
+		}
+		break;
+	case '/': lv->filtering = true; break;
+	case KEY_ENTER:
+		if (lv->offset == NULL || !listview_selected(lv, &item)) {
+			return;
+		}
+		uint64_t offset = lv->offset(lv->data, item);
+		editor_setmode(e, MODE_NORMAL);
+		clear_screen();
+		editor_jump(e, offset);
+		editor_statusmessage(e, STATUS_INFO, "Positioned to offset 0x%09" PRIx64 " (%" PRIu64 ")", offset, offset);
+		break;
+	case 'q':
+	case KEY_ESC:
+		editor_setmode(e, MODE_NORMAL);
+		clear_screen();
+		break;
+	case KEY_CTRL_Q: exit(0); return;
+	}
+}
+
 void editor_process_keypress(struct editor* e) {
 	if (e->mode & (MODE_INSERT | MODE_APPEND)) {
 		char out = 0;
@@ -1110,7 +3746,10 @@ void editor_process_keypress(struct editor* e) {
 
 	// Append or insert 'literal' ASCII values.
 	if (e->mode & (MODE_INSERT_ASCII | MODE_APPEND_ASCII)) {
-		char c = read_key();
+		int c = read_key();
+		if (c == -1) {
+			return;
+		}
 		if (c == KEY_ESC) {
 			editor_setmode(e, MODE_NORMAL); return;
 		}
@@ -1120,7 +3759,10 @@ void editor_process_keypress(struct editor* e) {
 	}
 
 	if (e->mode & MODE_REPLACE_ASCII) {
-		char c = read_key();
+		int c = read_key();
+		if (c == -1) {
+			return;
+		}
 		if (c == KEY_ESC) {
 			editor_setmode(e, MODE_NORMAL);
 			return;
@@ -1156,6 +3798,11 @@ void editor_process_keypress(struct editor* e) {
 		return;
 	}
 
+	if (e->mode & MODE_LIST) {
+		editor_process_list_key(e);
+		return;
+	}
+
 	if (e->mode & MODE_SEARCH) {
 		char search[INPUT_BUF_SIZE];
 		int c = editor_read_string(e, search, INPUT_BUF_SIZE);
@@ -1181,6 +3828,20 @@ void editor_process_keypress(struct editor* e) {
 
 	// Handle commands when in normal mode.
 	if (e->mode & MODE_NORMAL) {
+		// Keys which modify the buffer.
+		switch (c) {
+		case ']': case '[': case 'r': case 'R': case 'u': case KEY_CTRL_R:
+			if (!editor_check_writable(e, false)) {
+				return;
+			}
+			break;
+		case KEY_DEL: case 'x': case 'a': case 'A': case 'i': case 'I':
+			if (!editor_check_writable(e, true)) {
+				return;
+			}
+			break;
+		}
+
 		switch (c) {
 		// cursor movement:
 		case KEY_UP:
@@ -1216,21 +3877,42 @@ void editor_process_keypress(struct editor* e) {
 		case 'w': editor_move_cursor(e, KEY_RIGHT, e->grouping); break;
 		case 'G':
 			// Scroll to the end, place the cursor at the end.
+			if (e->windowed && e->file_size > 0) {
+				editor_window_seek(e, e->file_size - 1);
+			}
 			editor_scroll(e, e->content_length);
 			editor_cursor_at_offset(e, e->content_length-1, &e->cursor_x, &e->cursor_y);
 			break;
+		case ')':
+			if (e->content_length > 0) {
+				editor_skip_run(e, e->contents[editor_offset_at_cursor(e)], 1);
+			}
+			break;
+		case '(':
+			if (e->content_length > 0) {
+				editor_skip_run(e, e->contents[editor_offset_at_cursor(e)], -1);
+			}
+			break;
+		case '}': editor_jump_extent(e, 1); break;
+		case '{': editor_jump_extent(e, -1); break;
+		case 'p': editor_follow_pointer(e); break;
+		case 'm':
+		case '\'': editor_mark_key(e, c); break;
+		case KEY_CTRL_O: editor_jump_back(e, true); break;
+		case KEY_CTRL_I: editor_jump_back(e, false); break;
 		case 'g':
-			// Read extra keypress
-			c = read_key();
+			// Read extra keypress. Signals are not a reason to stop waiting.
+			while ((c = read_key()) == -1);
 			if (c == 'g') {
 				// scroll to the start, place cursor at start.
+				editor_window_seek(e, 0);
 				e->line = 0;
 				editor_cursor_at_offset(e, 0, &e->cursor_x, &e->cursor_y);
 			}
 			break;
 
 		case KEY_HOME: e->cursor_x = 1; return;
-		case KEY_END:  editor_move_cursor(e, KEY_RIGHT, e->octets_per_line - e->cursor_x); return;
+		case KEY_END:  editor_move_cursor(e, KEY_RIGHT, editor_row_length(e, editor_offset_at_cursor(e)) - e->cursor_x); return;
 
 		case KEY_CTRL_U:
 		case KEY_PAGEUP:   editor_scroll(e, -(e->screen_rows) + 2); return;
@@ -1255,6 +3937,7 @@ void editor_undo(struct editor* e) {
 		return;
 	}
 
+	TRACE_BEGIN(TRACE_UNDO);
 	// Save the old contents in case we're undoing a replace.
 	char old_contents = e->contents[last_action->offset];
 	switch (last_action->act) {
@@ -1267,6 +3950,7 @@ void editor_undo(struct editor* e) {
 	case ACTION_REPLACE:
 		e->contents[last_action->offset] = last_action->c;
 		last_action->c = old_contents;
+		editor_byte_changed(e, last_action->offset);
 		break;
 	case ACTION_INSERT:
 		editor_delete_char_at_offset(e, last_action->offset);
@@ -1278,6 +3962,8 @@ void editor_undo(struct editor* e) {
 
 	// Move to the previous action.
 	action_list_move(e->undo_list, -1);
+	TRACE_END(TRACE_UNDO);
+	editor_update_dirty(e);
 
 	editor_statusmessage(e, STATUS_INFO,
 		"Reverted '%s' at offset %d to byte '%02x' (%d left)",
@@ -1308,6 +3994,7 @@ void editor_redo(struct editor* e) {
 		return;
 	}
 
+	TRACE_BEGIN(TRACE_REDO);
 	// Save the old contents in case we're redoing a replace.
 	char old_contents = e->contents[next_action->offset];
 	switch (next_action->act) {
@@ -1320,6 +4007,7 @@ void editor_redo(struct editor* e) {
 	case ACTION_REPLACE:
 		e->contents[next_action->offset] = next_action->c;
 		next_action->c = old_contents;
+		editor_byte_changed(e, next_action->offset);
 		break;
 	case ACTION_INSERT:
 		editor_insert_byte_at_offset(e, next_action->offset, next_action->c, false);
@@ -1331,6 +4019,8 @@ void editor_redo(struct editor* e) {
 
 	// Move to the next action.
 	action_list_move(e->undo_list, 1);
+	TRACE_END(TRACE_REDO);
+	editor_update_dirty(e);
 
 	editor_statusmessage(e, STATUS_INFO,
 		"Redone '%s' at offset %d to byte '%02x' (%d left)",
@@ -1345,7 +4035,7 @@ void editor_redo(struct editor* e) {
  * Initializes editor struct with some default values.
  */
 struct editor* editor_init() {
-	struct editor* e = malloc(sizeof(struct editor));
+	struct editor* e = mem_alloc(MEM_OTHER, sizeof(struct editor));
 	if (e == NULL) {
 		perror("Cannot allocate memory for editor");
 		abort();
@@ -1353,6 +4043,8 @@ struct editor* editor_init() {
 
 	e->octets_per_line = 16;
 	e->grouping = 2;
+	e->record_size = 0;
+	e->record_field = -1;
 
 	e->line = 0;
 	e->cursor_x = 1;
@@ -1360,6 +4052,36 @@ struct editor* editor_init() {
 	e->filename = NULL;
 	e->contents = NULL;
 	e->content_length = 0;
+	e->fingerprints = NULL;
+	e->fingerprint_count = 0;
+	e->saved_position = 0;
+	e->windowed = false;
+	e->window_offset = 0;
+	e->file_size = 0;
+	e->window_size = 4 * 1024 * 1024;
+	e->follow = false;
+	e->collapse = 0;
+	e->proc = NULL;
+	e->bdev = NULL;
+	e->sparse = NULL;
+	e->elf = NULL;
+	e->vmap = NULL;
+	e->vmap_user = NULL;
+	e->vaddr = false;
+	jump_list_init(&e->jumps);
+	e->marks = NULL;
+	e->pointer_size = 8;
+	e->pointer_big_endian = false;
+	e->pointer_base = 0;
+	e->inspector = NULL;
+	e->blockstat = NULL;
+	e->blockstat_pending = UINT_MAX;
+	e->blockstat_pending_us = 0;
+	e->heatbar = false;
+	e->minimap = NULL;
+	e->strings = NULL;
+	e->list = NULL;
+	e->tpl = NULL;
 	e->dirty = false;
 
 	memset(e->status_message, '\0', sizeof(e->status_message));
@@ -1371,16 +4093,67 @@ struct editor* editor_init() {
 
 	memset(e->searchstr, '\0', sizeof(e->searchstr));
 
+	// Without a terminal (like in the benchmarks), assume a classic one.
+	e->screen_rows = 24;
+	e->screen_cols = 80;
 	get_window_size(&(e->screen_rows), &(e->screen_cols));
 
 	e->undo_list = action_list_init();
+	mem_arena_init(&e->frame_arena, MEM_FRAME, 64 * 1024);
+	mem_arena_init(&e->scratch_arena, MEM_FRAME, 4 * 1024);
+	e->row_scratch = NULL;
+	e->row_scratch_octets = 0;
 
 	return e;
 }
 
 void editor_free(struct editor* e) {
+	// Stop the workers before the contents are freed.
+	if (e->blockstat != NULL) {
+		blockstat_free(e->blockstat);
+	}
 	action_list_free(e->undo_list);
-	free(e->filename);
-	free(e->contents);
-	free(e);
+	mem_free(e->filename);
+	mem_free(e->contents);
+	mem_free(e->fingerprints);
+	if (e->proc != NULL) {
+		procmem_free(e->proc);
+	}
+	if (e->bdev != NULL) {
+		blockdev_free(e->bdev);
+	}
+	if (e->sparse != NULL) {
+		sparse_map_free(e->sparse);
+	}
+	if (e->elf != NULL) {
+		elf_free(e->elf);
+	}
+	if (e->vmap_user != NULL) {
+		addr_map_free(e->vmap_user);
+	}
+	if (e->vmap != NULL) {
+		addr_map_free(e->vmap);
+	}
+	if (e->marks != NULL) {
+		marks_free(e->marks);
+	}
+	if (e->inspector != NULL) {
+		inspector_free(e->inspector);
+	}
+	if (e->minimap != NULL) {
+		minimap_free(e->minimap);
+	}
+	if (e->list != NULL) {
+		listview_free(e->list);
+	}
+	if (e->tpl != NULL) {
+		template_free(e->tpl);
+	}
+	if (e->strings != NULL) {
+		strings_free(e->strings);
+	}
+	mem_arena_release(&e->frame_arena);
+	mem_arena_release(&e->scratch_arena);
+	mem_free(e->row_scratch);
+	mem_free(e);
 }
@@ -8,8 +8,15 @@
 #define HX_EDITOR_H
 
 #include "charbuf.h"
+#include "jumplist.h"
+#include "mem.h"
 
 #include <stdbool.h>
+#include <stdint.h>
+
+// The widest line width accepted, in octets. The width of the terminal
+// usually limits it further (see editor_max_octets).
+#define EDITOR_MAX_OCTETS 4096
 
 /*
  * Mode the editor can be in.
@@ -24,6 +31,7 @@ enum editor_mode {
 	MODE_REPLACE       = 1 << 6, // replace values at cursor position.
 	MODE_COMMAND       = 1 << 7, // command input mode.
 	MODE_SEARCH        = 1 << 8, // search mode.
+	MODE_LIST          = 1 << 9, // browsing a list, like the strings found.
 };
 
 /*
@@ -45,12 +53,27 @@ enum status_severity {
 
 #define INPUT_BUF_SIZE 80
 
+struct addr_map;
+struct blockdev;
+struct blockstat;
+struct elf_index;
+struct inspector;
+struct listview;
+struct marks;
+struct minimap;
+struct procmem;
+struct sparse_map;
+struct string_index;
+struct template;
+
 /*
  * This struct contains internal information of the state of the editor.
  */
 struct editor {
 	int octets_per_line; // Amount of octets (bytes) per line. Ideally multiple of 2.
 	int grouping;        // Amount of bytes per group. Ideally multiple of 2.
+	unsigned int record_size; // Size of the records every row starts within, or 0.
+	int record_field;         // Offset in the records searches are limited to, or -1.
 
 	int line;        // The 'line' in the editor. Used for scrolling.
 	int cursor_x;    // Cursor x pos on the current screen
@@ -65,6 +88,42 @@ struct editor {
 	char*        contents;       // the file's contents
 	unsigned int content_length; // length of the contents
 
+	unsigned int* fingerprints;      // fingerprints of the blocks of the file on disk
+	unsigned int  fingerprint_count; // amount of fingerprinted blocks
+	int           saved_position;    // undo position when the contents were last equal to disk, or -1 if lost
+
+	bool         windowed;      // whether only a part (window) of the file is in `contents'
+	uint64_t     window_offset; // offset in the file of the first byte of `contents'
+	uint64_t     file_size;     // size of the complete file, when windowed
+	unsigned int window_size;   // maximum amount of bytes loaded when windowed
+	bool         follow;        // following the end of a growing file (tail -f)
+	unsigned int collapse;      // rows of identical bytes to collapse into one line, 0 = off
+	struct procmem* proc;       // memory of a live process when editing one, or NULL
+	struct blockdev* bdev;      // the block device when editing one, or NULL
+	struct sparse_map* sparse;  // data extents of a sparse file, or NULL
+	struct elf_index* elf;      // sections and symbols of an ELF file (as on disk), or NULL
+	struct addr_map* vmap;      // offsets mapped to virtual addresses (:map, ELF segments), or NULL
+	struct addr_map* vmap_user; // the ranges mapped with :map, or NULL
+	bool vaddr;                 // whether addresses are shown and entered as virtual addresses
+	struct jump_list jumps;     // offsets jumped from, for CTRL-O and CTRL-I
+	struct marks* marks;        // marks and bookmarks, saved next to the file, or NULL
+	unsigned int pointer_size;  // size of the pointers followed with `p', 4 or 8
+	bool pointer_big_endian;    // whether those pointers are big endian
+	uint64_t pointer_base;      // subtracted from a pointer to get its offset
+	struct inspector* inspector; // the data inspector panel when shown, or NULL
+	struct blockstat* blockstat; // per-block statistics when the heat bar or minimap is shown, or NULL
+	unsigned int blockstat_pending;    // bytes inserted or deleted from here are not in blockstat yet, or UINT_MAX
+	uint64_t     blockstat_pending_us; // when the last of those edits was made (see perf_now)
+	bool heatbar;                // whether the entropy heat bar is shown
+	struct minimap* minimap;     // the overview of the file when shown, or NULL
+	struct string_index* strings; // strings found by the last :strings, or NULL
+	struct listview* list;       // the list browsed in MODE_LIST, or NULL
+	struct template* tpl;        // the structure template laid over the contents, or NULL
+	struct mem_arena frame_arena;   // the frame being rendered, reset every frame
+	struct mem_arena scratch_arena; // scratch space of a search, reset after it
+	char* row_scratch;               // scratch space to render a row, see editor_row_scratch
+	unsigned int row_scratch_octets; // amount of octets row_scratch is sized for
+
 	enum status_severity status_severity;     // status severity
 	char                 status_message[120]; // status message
 
@@ -132,10 +191,59 @@ int editor_offset_at_cursor(struct editor* e);
 /*
  * Opens a file denoted by `filename', or exit if the file cannot be opened.
  * The editor struct is used to contain the contents and other metadata
- * about the file being opened.
+ * about the file being opened. Block devices are opened as well, in which
+ * case only a window of the device is loaded at a time.
  */
 void editor_openfile(struct editor* e, const char* filename);
 
+/*
+ * Opens the memory of the running process `pid', or exits if that fails.
+ * Only a window of one mapped region is loaded at a time, and addresses are
+ * displayed as virtual addresses. Replacing bytes writes them to the process
+ * memory immediately. Inserting or deleting bytes is not possible.
+ */
+void editor_openprocess(struct editor* e, int pid);
+
+/*
+ * Reloads the file from disk after it has been changed by another process.
+ * The file is read per block, and every block is fingerprinted and compared
+ * with the fingerprints taken when the file was last read or written. Only
+ * the blocks which changed are copied into the buffer. The cursor position
+ * is kept, and the undo history is kept as long as none of the recorded
+ * actions touch a changed block.
+ *
+ * When the buffer has unsaved changes which conflict with the changes on disk,
+ * nothing is reloaded and a warning is displayed instead, unless `force' is
+ * set to true. A forced reload discards all unsaved changes.
+ */
+void editor_reload(struct editor* e, bool force);
+
+/*
+ * Enables or disables follow mode. When enabled, only a window of at most
+ * `window_size' bytes at the end of the file is kept in memory, and data
+ * appended to the file is added to the buffer by editor_follow_update().
+ * Older parts of the file are paged in on demand when navigating to them.
+ * The buffer is read-only in follow mode.
+ *
+ * When disabled, the complete file is read into memory again.
+ */
+void editor_follow(struct editor* e, bool enable);
+
+/*
+ * Reads the data appended to the file since the last update, when following
+ * a file. If the cursor was at the end of the file, it is moved to the new
+ * end of the file. If the file was truncated, the window is reloaded.
+ */
+void editor_follow_update(struct editor* e);
+
+/*
+ * Makes sure the given offset in the file is part of the currently loaded
+ * window, by loading another part of the file if necessary. The offset
+ * relative to `contents' is returned. When the complete file is loaded,
+ * the offset is returned as-is.
+ */
+unsigned int editor_window_seek(struct editor* e, uint64_t offset);
+
 /*
  * Processes a manual command input when the editor mode is set
  * to MODE_COMMAND.
@@ -194,6 +302,13 @@ int editor_read_hex_input(struct editor* e, char* output);
  */
 int editor_read_string(struct editor* e, char* dst, int len);
 
+/*
+ * Returns the widest line width, in octets, which fits the screen with the
+ * current grouping. Widths up to 64 octets are always allowed, as they were
+ * before wider lines were supported, even when the screen is narrower.
+ */
+int editor_max_octets(struct editor* e);
+
 /*
  * Renders ASCII values of the editor's contents to the buffer `b'. The
  * start_offset is used to reference the editor's contents start position
@@ -210,6 +325,34 @@ void editor_render_ascii(struct editor* e, int rownum, unsigned int start_offset
  */
 void editor_render_contents(struct editor* e, struct charbuf* b);
 
+/*
+ * Renders the data inspector panel to the right of the contents, decoding
+ * the bytes at the cursor position.
+ */
+void editor_render_inspector(struct editor* e, struct charbuf* b);
+
+/*
+ * Renders the fields of the structure template at the cursor, to the right of
+ * the contents (and of the data inspector, when shown).
+ */
+void editor_render_template(struct editor* e, struct charbuf* b);
+
+/*
+ * Renders the minimap, an overview of the whole buffer, next to the contents.
+ */
+void editor_render_minimap(struct editor* e, struct charbuf* b);
+
+/*
+ * Renders the list browsed in MODE_LIST over the whole screen.
+ */
+void editor_render_list(struct editor* e, struct charbuf* b);
+
+/*
+ * Renders the performance overlay in the top right corner of the screen,
+ * with the measurements of the last frame, key and search (see perf.h).
+ */
+void editor_render_perf(struct editor* e, struct charbuf* b);
+
 /*
  * Renders on-line help on the screen. This is implemented without the
  * usage of a MODE since the commands etc. are not applicable in this state.
@@ -0,0 +1,512 @@
+/*
+ * This file is part of hx - a hex editor for the terminal.
+ *
+ * Copyright (c) 2016 Kevin Pors. See LICENSE for details.
+ */
+
+// pread() is part of POSIX.1-2008, more than the Makefile asks for.
+#define _XOPEN_SOURCE 700
+#define _POSIX_C_SOURCE 200809L
+
+#include "elfindex.h"
+#include "mem.h"
+#include "perf.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// The values of the headers used here (see elf(5)). The system's <elf.h>
+// is not used, since it's not everywhere, and the file may be of another
+// byte order anyway.
+#define ELF_CLASS32       1
+#define ELF_CLASS64       2
+#define ELF_DATA_LSB      1
+#define ELF_DATA_MSB      2
+#define ELF_ET_REL        1
+#define ELF_SHT_NULL      0
+#define ELF_SHT_SYMTAB    2
+#define ELF_SHT_NOBITS    8
+#define ELF_SHT_DYNSYM    11
+#define ELF_SHN_LORESERVE 0xff00
+#define ELF_SHN_XINDEX    0xffff
+#define ELF_STT_OBJECT    1
+#define ELF_STT_FUNC      2
+
+// Limits to what is read from a damaged file.
+#define ELF_MAX_SECTIONS (64 * 1024)
+#define ELF_MAX_SEGMENTS 4096
+#define ELF_MAX_SYMBOLS  (16 * 1024 * 1024)
+
+struct elf_reader {
+	int fd;
+	uint64_t size; // size of the file.
+	bool is64;
+	bool big_endian;
+};
+
+/*
+ * The fields of a section header used here.
+ */
+struct elf_section {
+	uint32_t name;
+	uint32_t type;
+	uint64_t addr;
+	uint64_t offset;
+	uint64_t size;
+	uint32_t link;
+	uint64_t entsize;
+};
+
+/*
+ * Reads the `len' bytes at `offset' of the file into a new buffer, with a
+ * NUL after them. Returns NULL if they're not all in the file.
+ */
+static unsigned char* elf_read(struct elf_reader* r, uint64_t offset, uint64_t len) {
+	if (offset > r->size || len > r->size - offset) {
+		return NULL;
+	}
+	unsigned char* buf = mem_alloc(MEM_INDEX, len + 1);
+	if (buf == NULL) {
+		perror("Could not allocate memory for the ELF index");
+		abort();
+	}
+	uint64_t done = 0;
+	while (done < len) {
+		ssize_t n = pread(r->fd, buf + done, len - done, offset + done);
+		PERF_COUNT(PERF_SYSCALLS, 1);
+		if (n <= 0) {
+			mem_free(buf);
+			return NULL;
+		}
+		done += n;
+	}
+	buf[len] = '\0';
+	return buf;
+}
+
+/*
+ * Decodes the number of `width' bytes at `p' in the byte order of the file.
+ */
+static uint64_t elf_get(const struct elf_reader* r, const unsigned char* p, unsigned int width) {
+	uint64_t v = 0;
+	for (unsigned int i = 0; i < width; i++) {
+		v = (v << 8) | p[r->big_endian ? i : width - 1 - i];
+	}
+	return v;
+}
+
+/*
+ * Decodes an address, offset or size: 4 bytes in 32 bit files, 8 in 64 bit.
+ */
+static uint64_t elf_word(const struct elf_reader* r, const unsigned char* p) {
+	return elf_get(r, p, r->is64 ? 8 : 4);
+}
+
+static void elf_decode_section(const struct elf_reader* r, const unsigned char* p, struct elf_section* s) {
+	s->name = elf_get(r, p, 4);
+	s->type = elf_get(r, p + 4, 4);
+	if (r->is64) {
+		s->addr = elf_get(r, p + 16, 8);
+		s->offset = elf_get(r, p + 24, 8);
+		s->size = elf_get(r, p + 32, 8);
+		s->link = elf_get(r, p + 40, 4);
+		s->entsize = elf_get(r, p + 56, 8);
+	} else {
+		s->addr = elf_get(r, p + 12, 4);
+		s->offset = elf_get(r, p + 16, 4);
+		s->size = elf_get(r, p + 20, 4);
+		s->link = elf_get(r, p + 24, 4);
+		s->entsize = elf_get(r, p + 36, 4);
+	}
+}
+
+/*
+ * Returns whether the section has data in the file.
+ */
+static bool elf_in_file(const struct elf_reader* r, const struct elf_section* s) {
+	return s->type != ELF_SHT_NULL && s->type != ELF_SHT_NOBITS &&
+		s->offset <= r->size && s->size <= r->size - s->offset;
+}
+
+static void elf_table_alloc(struct elf_table* t, uint64_t max) {
+	t->regions = mem_alloc(MEM_INDEX, (max > 0 ? max : 1) * sizeof(struct elf_region));
+	if (t->regions == NULL) {
+		perror("Could not allocate memory for the ELF index");
+		abort();
+	}
+	t->count = 0;
+}
+
+static void elf_table_add(struct elf_table* t, const char* name, uint32_t type,
+                          uint64_t offset, uint64_t size, uint64_t vaddr) {
+	struct elf_region* region = &t->regions[t->count++];
+	region->name = name;
+	region->type = type;
+	region->offset = offset;
+	region->size = size;
+	region->vaddr = vaddr;
+}
+
+static int elf_compare_offset(const void* a, const void* b) {
+	const struct elf_region* x = a;
+	const struct elf_region* y = b;
+	if (x->offset != y->offset) {
+		return x->offset < y->offset ? -1 : 1;
+	}
+	// Outer regions first, so the inner ones are found first.
+	if (x->size != y->size) {
+		return x->size > y->size ? -1 : 1;
+	}
+	return 0;
+}
+
+static int elf_compare_name(const void* a, const void* b) {
+	const struct elf_region* const* x = a;
+	const struct elf_region* const* y = b;
+	return strcmp((*x)->name, (*y)->name);
+}
+
+/*
+ * Sorts the regions of the table by offset, works out how far they reach,
+ * and sorts them by name as well if `names' is set.
+ */
+static void elf_table_finish(struct elf_table* t, bool names) {
+	qsort(t->regions, t->count, sizeof(struct elf_region), elf_compare_offset);
+	t->reach = mem_alloc(MEM_INDEX, (t->count > 0 ? t->count : 1) * sizeof(uint64_t));
+	if (t->reach == NULL) {
+		perror("Could not allocate memory for the ELF index");
+		abort();
+	}
+	uint64_t reach = 0;
+	for (unsigned int i = 0; i < t->count; i++) {
+		uint64_t end = t->regions[i].offset + t->regions[i].size;
+		reach = end > reach ? end : reach;
+		t->reach[i] = reach;
+	}
+
+	if (!names) {
+		return;
+	}
+	t->names = mem_alloc(MEM_INDEX, (t->count > 0 ? t->count : 1) * sizeof(struct elf_region*));
+	if (t->names == NULL) {
+		perror("Could not allocate memory for the ELF index");
+		abort();
+	}
+	for (unsigned int i = 0; i < t->count; i++) {
+		t->names[i] = &t->regions[i];
+	}
+	qsort(t->names, t->count, sizeof(struct elf_region*), elf_compare_name);
+}
+
+static const char* elf_segment_name(uint32_t type) {
+	switch (type) {
+	case 1: return "LOAD";
+	case 2: return "DYNAMIC";
+	case 3: return "INTERP";
+	case 4: return "NOTE";
+	case 6: return "PHDR";
+	case 7: return "TLS";
+	case 0x6474e550: return "GNU_EH_FRAME";
+	case 0x6474e552: return "GNU_RELRO";
+	case 0x6474e553: return "GNU_PROPERTY";
+	default: return "SEGMENT";
+	}
+}
+
+/*
+ * Indexes the segments with data in the file.
+ */
+static void elf_index_segments(struct elf_reader* r, struct elf_index* elf,
+                               uint64_t phoff, unsigned int phentsize, unsigned int phnum) {
+	elf_table_alloc(&elf->segments, phnum);
+	unsigned char* table = NULL;
+	if (phoff == 0 || phnum > ELF_MAX_SEGMENTS || phentsize < (r->is64 ? 56u : 32u) ||
+			(table = elf_read(r, phoff, (uint64_t) phnum * phentsize)) == NULL) {
+		elf_table_finish(&elf->segments, false);
+		return;
+	}
+
+	for (unsigned int i = 0; i < phnum; i++) {
+		const unsigned char* p = table + (size_t) i * phentsize;
+		uint32_t type = elf_get(r, p, 4);
+		uint64_t offset = elf_word(r, p + (r->is64 ? 8 : 4));
+		uint64_t vaddr = elf_word(r, p + (r->is64 ? 16 : 8));
+		uint64_t filesz = elf_word(r, p + (r->is64 ? 32 : 16));
+		if (filesz > 0 && offset <= r->size && filesz <= r->size - offset) {
+			elf_table_add(&elf->segments, elf_segment_name(type), type, offset, filesz, vaddr);
+		}
+	}
+	mem_free(table);
+	elf_table_finish(&elf->segments, false);
+}
+
+/*
+ * Indexes the named functions and objects of the symbol table `symtab',
+ * which have data in the file.
+ */
+static void elf_index_symbols(struct elf_reader* r, struct elf_index* elf,
+                              const struct elf_section* sections, unsigned int count,
+                              const struct elf_section* symtab) {
+	unsigned int entsize = r->is64 ? 24 : 16;
+	uint64_t n = symtab->entsize >= entsize ? symtab->size / symtab->entsize : 0;
+	if (symtab->entsize >= entsize) {
+		entsize = symtab->entsize;
+	}
+	const struct elf_section* strtab = symtab->link < count ? &sections[symtab->link] : NULL;
+	unsigned char* table = NULL;
+	if (n == 0 || n > ELF_MAX_SYMBOLS || strtab == NULL || !elf_in_file(r, strtab) ||
+			(table = elf_read(r, symtab->offset, n * entsize)) == NULL ||
+			(elf->strings[1] = (char*) elf_read(r, strtab->offset, strtab->size)) == NULL) {
+		mem_free(table);
+		elf_table_alloc(&elf->symbols, 0);
+		elf_table_finish(&elf->symbols, true);
+		return;
+	}
+
+	elf_table_alloc(&elf->symbols, n);
+	for (uint64_t i = 0; i < n; i++) {
+		const unsigned char* p = table + i * entsize;
+		uint32_t name = elf_get(r, p, 4);
+		unsigned int info;
+		unsigned int shndx;
+		uint64_t value;
+		uint64_t size;
+		if (r->is64) {
+			info = p[4];
+			shndx = elf_get(r, p + 6, 2);
+			value = elf_get(r, p + 8, 8);
+			size = elf_get(r, p + 16, 8);
+		} else {
+			value = elf_get(r, p + 4, 4);
+			size = elf_get(r, p + 8, 4);
+			info = p[12];
+			shndx = elf_get(r, p + 14, 2);
+		}
+
+		unsigned int type = info & 0xf;
+		if ((type != ELF_STT_FUNC && type != ELF_STT_OBJECT) || name == 0 || name >= strtab->size ||
+				shndx == 0 || shndx >= ELF_SHN_LORESERVE || shndx >= count) {
+			continue;
+		}
+		const struct elf_section* section = &sections[shndx];
+		if (!elf_in_file(r, section)) {
+			continue;
+		}
+		// The value is an offset in the section in relocatable files,
+		// and an address everywhere else.
+		uint64_t at = value;
+		if (elf->type != ELF_ET_REL) {
+			if (value < section->addr) {
+				continue;
+			}
+			at = value - section->addr;
+		}
+		if (at > section->size) {
+			continue;
+		}
+		if (size > section->size - at) {
+			size = section->size - at;
+		}
+		elf_table_add(&elf->symbols, elf->strings[1] + name, type, section->offset + at, size, value);
+	}
+	mem_free(table);
+	elf_table_finish(&elf->symbols, true);
+}
+
+/*
+ * Indexes the sections with data in the file, and the symbols.
+ */
+static void elf_index_sections(struct elf_reader* r, struct elf_index* elf,
+                               uint64_t shoff, unsigned int shentsize, uint64_t shnum, unsigned int shstrndx) {
+	unsigned char* table = NULL;
+	struct elf_section* sections = NULL;
+	unsigned int count = 0;
+
+	if (shoff != 0 && shentsize >= (r->is64 ? 64u : 40u)) {
+		// With more sections than fit the header, the amount and the
+		// index of the names are in the first section header.
+		unsigned char* first = elf_read(r, shoff, shentsize);
+		if (first != NULL) {
+			struct elf_section s;
+			elf_decode_section(r, first, &s);
+			mem_free(first);
+			if (shnum == 0) {
+				shnum = s.size;
+			}
+			if (shstrndx == ELF_SHN_XINDEX) {
+				shstrndx = s.link;
+			}
+		}
+		if (shnum > 0 && shnum <= ELF_MAX_SECTIONS) {
+			table = elf_read(r, shoff, shnum * shentsize);
+		}
+	}
+	if (table != NULL) {
+		count = shnum;
+		sections = mem_alloc(MEM_INDEX, count * sizeof(struct elf_section));
+		if (sections == NULL) {
+			perror("Could not allocate memory for the ELF index");
+			abort();
+		}
+		for (unsigned int i = 0; i < count; i++) {
+			elf_decode_section(r, table + (size_t) i * shentsize, &sections[i]);
+		}
+		mem_free(table);
+	}
+
+	uint64_t names_size = 0;
+	if (shstrndx < count && elf_in_file(r, &sections[shstrndx])) {
+		elf->strings[0] = (char*) elf_read(r, sections[shstrndx].offset, sections[shstrndx].size);
+		names_size = elf->strings[0] != NULL ? sections[shstrndx].size : 0;
+	}
+
+	elf_table_alloc(&elf->sections, count);
+	const struct elf_section* symtab = NULL;
+	const struct elf_section* dynsym = NULL;
+	for (unsigned int i = 0; i < count; i++) {
+		const struct elf_section* s = &sections[i];
+		if (s->type == ELF_SHT_SYMTAB) {
+			symtab = s;
+		} else if (s->type == ELF_SHT_DYNSYM) {
+			dynsym = s;
+		}
+		if (!elf_in_file(r, s) || s->size == 0) {
+			continue;
+		}
+		const char* name = s->name < names_size ? elf->strings[0] + s->name : "";
+		elf_table_add(&elf->sections, name, s->type, s->offset, s->size, s->addr);
+	}
+	elf_table_finish(&elf->sections, true);
+
+	// The dynamic symbols are a subset of the others, so they're only
+	// needed when the file is stripped.
+	if (symtab == NULL) {
+		symtab = dynsym;
+	}
+	if (symtab != NULL && elf_in_file(r, symtab)) {
+		elf_index_symbols(r, elf, sections, count, symtab);
+	} else {
+		elf_table_alloc(&elf->symbols, 0);
+		elf_table_finish(&elf->symbols, true);
+	}
+	mem_free(sections);
+}
+
+struct elf_index* elf_open(int fd) {
+	struct stat statbuf;
+	PERF_COUNT(PERF_SYSCALLS, 1);
+	if (fstat(fd, &statbuf) == -1) {
+		return NULL;
+	}
+
+	unsigned char header[64];
+	ssize_t n = pread(fd, header, sizeof(header), 0);
+	PERF_COUNT(PERF_SYSCALLS, 1);
+	if (n < 52 || memcmp(header, "\x7f" "ELF", 4) != 0 ||
+			(header[4] != ELF_CLASS32 && header[4] != ELF_CLASS64) ||
+			(header[5] != ELF_DATA_LSB && header[5] != ELF_DATA_MSB) ||
+			(header[4] == ELF_CLASS64 && n < 64)) {
+		return NULL;
+	}
+
+	struct elf_reader r;
+	r.fd = fd;
+	r.size = statbuf.st_size;
+	r.is64 = header[4] == ELF_CLASS64;
+	r.big_endian = header[5] == ELF_DATA_MSB;
+
+	struct elf_index* elf = mem_calloc(MEM_INDEX, 1, sizeof(struct elf_index));
+	if (elf == NULL) {
+		perror("Could not allocate memory for the ELF index");
+		abort();
+	}
+	elf->is64 = r.is64;
+	elf->big_endian = r.big_endian;
+	elf->type = elf_get(&r, header + 16, 2);
+	elf->machine = elf_get(&r, header + 18, 2);
+	elf->entry = elf_word(&r, header + 24);
+
+	// The rest of the header starts after the entry point, which is 4 or
+	// 8 bytes.
+	const unsigned char* p = header + (r.is64 ? 32 : 28);
+	unsigned int w = r.is64 ? 8 : 4;
+	uint64_t phoff = elf_word(&r, p);
+	uint64_t shoff = elf_word(&r, p + w);
+	p += 2 * w + 4 + 2; // e_flags and e_ehsize
+	unsigned int phentsize = elf_get(&r, p, 2);
+	unsigned int phnum = elf_get(&r, p + 2, 2);
+	unsigned int shentsize = elf_get(&r, p + 4, 2);
+	unsigned int shnum = elf_get(&r, p + 6, 2);
+	unsigned int shstrndx = elf_get(&r, p + 8, 2);
+
+	elf_index_segments(&r, elf, phoff, phentsize, phnum);
+	elf_index_sections(&r, elf, shoff, shentsize, shnum, shstrndx);
+	return elf;
+}
+
+static void elf_table_free(struct elf_table* t) {
+	mem_free(t->regions);
+	mem_free(t->reach);
+	mem_free(t->names);
+}
+
+void elf_free(struct elf_index* elf) {
+	elf_table_free(&elf->sections);
+	elf_table_free(&elf->segments);
+	elf_table_free(&elf->symbols);
+	mem_free(elf->strings[0]);
+	mem_free(elf->strings[1]);
+	mem_free(elf);
+}
+
+const struct elf_region* elf_lookup(const struct elf_table* table, uint64_t offset) {
+	// The regions before `lo' start at or before the offset.
+	unsigned int lo = 0;
+	unsigned int hi = table->count;
+	while (lo < hi) {
+		unsigned int mid = lo + (hi - lo) / 2;
+		if (table->regions[mid].offset <= offset) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	// The last of those containing the offset is the innermost one. Once
+	// none of the regions up to one reach the offset, no earlier one does.
+	while (lo > 0 && table->reach[lo - 1] > offset) {
+		lo--;
+		if (offset - table->regions[lo].offset < table->regions[lo].size) {
+			return &table->regions[lo];
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Finds the region called `name' in the table.
+ */
+static const struct elf_region* elf_find_in(const struct elf_table* table, const char* name) {
+	unsigned int lo = 0;
+	unsigned int hi = table->count;
+	while (lo < hi) {
+		unsigned int mid = lo + (hi - lo) / 2;
+		int cmp = strcmp(table->names[mid]->name, name);
+		if (cmp == 0) {
+			return table->names[mid];
+		}
+		if (cmp < 0) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return NULL;
+}
+
+const struct elf_region* elf_find(const struct elf_index* elf, const char* name) {
+	const struct elf_region* region = elf_find_in(&elf->sections, name);
+	return region != NULL ? region : elf_find_in(&elf->symbols, name);
+}
@@ -0,0 +1,78 @@
+/*
+ * This file is part of hx - a hex editor for the terminal.
+ *
+ * Copyright (c) 2016 Kevin Pors. See LICENSE for details.
+ */
+
+#ifndef HX_ELFINDEX_H
+#define HX_ELFINDEX_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * An index of the sections, segments and symbols of an ELF file, 32 or 64
+ * bit and of either byte order. Only the headers, the section and program
+ * header tables and the symbol table (or the dynamic one, if the file is
+ * stripped) are read when the file is opened, not the whole file.
+ *
+ * The regions of each kind are sorted by file offset, with the furthest end
+ * reached so far next to them, so the regions containing an offset are found
+ * with a binary search even though segments (and some symbols) nest. The
+ * sections and symbols are sorted by name as well.
+ */
+
+/*
+ * A section, segment or symbol, and the part of the file it occupies.
+ */
+struct elf_region {
+	const char* name;  // the name, or the type of a segment ("LOAD").
+	uint32_t type;     // sh_type, p_type or the type of the symbol.
+	uint64_t offset;   // offset in the file.
+	uint64_t size;     // size in the file.
+	uint64_t vaddr;    // virtual address, for sections, segments and symbols of executables.
+};
+
+struct elf_table {
+	struct elf_region* regions; // sorted by offset, inner regions after outer ones.
+	uint64_t* reach;            // reach[i]: the furthest end of regions 0 to i.
+	struct elf_region** names;  // sorted by name, or NULL for segments.
+	unsigned int count;
+};
+
+struct elf_index {
+	bool is64;
+	bool big_endian;
+	uint16_t type;     // e_type: ET_REL (1), ET_EXEC (2), ET_DYN (3) and so on.
+	uint16_t machine;  // e_machine.
+	uint64_t entry;    // e_entry.
+
+	struct elf_table sections; // sections with data in the file.
+	struct elf_table segments; // segments with data in the file.
+	struct elf_table symbols;  // named functions and objects with data in the file.
+
+	char* strings[2]; // the section names, and the names of the symbols.
+};
+
+/*
+ * Reads the index of the ELF file opened as `fd'. Returns NULL when it's not
+ * an ELF file, or a damaged one.
+ */
+struct elf_index* elf_open(int fd);
+
+/*
+ * Frees the index.
+ */
+void elf_free(struct elf_index* elf);
+
+/*
+ * Returns the innermost region of `table' which contains `offset', or NULL.
+ */
+const struct elf_region* elf_lookup(const struct elf_table* table, uint64_t offset);
+
+/*
+ * Returns the section, or else the symbol called `name', or NULL.
+ */
+const struct elf_region* elf_find(const struct elf_index* elf, const char* name);
+
+#endif // HX_ELFINDEX_H
@@ -0,0 +1,74 @@
+/*
+ * This file is part of hx - a hex editor for the terminal.
+ *
+ * Copyright (c) 2016 Kevin Pors. See LICENSE for details.
+ */
+
+#include "histogram.h"
+
+#include <inttypes.h>
+
+// Width of the bar of the fullest bucket.
+static const int HISTOGRAM_BAR_WIDTH = 40;
+
+static unsigned int histogram_bucket(uint64_t value) {
+	unsigned int bucket = 0;
+	while (value != 0) {
+		value >>= 1;
+		bucket++;
+	}
+	return bucket;
+}
+
+/*
+ * Returns the last value of the given bucket.
+ */
+static uint64_t histogram_bucket_end(unsigned int bucket) {
+	return bucket == 0 ? 0 : bucket == 64 ? UINT64_MAX : (UINT64_C(1) << bucket) - 1;
+}
+
+void histogram_add(struct histogram* h, uint64_t value) {
+	h->buckets[histogram_bucket(value)]++;
+	h->count++;
+	h->sum += value;
+	if (value > h->max) {
+		h->max = value;
+	}
+}
+
+uint64_t histogram_percentile(const struct histogram* h, unsigned int p) {
+	uint64_t rank = (h->count * p + 99) / 100;
+	uint64_t seen = 0;
+	for (unsigned int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+		seen += h->buckets[i];
+		if (seen >= rank && seen > 0) {
+			uint64_t end = histogram_bucket_end(i);
+			return end < h->max ? end : h->max;
+		}
+	}
+	return h->max;
+}
+
+void histogram_print(const struct histogram* h, FILE* fp, const char* title) {
+	fprintf(fp, "%s: count %" PRIu64 ", mean %" PRIu64 ", p50 <= %" PRIu64
+	        ", p90 <= %" PRIu64 ", p99 <= %" PRIu64 ", max %" PRIu64 "\n",
+		title, h->count, h->count > 0 ? h->sum / h->count : 0,
+		histogram_percentile(h, 50), histogram_percentile(h, 90),
+		histogram_percentile(h, 99), h->max);
+
+	uint64_t fullest = 0;
+	for (unsigned int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+		if (h->buckets[i] > fullest) {
+			fullest = h->buckets[i];
+		}
+	}
+	for (unsigned int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+		if (h->buckets[i] == 0) {
+			continue;
+		}
+		int width = h->buckets[i] * HISTOGRAM_BAR_WIDTH / fullest;
+		fprintf(fp, "  %10" PRIu64 " - %-10" PRIu64 " %8" PRIu64 " %.*s\n",
+			i == 0 ? 0 : UINT64_C(1) << (i - 1), histogram_bucket_end(i), h->buckets[i],
+			width > 0 ? width : 1, "########################################");
+	}
+}
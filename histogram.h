@@ -0,0 +1,45 @@
+/*
+ * This file is part of hx - a hex editor for the terminal.
+ *
+ * Copyright (c) 2016 Kevin Pors. See LICENSE for details.
+ */
+
+#ifndef HX_HISTOGRAM_H
+#define HX_HISTOGRAM_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * A histogram of values with power of two buckets: bucket 0 counts zeroes,
+ * and bucket n the values from 2^(n-1) up to 2^n - 1. Cheap enough to add
+ * a value for every key or every frame.
+ */
+
+#define HISTOGRAM_BUCKETS 65
+
+struct histogram {
+	uint64_t buckets[HISTOGRAM_BUCKETS];
+	uint64_t count; // amount of values added.
+	uint64_t sum;   // sum of the values added.
+	uint64_t max;   // largest value added.
+};
+
+/*
+ * Adds `value' to the histogram.
+ */
+void histogram_add(struct histogram* h, uint64_t value);
+
+/*
+ * Returns an upper bound of the p-th percentile, the last value of the
+ * bucket holding it (or the maximum, when that's smaller).
+ */
+uint64_t histogram_percentile(const struct histogram* h, unsigned int p);
+
+/*
+ * Prints a summary line and a bar for every bucket in use to `fp'. The
+ * `title' describes the values, like "key latency (us)".
+ */
+void histogram_print(const struct histogram* h, FILE* fp, const char* title);
+
+#endif // HX_HISTOGRAM_H
@@ -9,17 +9,30 @@
 #define _DARWIN_C_SOURCE
 #endif
 
+// clock_gettime() is part of POSIX.1-2008. The Makefile defines _POSIX_SOURCE,
+// which would otherwise limit us to POSIX.1.
+#define _POSIX_C_SOURCE 200809L
+
+#include "charbuf.h"
 #include "editor.h"
+#include "histogram.h"
+#include "trace.h"
 #include "util.h"
 #include "undo.h"
+#include "watch.h"
 
 // C99 includes
+#include <errno.h>
+#include <limits.h>
 #include <stdio.h>
 #include <string.h>
 
 // POSIX and Linux cruft
+#include <fcntl.h>
 #include <getopt.h>
 #include <signal.h>
+#include <time.h>
+#include <unistd.h>
 
 // hx defines. Not declared as const because we may want to adjust
 // this by using a tool or whatever.
@@ -36,11 +49,22 @@ static struct editor* g_ec;
 
 
 volatile sig_atomic_t resizeflag; // flag indicating a SIGWINCH signal was received.
+volatile sig_atomic_t watchflag;  // flag indicating a SIGIO signal was received.
+
+// First line of a recording of keys, followed by the screen size. The key
+// codes follow as two bytes each, little endian (see read_key_record()).
+static const char KEYS_HEADER[] = "hx-keys 1";
+
+// Measurements of a headless replay, and where to report them.
+static struct histogram key_latency;
+static struct histogram frame_size;
+static FILE* headless_out;
 
 /*
  * Exits the editor, frees some stuff and resets the terminal setting.
  */
 static void editor_exit() {
+	watch_close();
 	editor_free(g_ec);
 	clear_screen();
 	disable_raw_mode();
@@ -54,13 +78,31 @@ static void editor_exit() {
 static void print_help(const char* explanation) {
 	fprintf(stderr,
 	"%s"\
-	"usage: hx [-hv] [-o octets_per_line] [-g grouping_bytes] filename\n"\
+	"usage: hx [-hvf] [-o octets_per_line] [-g grouping_bytes] filename\n"\
+	"       hx [-hv] [-o octets_per_line] [-g grouping_bytes] -p pid\n"\
+	"       hx --replay keys [--headless] filename\n"\
+	"       hx --trace-json trace\n"\
 	"\n"
 	"Command options:\n"
 	"    -h     Print this cruft and exits\n"
 	"    -v     Version information\n"
 	"    -o     Amount of octets per line\n"
 	"    -g     Grouping of bytes in one line\n"
+	"    -f     Follow the end of a growing file (read-only)\n"
+	"    -p     View and patch the memory of the running process pid\n"
+	"    --record keys\n"
+	"           Record the keys typed in this session to the file keys\n"
+	"    --replay keys\n"
+	"           Replay the keys recorded in the file keys first\n"
+	"    --headless\n"
+	"           Replay without a terminal, then print the processing time\n"
+	"           of every key and the sizes of the frames drawn\n"
+	"    --trace trace\n"
+	"           Write timestamped events (loading, rendering, searching,\n"
+	"           saving, ...) to the binary file trace\n"
+	"    --trace-json trace\n"
+	"           Print the events in the file trace as JSON, for viewers\n"
+	"           like chrome://tracing or Perfetto\n"
 	"\n"
 	"Currently, both these values are advised to be a multiple of 2\n"
 	"to prevent garbled display :)\n"
@@ -111,6 +153,124 @@ static void handle_term_resize(int sig) {
 	resizeflag = 1;
 }
 
+/*
+ * Handles the SIGIO signal, which is sent when the file being edited was
+ * changed by another process (see watch.h).
+ */
+static void handle_file_change(int sig) {
+	(void)(sig);
+	watchflag = 1;
+}
+
+/*
+ * Handles the SIGUSR1 signal, which is sent when block statistics were
+ * computed in the background (see blockstat.h). Interrupting the read() in
+ * read_key() is all that's needed: the screen is refreshed in the main loop.
+ */
+static void handle_stats_update(int sig) {
+	(void)(sig);
+}
+
+/*
+ * Returns the current time of the monotonic clock in microseconds.
+ */
+static uint64_t now_us() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/*
+ * Creates the recording `path', writes the header with the screen size to
+ * it, and records the keys read from then on.
+ */
+static void record_keys(const char* path, int rows, int cols) {
+	int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd == -1) {
+		perror("Unable to create the recording");
+		exit(1);
+	}
+	char header[64];
+	int len = snprintf(header, sizeof(header), "%s %d %d\n", KEYS_HEADER, rows, cols);
+	if (write(fd, header, len) != len) {
+		perror("Unable to write the recording");
+		exit(1);
+	}
+	read_key_record(fd);
+}
+
+/*
+ * Opens the recording `path', stores the screen size it was recorded with
+ * in `rows' and `cols', and replays its keys before reading the terminal.
+ * In headless mode, the end of the recording ends the program.
+ */
+static void replay_keys(const char* path, int* rows, int* cols, bool headless) {
+	int fd = open(path, O_RDONLY);
+	if (fd == -1) {
+		perror("Unable to open the recording");
+		exit(1);
+	}
+
+	// Read the header byte by byte, so the key codes after it are left.
+	char header[64] = {0};
+	for (size_t i = 0; i < sizeof(header) - 1; i++) {
+		if (read(fd, &header[i], 1) != 1 || header[i] == '\n') {
+			break;
+		}
+	}
+	if (strncmp(header, KEYS_HEADER, strlen(KEYS_HEADER)) != 0
+	    || sscanf(header + strlen(KEYS_HEADER), "%d %d", rows, cols) != 2
+	    || *rows < 1 || *cols < 1) {
+		fprintf(stderr, "File '%s' is not a recording of keys\n", path);
+		exit(1);
+	}
+	read_key_replay(fd, headless);
+}
+
+/*
+ * Receives the frames in headless mode, instead of the screen.
+ */
+static void count_frame(const char* contents, int len) {
+	(void) contents;
+	histogram_add(&frame_size, len);
+}
+
+/*
+ * Reports the measurements of a headless replay when it's done.
+ */
+static void headless_exit() {
+	histogram_print(&key_latency, headless_out, "key processing time (us)");
+	histogram_print(&frame_size, headless_out, "frame size (bytes)");
+	fclose(headless_out);
+	editor_free(g_ec);
+}
+
+/*
+ * Replays the recorded keys without a terminal. Whatever hx writes to the
+ * screen is discarded. The time to process every key and draw the resulting
+ * frame is measured. The program exits at the end of the recording.
+ */
+static void run_headless() {
+	// Keep stdout for the report, but discard anything drawn.
+	headless_out = fdopen(dup(STDOUT_FILENO), "w");
+	int devnull = open("/dev/null", O_WRONLY);
+	if (headless_out == NULL || devnull == -1 || dup2(devnull, STDOUT_FILENO) == -1) {
+		perror("Unable to redirect the output");
+		exit(1);
+	}
+	close(devnull);
+	charbuf_set_sink(count_frame);
+	atexit(headless_exit);
+
+	editor_refresh_screen(g_ec);
+	while (true) {
+		uint64_t start = now_us();
+		editor_process_keypress(g_ec);
+		editor_refresh_screen(g_ec);
+		histogram_add(&key_latency, now_us() - start);
+	}
+}
+
 static void resize_term() {
 	clear_screen();
 	get_window_size(&(g_ec->screen_rows), &(g_ec->screen_cols));
@@ -120,10 +280,48 @@ int main(int argc, char* argv[]) {
 	char* file = NULL;
 	int octets_per_line = 16;
 	int grouping = 4;
+	bool follow = false;
+	int pid = -1;
+
+	const char* record = NULL;
+	const char* replay = NULL;
+	bool headless = false;
+	const char* trace = NULL;
+
+	// Options without a short equivalent.
+	enum { OPT_RECORD = 256, OPT_REPLAY, OPT_HEADLESS, OPT_TRACE, OPT_TRACE_JSON };
+	static const struct option long_options[] = {
+		{ "record",     required_argument, NULL, OPT_RECORD },
+		{ "replay",     required_argument, NULL, OPT_REPLAY },
+		{ "headless",   no_argument,       NULL, OPT_HEADLESS },
+		{ "trace",      required_argument, NULL, OPT_TRACE },
+		{ "trace-json", required_argument, NULL, OPT_TRACE_JSON },
+		{ NULL,         0,                 NULL, 0 },
+	};
 
 	int ch = 0;
-	while ((ch = getopt(argc, argv, "vhg:o:")) != -1) {
+	while ((ch = getopt_long(argc, argv, "vhfg:o:p:", long_options, NULL)) != -1) {
 		switch (ch) {
+		case OPT_RECORD:
+			record = optarg;
+			break;
+		case OPT_REPLAY:
+			replay = optarg;
+			break;
+		case OPT_HEADLESS:
+			headless = true;
+			break;
+		case OPT_TRACE:
+			trace = optarg;
+			break;
+		case OPT_TRACE_JSON:
+			errno = 0;
+			if (!trace_convert(optarg, stdout)) {
+				fprintf(stderr, "Cannot read trace '%s': %s\n", optarg,
+					errno != 0 ? strerror(errno) : "not a trace file");
+				exit(1);
+			}
+			exit(0);
 		case 'v':
 			print_version();
 			return 0;
@@ -131,13 +329,23 @@ int main(int argc, char* argv[]) {
 			print_help("");
 			exit(0);
 			break;
+		case 'f':
+			follow = true;
+			break;
+		case 'p':
+			pid = str2int(optarg, 1, INT_MAX, -1);
+			if (pid == -1) {
+				print_help("error: invalid pid\n");
+				exit(1);
+			}
+			break;
 		case 'g':
 			// parse grouping
 			grouping = str2int(optarg, 2, 16, 4);
 			break;
 		case 'o':
 			// parse octets per line
-			octets_per_line = str2int(optarg, 16, 64, 16);
+			octets_per_line = str2int(optarg, 1, EDITOR_MAX_OCTETS, 16);
 			break;
 		default:
 			print_help("");
@@ -146,13 +354,21 @@ int main(int argc, char* argv[]) {
 		}
 	}
 
-	// After all options are parsed, we expect a filename to open.
-	if (optind >= argc) {
+	// After all options are parsed, we expect a filename to open, unless
+	// we're opening the memory of a process.
+	if (pid == -1 && optind >= argc) {
 		print_help("error: expected filename\n");
 		exit(1);
 	}
 
-	file = argv[optind];
+	if (pid == -1) {
+		file = argv[optind];
+	}
+
+	if (headless && replay == NULL) {
+		print_help("error: --headless needs keys to --replay\n");
+		exit(1);
+	}
 
 	// Signal handler to react on screen resizing.
 	struct sigaction act;
@@ -164,12 +380,68 @@ int main(int argc, char* argv[]) {
 	}
 	resizeflag = 0;
 
+	// Signal handler to react on changes of the file on disk. Installed
+	// before the watch is set up, since the default action of SIGIO is
+	// to terminate the process.
+	act.sa_handler = handle_file_change;
+	if (sigaction(SIGIO, &act, NULL) == -1) {
+		perror("A sigaction() call failed");
+		abort();
+	}
+	watchflag = 0;
+
+	act.sa_handler = handle_stats_update;
+	if (sigaction(SIGUSR1, &act, NULL) == -1) {
+		perror("A sigaction() call failed");
+		abort();
+	}
+
+	int rows;
+	int cols;
+	if (!headless && !get_window_size(&rows, &cols)) {
+		perror("Failed to query terminal size");
+		exit(1);
+	}
+	if (record != NULL) {
+		record_keys(record, rows, cols);
+	}
+	if (trace != NULL) {
+		if (!trace_open(trace)) {
+			fprintf(stderr, "Cannot create trace '%s': %s\n", trace, strerror(errno));
+			exit(1);
+		}
+		// Registered before the other handlers, so it runs after them.
+		atexit(trace_close);
+	}
+	if (replay != NULL) {
+		replay_keys(replay, &rows, &cols, headless);
+	}
+
 	// Editor configuration passed around.
 	g_ec = editor_init();
-	g_ec->octets_per_line = octets_per_line;
 	g_ec->grouping = grouping;
+	g_ec->follow = follow;
+	if (headless) {
+		// Render like the terminal the keys were recorded on.
+		g_ec->screen_rows = rows;
+		g_ec->screen_cols = cols;
+	}
+	g_ec->octets_per_line = clampi(octets_per_line, 1, editor_max_octets(g_ec));
 
-	editor_openfile(g_ec, file);
+	TRACE_BEGIN(TRACE_OPEN);
+	if (pid != -1) {
+		editor_openprocess(g_ec, pid);
+	} else {
+		editor_openfile(g_ec, file);
+	}
+	TRACE_END(TRACE_OPEN);
+	if (pid == -1 && !headless) {
+		watch_file(file);
+	}
+
+	if (headless) {
+		run_headless();
+	}
 
 	enable_raw_mode();
 	term_state_save();
@@ -184,6 +456,16 @@ int main(int argc, char* argv[]) {
 			resize_term();
 			resizeflag = 0;
 		}
+		if (watchflag == 1) {
+			watchflag = 0;
+			if (watch_poll()) {
+				if (g_ec->follow) {
+					editor_follow_update(g_ec);
+				} else if (!g_ec->windowed) {
+					editor_reload(g_ec, false);
+				}
+			}
+		}
 		//debug_keypress();
 	}
 
@@ -0,0 +1,156 @@
+/*
+ * This file is part of hx - a hex editor for the terminal.
+ *
+ * Copyright (c) 2016 Kevin Pors. See LICENSE for details.
+ */
+
+#include "inspector.h"
+#include "mem.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+struct inspector* inspector_create() {
+	struct inspector* in = mem_alloc(MEM_OTHER, sizeof(struct inspector));
+	if (in == NULL) {
+		perror("Could not allocate memory for the data inspector");
+		abort();
+	}
+	in->valid = false;
+	return in;
+}
+
+void inspector_free(struct inspector* in) {
+	mem_free(in);
+}
+
+/*
+ * Reads `size' bytes from `b' as an unsigned integer, either little endian
+ * or big endian. Doing this byte by byte keeps it independent of the
+ * endianness of the host.
+ */
+static uint64_t read_uint(const unsigned char* b, unsigned int size, bool big_endian) {
+	uint64_t v = 0;
+	for (unsigned int i = 0; i < size; i++) {
+		unsigned int idx = big_endian ? i : size - 1 - i;
+		v = (v << 8) | b[idx];
+	}
+	return v;
+}
+
+/*
+ * Sign extends the `size' bytes unsigned value `v'.
+ */
+static int64_t sign_extend(uint64_t v, unsigned int size) {
+	if (size < 8 && (v & (UINT64_C(1) << (size * 8 - 1)))) {
+		v |= ~UINT64_C(0) << (size * 8);
+	}
+	return (int64_t) v;
+}
+
+/*
+ * Formats the integer lines for values of `size' bytes, starting at `line'.
+ * Returns the line after the last one formatted.
+ */
+static unsigned int format_ints(struct inspector* in, unsigned int line, unsigned int size) {
+	static const char* order[] = { "LE", "BE" };
+	for (int s = 0; s < 2; s++) {
+		for (int be = 0; be < 2; be++) {
+			char* dst = in->lines[line++];
+			int n = snprintf(dst, INSPECTOR_WIDTH + 1, "%c%-2u %s ", s ? 'i' : 'u', size * 8, order[be]);
+			if (in->avail < size) {
+				snprintf(dst + n, INSPECTOR_WIDTH + 1 - n, "-");
+				continue;
+			}
+			uint64_t v = read_uint(in->bytes, size, be);
+			if (s) {
+				snprintf(dst + n, INSPECTOR_WIDTH + 1 - n, "%" PRId64, sign_extend(v, size));
+			} else {
+				snprintf(dst + n, INSPECTOR_WIDTH + 1 - n, "%" PRIu64, v);
+			}
+		}
+	}
+	return line;
+}
+
+bool inspector_update(struct inspector* in, uint64_t offset, const char* p, unsigned int avail) {
+	if (avail > INSPECTOR_BYTES) {
+		avail = INSPECTOR_BYTES;
+	}
+	if (in->valid && in->offset == offset && in->avail == avail && memcmp(in->bytes, p, avail) == 0) {
+		return false;
+	}
+	in->valid = true;
+	in->offset = offset;
+	in->avail = avail;
+	memcpy(in->bytes, p, avail);
+
+	unsigned int line = 0;
+	snprintf(in->lines[line++], INSPECTOR_WIDTH + 1, "Data inspector @ 0x%09" PRIx64, offset);
+	if (avail == 0) {
+		snprintf(in->lines[line++], INSPECTOR_WIDTH + 1, "i8     -");
+		snprintf(in->lines[line++], INSPECTOR_WIDTH + 1, "u8     -");
+	} else {
+		snprintf(in->lines[line++], INSPECTOR_WIDTH + 1, "i8     %d", (signed char) in->bytes[0]);
+		snprintf(in->lines[line++], INSPECTOR_WIDTH + 1, "u8     %u", in->bytes[0]);
+	}
+	line = format_ints(in, line, 2);
+	line = format_ints(in, line, 4);
+	line = format_ints(in, line, 8);
+
+	for (int be = 0; be < 2; be++) {
+		const char* order = be ? "BE" : "LE";
+		if (avail >= 4) {
+			uint32_t bits = read_uint(in->bytes, 4, be);
+			float f;
+			memcpy(&f, &bits, sizeof(f));
+			snprintf(in->lines[line++], INSPECTOR_WIDTH + 1, "f32 %s %g", order, f);
+		} else {
+			snprintf(in->lines[line++], INSPECTOR_WIDTH + 1, "f32 %s -", order);
+		}
+	}
+	for (int be = 0; be < 2; be++) {
+		const char* order = be ? "BE" : "LE";
+		if (avail >= 8) {
+			uint64_t bits = read_uint(in->bytes, 8, be);
+			double d;
+			memcpy(&d, &bits, sizeof(d));
+			snprintf(in->lines[line++], INSPECTOR_WIDTH + 1, "f64 %s %g", order, d);
+		} else {
+			snprintf(in->lines[line++], INSPECTOR_WIDTH + 1, "f64 %s -", order);
+		}
+	}
+
+	// UNIX timestamp, as a 32 bit little endian value (the most common).
+	char* dst = in->lines[line++];
+	struct tm* tm = NULL;
+	if (avail >= 4) {
+		time_t t = (time_t) read_uint(in->bytes, 4, false);
+		tm = gmtime(&t);
+	}
+	if (tm == NULL || strftime(dst, INSPECTOR_WIDTH + 1, "time   %Y-%m-%d %H:%M:%S UTC", tm) == 0) {
+		snprintf(dst, INSPECTOR_WIDTH + 1, "time   -");
+	}
+
+	// Unsigned LEB128: 7 bits per byte, least significant group first, the
+	// high bit set on all bytes but the last.
+	dst = in->lines[line++];
+	uint64_t v = 0;
+	unsigned int i = 0;
+	for (; i < avail; i++) {
+		v |= (uint64_t) (in->bytes[i] & 0x7f) << (7 * i);
+		if ((in->bytes[i] & 0x80) == 0) {
+			break;
+		}
+	}
+	if (i < avail) {
+		snprintf(dst, INSPECTOR_WIDTH + 1, "uleb   %" PRIu64 " (%u bytes)", v, i + 1);
+	} else {
+		snprintf(dst, INSPECTOR_WIDTH + 1, "uleb   -");
+	}
+
+	return true;
+}
@@ -0,0 +1,53 @@
+/*
+ * This file is part of hx - a hex editor for the terminal.
+ *
+ * Copyright (c) 2016 Kevin Pors. See LICENSE for details.
+ */
+
+#ifndef HX_INSPECTOR_H
+#define HX_INSPECTOR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * The data inspector decodes the bytes at the cursor as integers of several
+ * sizes (little and big endian), floating point numbers, a UNIX timestamp and
+ * an unsigned LEB128 number. The decoded lines are cached together with the
+ * bytes they were decoded from, so they are only formatted again when the
+ * cursor moves or the bytes under it change.
+ */
+
+// Maximum amount of bytes decoded at once (a ULEB128 of a 64 bit value).
+#define INSPECTOR_BYTES 10
+// Amount of lines in the panel, and the width of every line.
+#define INSPECTOR_LINES 21
+#define INSPECTOR_WIDTH 34
+
+struct inspector {
+	bool          valid;                  // whether the cached lines are valid.
+	uint64_t      offset;                 // file offset the lines were decoded at.
+	unsigned int  avail;                  // amount of bytes that were available.
+	unsigned char bytes[INSPECTOR_BYTES]; // the bytes decoded.
+
+	char lines[INSPECTOR_LINES][INSPECTOR_WIDTH + 1]; // the formatted lines.
+};
+
+/*
+ * Creates an inspector with no decoded lines yet.
+ */
+struct inspector* inspector_create();
+
+/*
+ * Frees the inspector.
+ */
+void inspector_free(struct inspector* in);
+
+/*
+ * Decodes the `avail' bytes at `p' (at most INSPECTOR_BYTES are used), which
+ * are found at file offset `offset'. Nothing is done when these are the same
+ * as the last time. Returns true if the lines were formatted again.
+ */
+bool inspector_update(struct inspector* in, uint64_t offset, const char* p, unsigned int avail);
+
+#endif // HX_INSPECTOR_H
@@ -0,0 +1,68 @@
+/*
+ * This file is part of hx - a hex editor for the terminal.
+ *
+ * Copyright (c) 2016 Kevin Pors. See LICENSE for details.
+ */
+
+#include "jumplist.h"
+
+/*
+ * Returns the entry `i', counting from the oldest one.
+ */
+static uint64_t* jump_list_entry(struct jump_list* jl, unsigned int i) {
+	return &jl->offsets[(jl->first + i) % JUMP_LIST_SIZE];
+}
+
+/*
+ * Appends `offset', dropping the oldest entry when the ring is full.
+ */
+static void jump_list_append(struct jump_list* jl, uint64_t offset) {
+	if (jl->count == JUMP_LIST_SIZE) {
+		jl->first = (jl->first + 1) % JUMP_LIST_SIZE;
+		jl->count--;
+	}
+	*jump_list_entry(jl, jl->count) = offset;
+	jl->count++;
+}
+
+void jump_list_init(struct jump_list* jl) {
+	jl->first = 0;
+	jl->count = 0;
+	jl->pos = 0;
+}
+
+void jump_list_push(struct jump_list* jl, uint64_t offset) {
+	// The entry moved to is replaced by where the cursor is now.
+	jl->count = jl->pos;
+	jump_list_append(jl, offset);
+	jl->pos = jl->count;
+}
+
+bool jump_list_back(struct jump_list* jl, uint64_t current, uint64_t* offset) {
+	if (jl->pos == jl->count) {
+		// Remember where we came from, to move forward to it again.
+		if (jl->count == 0) {
+			return false;
+		}
+		jump_list_append(jl, current);
+		jl->pos = jl->count - 1;
+	} else {
+		*jump_list_entry(jl, jl->pos) = current;
+	}
+	if (jl->pos == 0) {
+		return false;
+	}
+	jl->pos--;
+	*offset = *jump_list_entry(jl, jl->pos);
+	return true;
+}
+
+bool jump_list_forward(struct jump_list* jl, uint64_t current, uint64_t* offset) {
+	if (jl->pos + 1 >= jl->count) {
+		return false;
+	}
+	*jump_list_entry(jl, jl->pos) = current;
+	jl->pos++;
+	*offset = *jump_list_entry(jl, jl->pos);
+	return true;
+}
@@ -0,0 +1,51 @@
+/*
+ * This file is part of hx - a hex editor for the terminal.
+ *
+ * Copyright (c) 2016 Kevin Pors. See LICENSE for details.
+ */
+
+#ifndef HX_JUMPLIST_H
+#define HX_JUMPLIST_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * The offsets jumped from, like the jump list of vim. They are kept in a
+ * fixed ring, so once it's full the oldest offset makes room for the newest
+ * and nothing is ever allocated.
+ */
+
+#define JUMP_LIST_SIZE 100
+
+struct jump_list {
+	uint64_t offsets[JUMP_LIST_SIZE];
+	unsigned int first; // index of the oldest offset in the ring.
+	unsigned int count;
+	unsigned int pos;   // the entry moved to with back/forward, or count when none.
+};
+
+/*
+ * Empties the list.
+ */
+void jump_list_init(struct jump_list* jl);
+
+/*
+ * Records a jump from `offset'. The entries newer than the one moved to with
+ * jump_list_back() are dropped, like the history of a browser.
+ */
+void jump_list_push(struct jump_list* jl, uint64_t offset);
+
+/*
+ * Moves to the previous entry from `current', and sets `offset' to it.
+ * Returns false when there is no older entry.
+ */
+bool jump_list_back(struct jump_list* jl, uint64_t current, uint64_t* offset);
+
+/*
+ * Moves to the next entry from `current', and sets `offset' to it. Returns
+ * false when there is no newer entry.
+ */
+bool jump_list_forward(struct jump_list* jl, uint64_t current, uint64_t* offset);
+
+#endif // HX_JUMPLIST_H
@@ -0,0 +1,144 @@
+/*
+ * This file is part of hx - a hex editor for the terminal.
+ *
+ * Copyright (c) 2016 Kevin Pors. See LICENSE for details.
+ */
+
+#include "listview.h"
+#include "mem.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct listview* listview_create(const char* title, size_t count, void* data,
+                                 listview_format_fn format, listview_offset_fn offset) {
+	struct listview* lv = mem_alloc(MEM_INDEX, sizeof(struct listview));
+	if (lv == NULL) {
+		perror("Could not allocate memory for the list");
+		abort();
+	}
+	snprintf(lv->title, sizeof(lv->title), "%s", title);
+	lv->count = count;
+	lv->data = data;
+	lv->format = format;
+	lv->offset = offset;
+	lv->shown = NULL;
+	lv->shown_count = 0;
+	lv->selected = 0;
+	lv->top = 0;
+	lv->filter[0] = '\0';
+	lv->filtering = false;
+
+	listview_set_filter(lv, "");
+	return lv;
+}
+
+void listview_free(struct listview* lv) {
+	mem_free(lv->shown);
+	mem_free(lv);
+}
+
+/*
+ * Returns true if `needle' occurs in `haystack', ignoring case.
+ */
+static bool contains_nocase(const char* haystack, const char* needle) {
+	size_t n = strlen(needle);
+	for (; *haystack != '\0'; haystack++) {
+		size_t i = 0;
+		while (i < n && haystack[i] != '\0'
+		       && tolower((unsigned char) haystack[i]) == tolower((unsigned char) needle[i])) {
+			i++;
+		}
+		if (i == n) {
+			return true;
+		}
+	}
+	return n == 0;
+}
+
+void listview_set_filter(struct listview* lv, const char* filter) {
+	snprintf(lv->filter, sizeof(lv->filter), "%s", filter);
+
+	if (lv->shown == NULL) {
+		lv->shown = mem_alloc(MEM_INDEX, (lv->count + 1) * sizeof(size_t));
+		if (lv->shown == NULL) {
+			perror("Could not allocate memory for the list");
+			abort();
+		}
+	}
+
+	// Keep the selected item selected, if it still matches.
+	size_t previous = lv->shown_count > 0 ? lv->shown[lv->selected] : 0;
+
+	char line[LISTVIEW_LINE_SIZE];
+	lv->shown_count = 0;
+	lv->selected = 0;
+	for (size_t i = 0; i < lv->count; i++) {
+		if (lv->filter[0] != '\0') {
+			lv->format(lv->data, i, line, sizeof(line));
+			if (!contains_nocase(line, lv->filter)) {
+				continue;
+			}
+		}
+		if (i <= previous) {
+			lv->selected = lv->shown_count;
+		}
+		lv->shown[lv->shown_count++] = i;
+	}
+	lv->top = lv->selected;
+}
+
+void listview_move(struct listview* lv, long delta, unsigned int rows) {
+	if (lv->shown_count == 0) {
+		return;
+	}
+	if (delta < 0 && (size_t) -delta > lv->selected) {
+		lv->selected = 0;
+	} else if (delta > 0 && (size_t) delta >= lv->shown_count - lv->selected) {
+		lv->selected = lv->shown_count - 1;
+	} else {
+		lv->selected += delta;
+	}
+
+	if (rows == 0) {
+		rows = 1;
+	}
+	if (lv->selected < lv->top) {
+		lv->top = lv->selected;
+	} else if (lv->selected >= lv->top + rows) {
+		lv->top = lv->selected - rows + 1;
+	}
+}
+
+bool listview_selected(struct listview* lv, size_t* item) {
+	if (lv->shown_count == 0) {
+		return false;
+	}
+	*item = lv->shown[lv->selected];
+	return true;
+}
+
+void listview_render(struct listview* lv, struct charbuf* b, unsigned int rows, unsigned int cols) {
+	if (cols >= LISTVIEW_LINE_SIZE) {
+		cols = LISTVIEW_LINE_SIZE - 1;
+	}
+
+	// The selection may have been moved out of view by a resize.
+	listview_move(lv, 0, rows);
+
+	char line[LISTVIEW_LINE_SIZE];
+	for (unsigned int row = 0; row < rows; row++) {
+		size_t i = lv->top + row;
+		if (i < lv->shown_count) {
+			lv->format(lv->data, lv->shown[i], line, sizeof(line));
+			line[cols] = '\0';
+			charbuf_appendf(b, "%s%s\x1b[0m",
+				i == lv->selected ? "\x1b[7m" : "", line);
+		} else {
+			charbuf_append(b, "\x1b[34m~\x1b[0m", 10);
+		}
+		charbuf_append(b, "\x1b[K\r\n", 5);
+	}
+}
@@ -0,0 +1,88 @@
+/*
+ * This file is part of hx - a hex editor for the terminal.
+ *
+ * Copyright (c) 2016 Kevin Pors. See LICENSE for details.
+ */
+
+#ifndef HX_LISTVIEW_H
+#define HX_LISTVIEW_H
+
+#include "charbuf.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * A full screen list of items, like the strings found in the file, which can
+ * be browsed and narrowed down with a filter. The list does not own the
+ * items: it only knows how many there are, and asks its owner to format an
+ * item into a line of text, and for the offset in the file the item refers
+ * to.
+ */
+
+// Maximum length of a formatted item, including the zero terminator.
+#define LISTVIEW_LINE_SIZE 256
+
+/*
+ * Formats item `item' of `data' into `dst', which is `len' bytes in size.
+ */
+typedef void (*listview_format_fn)(void* data, size_t item, char* dst, size_t len);
+
+/*
+ * Returns the file offset item `item' of `data' refers to.
+ */
+typedef uint64_t (*listview_offset_fn)(void* data, size_t item);
+
+struct listview {
+	char   title[80]; // title shown above the items.
+	size_t count;     // amount of items.
+	void*  data;      // the owner of the items, passed to the callbacks.
+	listview_format_fn format;
+	listview_offset_fn offset;
+
+	size_t* shown;       // the items matching the filter, in order.
+	size_t  shown_count; // amount of items matching the filter.
+	size_t  selected;    // index in `shown' of the selected item.
+	size_t  top;         // index in `shown' of the first item on screen.
+
+	char filter[64]; // only items containing this text are shown.
+	bool filtering;  // whether the filter is being typed.
+};
+
+/*
+ * Creates a list of `count' items, formatted by `format'. `offset' may be
+ * NULL for items which do not refer to an offset.
+ */
+struct listview* listview_create(const char* title, size_t count, void* data,
+                                 listview_format_fn format, listview_offset_fn offset);
+
+/*
+ * Frees the list. The items themselves are left alone.
+ */
+void listview_free(struct listview* lv);
+
+/*
+ * Sets the filter. Only the items with a formatted line containing
+ * `filter' (ignoring case) are shown. An empty filter shows all items.
+ */
+void listview_set_filter(struct listview* lv, const char* filter);
+
+/*
+ * Moves the selection by `delta' items, keeping it visible in a screen of
+ * `rows' items.
+ */
+void listview_move(struct listview* lv, long delta, unsigned int rows);
+
+/*
+ * Stores the selected item in `item'. Returns false if no item is shown.
+ */
+bool listview_selected(struct listview* lv, size_t* item);
+
+/*
+ * Renders `rows' items of the list, at most `cols' characters wide, starting
+ * at the current cursor position of the screen.
+ */
+void listview_render(struct listview* lv, struct charbuf* b, unsigned int rows, unsigned int cols);
+
+#endif // HX_LISTVIEW_H
@@ -0,0 +1,212 @@
+/*
+ * This file is part of hx - a hex editor for the terminal.
+ *
+ * Copyright (c) 2016 Kevin Pors. See LICENSE for details.
+ */
+
+#include "marks.h"
+#include "mem.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct marks* marks_create() {
+	struct marks* m = mem_calloc(MEM_INDEX, 1, sizeof(struct marks));
+	if (m == NULL) {
+		perror("Could not allocate memory for the marks");
+		abort();
+	}
+	return m;
+}
+
+void marks_free(struct marks* m) {
+	mem_free(m->marks);
+	mem_free(m->shifts);
+	mem_free(m);
+}
+
+/*
+ * Adds `delta' to the shifts of the marks from position `i' onward.
+ */
+static void marks_tree_add(struct marks* m, unsigned int i, uint64_t delta) {
+	for (unsigned int k = i + 1; k <= m->count; k += k & -k) {
+		m->shifts[k - 1] += delta;
+	}
+}
+
+uint64_t marks_offset(const struct marks* m, unsigned int i) {
+	// The shifts wrap around like the offsets would, so deletions are
+	// simply added as well.
+	uint64_t offset = m->marks[i].offset;
+	for (unsigned int k = i + 1; k > 0; k -= k & -k) {
+		offset += m->shifts[k - 1];
+	}
+	return offset;
+}
+
+/*
+ * Returns the position of the first mark at or after `offset'.
+ */
+static unsigned int marks_first_at(const struct marks* m, uint64_t offset) {
+	unsigned int lo = 0;
+	unsigned int hi = m->count;
+	while (lo < hi) {
+		unsigned int mid = lo + (hi - lo) / 2;
+		if (marks_offset(m, mid) < offset) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return lo;
+}
+
+/*
+ * Applies the shifts to the offsets of the marks, and empties the tree.
+ */
+static void marks_fold(struct marks* m) {
+	for (unsigned int i = 0; i < m->count; i++) {
+		m->marks[i].offset = marks_offset(m, i);
+	}
+	if (m->shifts != NULL) {
+		memset(m->shifts, 0, m->cap * sizeof(uint64_t));
+	}
+}
+
+int marks_find(const struct marks* m, const char* name) {
+	for (unsigned int i = 0; i < m->count; i++) {
+		if (strcmp(m->marks[i].name, name) == 0) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+void marks_set(struct marks* m, const char* name, uint64_t offset, const char* comment) {
+	marks_remove(m, name);
+	marks_fold(m);
+
+	if (m->count == m->cap) {
+		m->cap = m->cap == 0 ? 16 : m->cap * 2;
+		m->marks = mem_realloc(MEM_INDEX, m->marks, m->cap * sizeof(struct mark));
+		m->shifts = mem_realloc(MEM_INDEX, m->shifts, m->cap * sizeof(uint64_t));
+		if (m->marks == NULL || m->shifts == NULL) {
+			perror("Could not allocate memory for the marks");
+			abort();
+		}
+		memset(m->shifts, 0, m->cap * sizeof(uint64_t));
+	}
+
+	// After the marks already at that offset.
+	unsigned int pos = marks_first_at(m, offset);
+	while (pos < m->count && m->marks[pos].offset == offset) {
+		pos++;
+	}
+	memmove(&m->marks[pos + 1], &m->marks[pos], (m->count - pos) * sizeof(struct mark));
+	struct mark* mark = &m->marks[pos];
+	mark->offset = offset;
+	snprintf(mark->name, sizeof(mark->name), "%s", name);
+	snprintf(mark->comment, sizeof(mark->comment), "%s", comment);
+	m->count++;
+}
+
+bool marks_remove(struct marks* m, const char* name) {
+	int i = marks_find(m, name);
+	if (i == -1) {
+		return false;
+	}
+	marks_fold(m);
+	memmove(&m->marks[i], &m->marks[i + 1], (m->count - i - 1) * sizeof(struct mark));
+	m->count--;
+	return true;
+}
+
+void marks_shift(struct marks* m, uint64_t offset, int amount) {
+	if (amount >= 0) {
+		// The mark of the byte at `offset' moves along with it.
+		unsigned int i = marks_first_at(m, offset);
+		if (i < m->count) {
+			marks_tree_add(m, i, amount);
+		}
+		return;
+	}
+
+	uint64_t deleted = -(int64_t) amount;
+	unsigned int i = marks_first_at(m, offset);
+	unsigned int end = marks_first_at(m, offset + deleted);
+
+	// The marks of deleted bytes end up at `offset', which keeps them in
+	// order: the marks before them are before `offset'.
+	for (unsigned int k = i; k < end; k++) {
+		uint64_t delta = offset - marks_offset(m, k);
+		marks_tree_add(m, k, delta);
+		if (k + 1 < m->count) {
+			marks_tree_add(m, k + 1, -delta);
+		}
+	}
+	if (end < m->count) {
+		marks_tree_add(m, end, -deleted);
+	}
+}
+
+bool marks_load(struct marks* m, const char* path) {
+	FILE* fp = fopen(path, "r");
+	if (fp == NULL) {
+		return errno == ENOENT;
+	}
+
+	// Every line holds the offset in hex, the name and the comment, if any.
+	char line[MARK_NAME_SIZE + MARK_COMMENT_SIZE + 32];
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		line[strcspn(line, "\n")] = '\0';
+		if (line[0] == '#' || line[0] == '\0') {
+			continue;
+		}
+		uint64_t offset;
+		char name[MARK_NAME_SIZE];
+		int n = 0;
+		if (sscanf(line, "%" SCNx64 " %31s%n", &offset, name, &n) != 2) {
+			continue;
+		}
+		const char* comment = line + n;
+		while (*comment == ' ') {
+			comment++;
+		}
+		marks_set(m, name, offset, comment);
+	}
+
+	bool ok = !ferror(fp);
+	fclose(fp);
+	return ok;
+}
+
+bool marks_save(const struct marks* m, const char* path) {
+	if (m->count == 0) {
+		return remove(path) == 0 || errno == ENOENT;
+	}
+
+	// Written next to it first, so a failed write leaves the old marks.
+	char tmp[4096];
+	if (snprintf(tmp, sizeof(tmp), "%s.tmp", path) >= (int) sizeof(tmp)) {
+		errno = ENAMETOOLONG;
+		return false;
+	}
+	FILE* fp = fopen(tmp, "w");
+	if (fp == NULL) {
+		return false;
+	}
+	fprintf(fp, "# hx marks: offset name comment\n");
+	for (unsigned int i = 0; i < m->count; i++) {
+		const struct mark* mark = &m->marks[i];
+		fprintf(fp, "%" PRIx64 " %s%s%s\n", marks_offset(m, i), mark->name,
+			mark->comment[0] != '\0' ? " " : "", mark->comment);
+	}
+	if (fclose(fp) != 0) {
+		remove(tmp);
+		return false;
+	}
+	return rename(tmp, path) == 0;
+}
@@ -0,0 +1,91 @@
+/*
+ * This file is part of hx - a hex editor for the terminal.
+ *
+ * Copyright (c) 2016 Kevin Pors. See LICENSE for details.
+ */
+
+#ifndef HX_MARKS_H
+#define HX_MARKS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Marks (`ma' to `mz') and named bookmarks, which are the same thing: a
+ * bookmark called `a' is mark a. They follow the bytes they mark when bytes
+ * are inserted or deleted before them.
+ *
+ * The marks are sorted by offset, and shifts are not applied to them one by
+ * one. A Fenwick tree holds the shifts by position instead, so a mark's
+ * offset is its offset when the tree was last folded in, plus the sum of the
+ * shifts up to its position. Inserting or deleting a byte then takes two
+ * binary searches and a few updates of the tree, however many marks there
+ * are. Adding or removing a mark folds the tree in again.
+ */
+
+#define MARK_NAME_SIZE    32
+#define MARK_COMMENT_SIZE 80
+
+struct mark {
+	uint64_t offset; // the offset when the shifts were last folded in, see marks_offset.
+	char name[MARK_NAME_SIZE];
+	char comment[MARK_COMMENT_SIZE];
+};
+
+struct marks {
+	struct mark* marks; // sorted by offset.
+	uint64_t* shifts;   // Fenwick tree of the shifts, by position in `marks'.
+	unsigned int count;
+	unsigned int cap;
+};
+
+/*
+ * Creates an empty set of marks.
+ */
+struct marks* marks_create();
+
+/*
+ * Frees the marks.
+ */
+void marks_free(struct marks* m);
+
+/*
+ * Returns the current offset of mark `i'.
+ */
+uint64_t marks_offset(const struct marks* m, unsigned int i);
+
+/*
+ * Returns the index of the mark called `name', or -1.
+ */
+int marks_find(const struct marks* m, const char* name);
+
+/*
+ * Sets the mark called `name' to `offset', replacing a mark with that name.
+ * The name and the comment are truncated when too long.
+ */
+void marks_set(struct marks* m, const char* name, uint64_t offset, const char* comment);
+
+/*
+ * Removes the mark called `name'. Returns false if there is none.
+ */
+bool marks_remove(struct marks* m, const char* name);
+
+/*
+ * Adjusts the marks for `amount' bytes inserted (positive) or deleted
+ * (negative) at `offset'. The marks of deleted bytes move to `offset'.
+ */
+void marks_shift(struct marks* m, uint64_t offset, int amount);
+
+/*
+ * Reads the marks saved in `path', if it exists. Returns false if it could
+ * not be read, with errno set.
+ */
+bool marks_load(struct marks* m, const char* path);
+
+/*
+ * Saves the marks to `path', or removes it when there are none. Returns
+ * false if that failed, with errno set.
+ */
+bool marks_save(const struct marks* m, const char* path);
+
+#endif // HX_MARKS_H
@@ -0,0 +1,318 @@
+/*
+ * This file is part of hx - a hex editor for the terminal.
+ *
+ * Copyright (c) 2016 Kevin Pors. See LICENSE for details.
+ */
+
+// posix_memalign() is part of POSIX.1-2001. The Makefile defines
+// _POSIX_SOURCE, which would otherwise limit us to POSIX.1.
+#define _XOPEN_SOURCE 700
+#define _POSIX_C_SOURCE 200809L
+
+#include "mem.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * The header in front of every block. It's padded to MEM_HEADER_SIZE, so the
+ * block after it is aligned like anything malloc() returns.
+ */
+struct mem_header {
+	size_t   size;   // size of the block, without the header.
+	uint32_t kind;   // enum mem_kind.
+	uint32_t offset; // distance from what malloc() returned to the block.
+};
+
+#define MEM_HEADER_SIZE 16
+
+// Makes the build fail if the header does not fit in its padding.
+typedef char mem_header_fits[sizeof(struct mem_header) <= MEM_HEADER_SIZE ? 1 : -1];
+
+static const char* mem_names[MEM_KINDS] = {
+	[MEM_CONTENTS] = "contents",
+	[MEM_UNDO]     = "undo",
+	[MEM_INDEX]    = "indexes",
+	[MEM_CACHE]    = "caches",
+	[MEM_FRAME]    = "frames",
+	[MEM_OTHER]    = "other",
+};
+
+struct mem_counter mem_counters[MEM_KINDS];
+
+static struct mem_header* mem_header_of(void* ptr) {
+	return (struct mem_header*) ((char*) ptr - MEM_HEADER_SIZE);
+}
+
+static void mem_account(uint32_t kind, int64_t bytes, int64_t blocks, uint64_t allocations) {
+	struct mem_counter* c = &mem_counters[kind];
+	__atomic_add_fetch(&c->bytes, (uint64_t) bytes, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&c->blocks, (uint64_t) blocks, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&c->allocations, allocations, __ATOMIC_RELAXED);
+}
+
+/*
+ * Fills in the header of the block at `base' + `offset', and accounts it.
+ */
+static void* mem_init_block(void* base, size_t offset, enum mem_kind kind, size_t size) {
+	char* ptr = (char*) base + offset;
+	struct mem_header* h = mem_header_of(ptr);
+	h->size = size;
+	h->kind = kind;
+	h->offset = offset;
+	mem_account(kind, size, 1, 1);
+	return ptr;
+}
+
+const char* mem_kind_name(enum mem_kind kind) {
+	return kind < MEM_KINDS ? mem_names[kind] : "total";
+}
+
+void mem_stats(enum mem_kind kind, struct mem_counter* dst) {
+	memset(dst, 0, sizeof(struct mem_counter));
+	for (unsigned int k = 0; k < MEM_KINDS; k++) {
+		if (kind != MEM_KINDS && kind != k) {
+			continue;
+		}
+		dst->bytes += __atomic_load_n(&mem_counters[k].bytes, __ATOMIC_RELAXED);
+		dst->blocks += __atomic_load_n(&mem_counters[k].blocks, __ATOMIC_RELAXED);
+		dst->allocations += __atomic_load_n(&mem_counters[k].allocations, __ATOMIC_RELAXED);
+	}
+}
+
+void* mem_alloc(enum mem_kind kind, size_t size) {
+	if (size > SIZE_MAX - MEM_HEADER_SIZE) {
+		return NULL;
+	}
+	void* base = malloc(MEM_HEADER_SIZE + size);
+	if (base == NULL) {
+		return NULL;
+	}
+	return mem_init_block(base, MEM_HEADER_SIZE, kind, size);
+}
+
+void* mem_calloc(enum mem_kind kind, size_t count, size_t size) {
+	if (size != 0 && count > (SIZE_MAX - MEM_HEADER_SIZE) / size) {
+		return NULL;
+	}
+	// calloc() rather than malloc() and memset(), so large blocks are
+	// mapped as zero pages on demand.
+	void* base = calloc(MEM_HEADER_SIZE + count * size, 1);
+	if (base == NULL) {
+		return NULL;
+	}
+	return mem_init_block(base, MEM_HEADER_SIZE, kind, count * size);
+}
+
+void* mem_realloc(enum mem_kind kind, void* ptr, size_t size) {
+	if (ptr == NULL) {
+		return mem_alloc(kind, size);
+	}
+	if (size > SIZE_MAX - MEM_HEADER_SIZE) {
+		return NULL;
+	}
+	struct mem_header* h = mem_header_of(ptr);
+	if (h->offset != MEM_HEADER_SIZE) {
+		// An aligned block, which realloc() cannot resize in place.
+		void* copy = mem_alloc(kind, size);
+		if (copy == NULL) {
+			return NULL;
+		}
+		memcpy(copy, ptr, h->size < size ? h->size : size);
+		mem_free(ptr);
+		return copy;
+	}
+	size_t old_size = h->size;
+	uint32_t old_kind = h->kind;
+	void* base = realloc(h, MEM_HEADER_SIZE + size);
+	if (base == NULL) {
+		return NULL;
+	}
+	mem_account(old_kind, -(int64_t) old_size, -1, 0);
+	return mem_init_block(base, MEM_HEADER_SIZE, kind, size);
+}
+
+void* mem_aligned(enum mem_kind kind, size_t align, size_t size) {
+	if (align < MEM_HEADER_SIZE || size > SIZE_MAX - align) {
+		return NULL;
+	}
+	// The header goes in the last bytes of the first `align' bytes.
+	void* base = NULL;
+	if (posix_memalign(&base, align, align + size) != 0) {
+		return NULL;
+	}
+	return mem_init_block(base, align, kind, size);
+}
+
+void mem_free(void* ptr) {
+	if (ptr == NULL) {
+		return;
+	}
+	struct mem_header* h = mem_header_of(ptr);
+	mem_account(h->kind, -(int64_t) h->size, -1, 0);
+	free((char*) ptr - h->offset);
+}
+
+void mem_retag(void* ptr, enum mem_kind kind) {
+	if (ptr == NULL) {
+		return;
+	}
+	struct mem_header* h = mem_header_of(ptr);
+	mem_account(h->kind, -(int64_t) h->size, -1, 0);
+	mem_account(kind, h->size, 1, 0);
+	h->kind = kind;
+}
+
+// Objects and arena allocations are aligned like the blocks above.
+#define MEM_ALIGN 16
+
+static size_t mem_round(size_t size) {
+	return (size + MEM_ALIGN - 1) & ~(size_t) (MEM_ALIGN - 1);
+}
+
+/*
+ * A slab of a pool. The objects follow the (padded) slab header.
+ */
+struct mem_slab {
+	struct mem_slab* next;
+};
+
+void mem_pool_init(struct mem_pool* pool, enum mem_kind kind, size_t size, unsigned int per_slab) {
+	pool->kind = kind;
+	pool->size = mem_round(size < sizeof(void*) ? sizeof(void*) : size);
+	pool->per_slab = per_slab > 0 ? per_slab : 1;
+	pool->free_list = NULL;
+	pool->slabs = NULL;
+}
+
+void* mem_pool_get(struct mem_pool* pool) {
+	if (pool->free_list == NULL) {
+		size_t header = mem_round(sizeof(struct mem_slab));
+		struct mem_slab* slab = mem_alloc(pool->kind, header + pool->size * pool->per_slab);
+		if (slab == NULL) {
+			return NULL;
+		}
+		slab->next = pool->slabs;
+		pool->slabs = slab;
+
+		// Put the objects on the free list backwards, so they're handed
+		// out in address order.
+		char* objects = (char*) slab + header;
+		for (unsigned int i = pool->per_slab; i-- > 0; ) {
+			mem_pool_put(pool, objects + i * pool->size);
+		}
+	}
+	void* obj = pool->free_list;
+	pool->free_list = *(void**) obj;
+	return obj;
+}
+
+void mem_pool_put(struct mem_pool* pool, void* obj) {
+	*(void**) obj = pool->free_list;
+	pool->free_list = obj;
+}
+
+void mem_pool_release(struct mem_pool* pool) {
+	struct mem_slab* slab = pool->slabs;
+	while (slab != NULL) {
+		struct mem_slab* next = slab->next;
+		mem_free(slab);
+		slab = next;
+	}
+	pool->slabs = NULL;
+	pool->free_list = NULL;
+}
+
+/*
+ * A chunk of an arena. The allocations follow the (padded) chunk header.
+ */
+struct mem_chunk {
+	struct mem_chunk* next;
+	size_t size; // room for allocations.
+	size_t used; // bytes handed out, the last allocation ending here.
+	size_t last; // where the last allocation starts.
+};
+
+static char* mem_chunk_data(struct mem_chunk* chunk) {
+	return (char*) chunk + mem_round(sizeof(struct mem_chunk));
+}
+
+void mem_arena_init(struct mem_arena* arena, enum mem_kind kind, size_t chunk_size) {
+	arena->kind = kind;
+	arena->chunk_size = mem_round(chunk_size);
+	arena->chunks = NULL;
+	arena->peak = 0;
+}
+
+void* mem_arena_alloc(struct mem_arena* arena, size_t size) {
+	size = mem_round(size);
+	struct mem_chunk* chunk = arena->chunks;
+	if (chunk == NULL || chunk->size - chunk->used < size) {
+		size_t room = arena->chunk_size;
+		if (room < arena->peak + size) {
+			room = mem_round(arena->peak + size);
+		}
+		struct mem_chunk* c = mem_alloc(arena->kind, mem_round(sizeof(struct mem_chunk)) + room);
+		if (c == NULL) {
+			return NULL;
+		}
+		c->next = chunk;
+		c->size = room;
+		c->used = 0;
+		c->last = 0;
+		arena->chunks = chunk = c;
+	}
+	chunk->last = chunk->used;
+	chunk->used += size;
+	arena->peak += size;
+	return mem_chunk_data(chunk) + chunk->last;
+}
+
+void* mem_arena_grow(struct mem_arena* arena, void* ptr, size_t old_size, size_t size) {
+	if (ptr == NULL) {
+		return mem_arena_alloc(arena, size);
+	}
+	struct mem_chunk* chunk = arena->chunks;
+	if ((char*) ptr == mem_chunk_data(chunk) + chunk->last
+	    && chunk->size - chunk->last >= mem_round(size)) {
+		size_t used = chunk->last + mem_round(size);
+		arena->peak += used - chunk->used;
+		chunk->used = used;
+		return ptr;
+	}
+	void* copy = mem_arena_alloc(arena, size);
+	if (copy != NULL) {
+		memcpy(copy, ptr, old_size < size ? old_size : size);
+	}
+	return copy;
+}
+
+void mem_arena_reset(struct mem_arena* arena) {
+	struct mem_chunk* chunk = arena->chunks;
+	if (chunk != NULL && chunk->next == NULL) {
+		// Everything fit in this chunk, so the next round will too.
+		chunk->used = 0;
+		chunk->last = 0;
+		arena->peak = 0;
+		return;
+	}
+	// Free the chunks, but remember how much was needed, so the next
+	// chunk is large enough to hold it all.
+	size_t peak = arena->peak;
+	mem_arena_release(arena);
+	arena->peak = 0;
+	if (peak > arena->chunk_size) {
+		arena->chunk_size = mem_round(peak);
+	}
+}
+
+void mem_arena_release(struct mem_arena* arena) {
+	struct mem_chunk* chunk = arena->chunks;
+	while (chunk != NULL) {
+		struct mem_chunk* next = chunk->next;
+		mem_free(chunk);
+		chunk = next;
+	}
+	arena->chunks = NULL;
+	arena->peak = 0;
+}
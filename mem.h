@@ -0,0 +1,168 @@
+/*
+ * This file is part of hx - a hex editor for the terminal.
+ *
+ * Copyright (c) 2016 Kevin Pors. See LICENSE for details.
+ */
+
+#ifndef HX_MEM_H
+#define HX_MEM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Wrappers around the allocator which account every allocation to the part
+ * of hx it's made for, so the :stats command can tell where the memory goes
+ * without walking any data structures.
+ *
+ * Every block starts with a small header holding its size and kind, so
+ * mem_free() and mem_realloc() know what to subtract. The wrappers return
+ * NULL on failure like the functions they wrap; handling that is left to
+ * the caller.
+ */
+
+enum mem_kind {
+	MEM_CONTENTS, // the contents of the file (or the loaded window).
+	MEM_UNDO,     // the undo history.
+	MEM_INDEX,    // strings found, block fingerprints and lists of them.
+	MEM_CACHE,    // block statistics, the minimap, pages and sectors read.
+	MEM_FRAME,    // frames and other text being built (charbufs).
+	MEM_OTHER,    // everything else.
+	MEM_KINDS,    // amount of kinds.
+};
+
+struct mem_counter {
+	uint64_t bytes;       // bytes currently allocated.
+	uint64_t blocks;      // blocks currently allocated.
+	uint64_t allocations; // calls to allocate or resize, ever.
+};
+
+// The counters of every kind. They're updated atomically, since the worker
+// threads allocate as well.
+extern struct mem_counter mem_counters[MEM_KINDS];
+
+/*
+ * Returns a short name for `kind', e.g. "undo".
+ */
+const char* mem_kind_name(enum mem_kind kind);
+
+/*
+ * Copies the counters of `kind' into `dst'. When `kind' is MEM_KINDS, the
+ * sum of all kinds is copied.
+ */
+void mem_stats(enum mem_kind kind, struct mem_counter* dst);
+
+/*
+ * Like malloc(3), accounting `size' bytes to `kind'.
+ */
+void* mem_alloc(enum mem_kind kind, size_t size);
+
+/*
+ * Like calloc(3), accounting the bytes to `kind'.
+ */
+void* mem_calloc(enum mem_kind kind, size_t count, size_t size);
+
+/*
+ * Like realloc(3). When `ptr' is NULL, a new block of `kind' is allocated.
+ * Otherwise the block is resized, and accounted to `kind' from then on.
+ */
+void* mem_realloc(enum mem_kind kind, void* ptr, size_t size);
+
+/*
+ * Allocates `size' bytes aligned at `align', a power of two of at least 16.
+ * Resizing the block with mem_realloc() does not keep it aligned.
+ */
+void* mem_aligned(enum mem_kind kind, size_t align, size_t size);
+
+/*
+ * Like free(3), for a block allocated by one of the functions above.
+ */
+void mem_free(void* ptr);
+
+/*
+ * Accounts the block `ptr' to `kind' from now on, for when it changes owner.
+ */
+void mem_retag(void* ptr, enum mem_kind kind);
+
+/*
+ * A pool of objects of one size, for objects which are allocated and freed
+ * one at a time but in large numbers, like undo records. Objects are carved
+ * from slabs, and freed objects are kept on a free list for reuse. All slabs
+ * are released at once by mem_pool_release().
+ */
+struct mem_pool {
+	enum mem_kind kind;     // what the slabs are accounted to.
+	size_t size;            // size of an object, rounded up.
+	unsigned int per_slab;  // amount of objects in a slab.
+	void* free_list;        // objects available for reuse.
+	void* slabs;            // the slabs allocated, newest first.
+};
+
+/*
+ * Initializes `pool' for objects of `size' bytes, allocating room for
+ * `per_slab' of them at a time.
+ */
+void mem_pool_init(struct mem_pool* pool, enum mem_kind kind, size_t size, unsigned int per_slab);
+
+/*
+ * Returns an object from the pool, or NULL when no slab can be allocated.
+ */
+void* mem_pool_get(struct mem_pool* pool);
+
+/*
+ * Returns `obj' to the pool it came from.
+ */
+void mem_pool_put(struct mem_pool* pool, void* obj);
+
+/*
+ * Frees all objects of the pool at once, whether they were put back or not.
+ * The pool can be used again afterwards.
+ */
+void mem_pool_release(struct mem_pool* pool);
+
+/*
+ * An arena for short-lived allocations of any size, like the frame being
+ * rendered or the scratch space of a search. Allocating is bumping a pointer
+ * in a chunk, and everything is freed at once by mem_arena_reset(). When the
+ * allocations did not fit in one chunk, the next chunk is made large enough
+ * to hold all of them, so an arena reset every frame settles on one chunk
+ * and stops calling the allocator at all.
+ */
+struct mem_arena {
+	enum mem_kind kind; // what the chunks are accounted to.
+	size_t chunk_size;  // minimum size of a chunk.
+	void* chunks;       // the chunks allocated, the current one first.
+	size_t peak;        // bytes used since the last reset.
+};
+
+/*
+ * Initializes `arena', allocating chunks of at least `chunk_size' bytes
+ * when needed.
+ */
+void mem_arena_init(struct mem_arena* arena, enum mem_kind kind, size_t chunk_size);
+
+/*
+ * Allocates `size' bytes from the arena, aligned like malloc(). Returns NULL
+ * when no chunk can be allocated.
+ */
+void* mem_arena_alloc(struct mem_arena* arena, size_t size);
+
+/*
+ * Resizes the allocation `ptr' of `old_size' bytes to `size' bytes. The last
+ * allocation made is grown in place when it fits, others are copied. Returns
+ * NULL when no chunk can be allocated, leaving `ptr' as it was.
+ */
+void* mem_arena_grow(struct mem_arena* arena, void* ptr, size_t old_size, size_t size);
+
+/*
+ * Frees everything allocated from the arena. The current chunk is kept for
+ * reuse when it held everything.
+ */
+void mem_arena_reset(struct mem_arena* arena);
+
+/*
+ * Frees everything allocated from the arena, including its chunks.
+ */
+void mem_arena_release(struct mem_arena* arena);
+
+#endif // HX_MEM_H
@@ -0,0 +1,106 @@
+/*
+ * This file is part of hx - a hex editor for the terminal.
+ *
+ * Copyright (c) 2016 Kevin Pors. See LICENSE for details.
+ */
+
+#include "minimap.h"
+#include "mem.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct minimap* minimap_create() {
+	struct minimap* m = mem_alloc(MEM_CACHE, sizeof(struct minimap));
+	if (m == NULL) {
+		perror("Could not allocate memory for the minimap");
+		abort();
+	}
+	m->slice_count = 0;
+	m->block_count = 0;
+	m->slices = NULL;
+	return m;
+}
+
+void minimap_free(struct minimap* m) {
+	mem_free(m->slices);
+	mem_free(m);
+}
+
+size_t minimap_slice_start(struct minimap* m, unsigned int slice) {
+	return (uint64_t) slice * m->block_count / m->slice_count;
+}
+
+/*
+ * Returns the block after the last block of slice `slice'.
+ */
+static size_t minimap_slice_end(struct minimap* m, unsigned int slice) {
+	size_t start = minimap_slice_start(m, slice);
+	size_t end = minimap_slice_start(m, slice + 1);
+	return end > start ? end : start + 1;
+}
+
+/*
+ * Adds up the summary of slice `slice' again.
+ */
+static void minimap_sum(struct minimap* m, struct blockstat* bs, unsigned int slice) {
+	struct minimap_slice* s = &m->slices[slice];
+	memset(s->classes, 0, sizeof(s->classes));
+	s->pending = blockstat_sum(bs, minimap_slice_start(m, slice), minimap_slice_end(m, slice), s->classes);
+}
+
+bool minimap_update(struct minimap* m, struct blockstat* bs, unsigned int slices) {
+	size_t from, to;
+	bool changed = blockstat_changes(bs, &from, &to);
+
+	if (slices != m->slice_count || bs->block_count != m->block_count) {
+		// Different layout, everything has to be added up again.
+		struct minimap_slice* s = mem_realloc(MEM_CACHE, m->slices, (slices + 1) * sizeof(struct minimap_slice));
+		if (s == NULL) {
+			perror("Could not allocate memory for the minimap");
+			abort();
+		}
+		m->slices = s;
+		m->slice_count = slices;
+		m->block_count = bs->block_count;
+		for (unsigned int i = 0; i < slices; i++) {
+			minimap_sum(m, bs, i);
+		}
+		return true;
+	}
+
+	if (!changed || m->slice_count == 0) {
+		return false;
+	}
+
+	// Only the slices overlapping the changed blocks. Slices are ordered,
+	// so a binary search finds the first one.
+	unsigned int lo = 0;
+	unsigned int hi = m->slice_count;
+	while (lo < hi) {
+		unsigned int mid = lo + (hi - lo) / 2;
+		if (minimap_slice_end(m, mid) <= from) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	for (unsigned int i = lo; i < m->slice_count && minimap_slice_start(m, i) < to; i++) {
+		minimap_sum(m, bs, i);
+	}
+	return true;
+}
+
+int minimap_dominant(struct minimap* m, unsigned int slice) {
+	const struct minimap_slice* s = &m->slices[slice];
+	int best = -1;
+	uint64_t most = 0;
+	for (int c = 0; c < BLOCKSTAT_CLASSES; c++) {
+		if (s->classes[c] > most) {
+			most = s->classes[c];
+			best = c;
+		}
+	}
+	return best;
+}
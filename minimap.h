@@ -0,0 +1,61 @@
+/*
+ * This file is part of hx - a hex editor for the terminal.
+ *
+ * Copyright (c) 2016 Kevin Pors. See LICENSE for details.
+ */
+
+#ifndef HX_MINIMAP_H
+#define HX_MINIMAP_H
+
+#include "blockstat.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * An overview of the whole buffer in a fixed amount of slices (one per
+ * screen row), summarizing which kinds of bytes are in every slice. The
+ * summaries are added up from the per-block statistics of a blockstat, and
+ * only the slices overlapping changed blocks are added up again.
+ */
+
+struct minimap_slice {
+	uint64_t classes[BLOCKSTAT_CLASSES]; // amount of bytes in every class.
+	size_t   pending;                    // blocks not computed yet.
+};
+
+struct minimap {
+	unsigned int          slice_count; // amount of slices.
+	size_t                block_count; // amount of blocks the slices span.
+	struct minimap_slice* slices;      // the summary of every slice.
+};
+
+/*
+ * Creates an empty minimap.
+ */
+struct minimap* minimap_create();
+
+/*
+ * Frees the minimap.
+ */
+void minimap_free(struct minimap* m);
+
+/*
+ * Updates the summaries of the slices from the statistics in `bs', divided
+ * in `slices' slices. Returns true if anything changed.
+ */
+bool minimap_update(struct minimap* m, struct blockstat* bs, unsigned int slices);
+
+/*
+ * Returns the first block of slice `slice'. The slice ends where the next
+ * one starts (a slice spans at least one block, though).
+ */
+size_t minimap_slice_start(struct minimap* m, unsigned int slice);
+
+/*
+ * Returns the byte class most bytes of the slice belong to, or -1 if the
+ * slice is not computed yet.
+ */
+int minimap_dominant(struct minimap* m, unsigned int slice);
+
+#endif // HX_MINIMAP_H
@@ -0,0 +1,71 @@
+/*
+ * This file is part of hx - a hex editor for the terminal.
+ *
+ * Copyright (c) 2016 Kevin Pors. See LICENSE for details.
+ */
+
+// clock_gettime() is part of POSIX.1-2008. The Makefile defines
+// _POSIX_SOURCE, which would otherwise limit us to POSIX.1.
+#define _XOPEN_SOURCE 700
+#define _POSIX_C_SOURCE 200809L
+
+#include "perf.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+bool perf_enabled = false;
+uint64_t perf_counters[PERF_COUNTERS];
+struct perf_stats perf_stats;
+
+void perf_enable(bool enable) {
+	memset(perf_counters, 0, sizeof(perf_counters));
+	memset(&perf_stats, 0, sizeof(perf_stats));
+	perf_enabled = enable;
+}
+
+uint64_t perf_now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void perf_key_read() {
+	if (perf_enabled) {
+		// Only the read which returned the key. Reads which timed out
+		// while waiting for it are not part of processing it.
+		perf_counters[PERF_SYSCALLS] = 1;
+	}
+}
+
+void perf_frame(uint64_t start, uint64_t bytes) {
+	perf_stats.frame_us = perf_now() - start;
+	perf_stats.frame_bytes = bytes;
+	// The frame is drawn with a single write.
+	perf_stats.key_syscalls = perf_counters[PERF_SYSCALLS] + 1;
+}
+
+uint64_t perf_rss() {
+#ifdef __linux__
+	// The second field of statm is the amount of resident pages.
+	FILE* fp = fopen("/proc/self/statm", "r");
+	if (fp != NULL) {
+		unsigned long size = 0;
+		unsigned long resident = 0;
+		int n = fscanf(fp, "%lu %lu", &size, &resident);
+		fclose(fp);
+		if (n == 2) {
+			return (uint64_t) resident * sysconf(_SC_PAGESIZE);
+		}
+	}
+#endif
+	// Elsewhere, settle for the peak resident set size (in KiB).
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) == 0) {
+		return (uint64_t) usage.ru_maxrss * 1024;
+	}
+	return 0;
+}
@@ -0,0 +1,80 @@
+/*
+ * This file is part of hx - a hex editor for the terminal.
+ *
+ * Copyright (c) 2016 Kevin Pors. See LICENSE for details.
+ */
+
+#ifndef HX_PERF_H
+#define HX_PERF_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Performance counters shown by the :perf overlay. The instrumentation points
+ * in the hot paths only test perf_enabled while the overlay is hidden: the
+ * counters are not touched and the clock is not read.
+ *
+ * Syscalls are only counted where they are instrumented: reading keys,
+ * drawing the screen and reading (or writing) file, device and process
+ * contents.
+ */
+
+enum perf_counter {
+	PERF_SYSCALLS,     // syscalls since the last key was read.
+	PERF_CACHE_HITS,   // lookups answered from a cache.
+	PERF_CACHE_MISSES, // lookups which had to compute or read again.
+	PERF_COUNTERS,     // amount of counters.
+};
+
+// Whether the counters are maintained, i.e. the overlay is shown.
+extern bool perf_enabled;
+
+extern uint64_t perf_counters[PERF_COUNTERS];
+
+#define PERF_COUNT(counter, n) do { \
+	if (perf_enabled) { \
+		perf_counters[(counter)] += (n); \
+	} \
+} while (0)
+
+/*
+ * Measurements of the last frame, key and search.
+ */
+struct perf_stats {
+	uint64_t frame_us;     // time to render the last frame.
+	uint64_t frame_bytes;  // bytes drawn for the last frame.
+	uint64_t key_syscalls; // syscalls to process the last key and draw its frame.
+	uint64_t search_bytes; // bytes compared by the last search.
+	uint64_t search_us;    // time taken by the last search.
+};
+
+extern struct perf_stats perf_stats;
+
+/*
+ * Enables or disables the counters. Enabling resets them.
+ */
+void perf_enable(bool enable);
+
+/*
+ * Returns the time of the monotonic clock in microseconds.
+ */
+uint64_t perf_now();
+
+/*
+ * Marks that a key was read: the syscalls from here on are accounted to it.
+ */
+void perf_key_read();
+
+/*
+ * Records a frame which started rendering at `start' (see perf_now()) and
+ * consists of `bytes' bytes.
+ */
+void perf_frame(uint64_t start, uint64_t bytes);
+
+/*
+ * Returns the resident set size of the process in bytes, or 0 if unknown.
+ */
+uint64_t perf_rss();
+
+#endif // HX_PERF_H
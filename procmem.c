@@ -0,0 +1,250 @@
+/*
+ * This file is part of hx - a hex editor for the terminal.
+ *
+ * Copyright (c) 2016 Kevin Pors. See LICENSE for details.
+ */
+
+// pread(), pwrite() and clock_gettime() are part of POSIX.1-2008. The
+// Makefile defines _POSIX_SOURCE, which would otherwise limit us to POSIX.1.
+#define _XOPEN_SOURCE 700
+#define _POSIX_C_SOURCE 200809L
+
+#include "procmem.h"
+#include "mem.h"
+#include "perf.h"
+#include "trace.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * Returns the current time of the monotonic clock in milliseconds.
+ */
+static uint64_t now_ms() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/*
+ * Parses /proc/PID/maps into the regions array of `pm'. The kernel lists the
+ * regions sorted by address already, so no sorting is needed.
+ */
+static bool procmem_read_maps(struct procmem* pm) {
+	char path[64];
+	snprintf(path, sizeof(path), "/proc/%d/maps", pm->pid);
+	FILE* fp = fopen(path, "r");
+	if (fp == NULL) {
+		return false;
+	}
+
+	unsigned int cap = 0;
+	char line[512];
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		struct procmem_region r;
+		int name_start = 0;
+		// Format: start-end perms offset dev inode [name]
+		if (sscanf(line, "%" SCNx64 "-%" SCNx64 " %4s %*s %*s %*s %n",
+		           &r.start, &r.end, r.perms, &name_start) < 3) {
+			continue;
+		}
+		// Regions which are not readable cannot be displayed anyway.
+		if (r.perms[0] != 'r' || r.end <= r.start) {
+			continue;
+		}
+
+		r.name[0] = '\0';
+		if (name_start > 0) {
+			snprintf(r.name, sizeof(r.name), "%s", line + name_start);
+			r.name[strcspn(r.name, "\n")] = '\0';
+		}
+
+		if (pm->region_count == cap) {
+			cap = cap == 0 ? 64 : cap * 2;
+			pm->regions = mem_realloc(MEM_OTHER, pm->regions, cap * sizeof(struct procmem_region));
+			if (pm->regions == NULL) {
+				perror("Could not allocate memory for the memory map");
+				abort();
+			}
+		}
+		pm->regions[pm->region_count++] = r;
+	}
+
+	fclose(fp);
+	return true;
+}
+
+struct procmem* procmem_open(int pid) {
+	struct procmem* pm = mem_alloc(MEM_OTHER, sizeof(struct procmem));
+	if (pm == NULL) {
+		perror("Could not allocate memory for procmem");
+		abort();
+	}
+	pm->pid = pid;
+	pm->regions = NULL;
+	pm->region_count = 0;
+	pm->page_size = sysconf(_SC_PAGESIZE);
+	pm->window_start = 0;
+	pm->window_len = 0;
+	pm->page_stamps = NULL;
+
+	char path[64];
+	snprintf(path, sizeof(path), "/proc/%d/mem", pid);
+	pm->writable = true;
+	pm->fd = open(path, O_RDWR);
+	if (pm->fd == -1) {
+		// Reading may still be allowed.
+		pm->writable = false;
+		pm->fd = open(path, O_RDONLY);
+	}
+
+	if (pm->fd == -1 || !procmem_read_maps(pm)) {
+		int err = errno;
+		procmem_free(pm);
+		errno = err;
+		return NULL;
+	}
+
+	return pm;
+}
+
+void procmem_free(struct procmem* pm) {
+	if (pm->fd != -1) {
+		close(pm->fd);
+	}
+	mem_free(pm->regions);
+	mem_free(pm->page_stamps);
+	mem_free(pm);
+}
+
+const struct procmem_region* procmem_region_at(struct procmem* pm, uint64_t addr, int dir) {
+	if (pm->region_count == 0) {
+		return NULL;
+	}
+
+	// Binary search for the first region ending after addr.
+	unsigned int lo = 0;
+	unsigned int hi = pm->region_count;
+	while (lo < hi) {
+		unsigned int mid = lo + (hi - lo) / 2;
+		if (pm->regions[mid].end <= addr) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	if (lo < pm->region_count && pm->regions[lo].start <= addr) {
+		// addr is mapped by this region.
+		return &pm->regions[lo];
+	}
+
+	// addr is in a gap between regions lo - 1 and lo.
+	if (dir < 0 && lo > 0) {
+		return &pm->regions[lo - 1];
+	}
+	if (lo < pm->region_count) {
+		return &pm->regions[lo];
+	}
+	return &pm->regions[pm->region_count - 1];
+}
+
+/*
+ * Reads one page (or less) of the window. When the page cannot be read, it
+ * is filled with zeroes. Returns true if the page was readable.
+ */
+static bool procmem_read_page(struct procmem* pm, char* dst, unsigned int offset, unsigned int len) {
+	unsigned int total = 0;
+	while (total < len) {
+		ssize_t n = pread(pm->fd, dst + offset + total, len - total, pm->window_start + offset + total);
+		PERF_COUNT(PERF_SYSCALLS, 1);
+		if (n == -1 && errno == EINTR) {
+			continue;
+		}
+		if (n <= 0) {
+			memset(dst + offset + total, 0, len - total);
+			return false;
+		}
+		total += n;
+	}
+	return true;
+}
+
+unsigned int procmem_load(struct procmem* pm, uint64_t start, char* dst, unsigned int len) {
+	unsigned int pages = (len + pm->page_size - 1) / pm->page_size;
+	uint64_t* stamps = mem_realloc(MEM_CACHE, pm->page_stamps, (pages + 1) * sizeof(uint64_t));
+	if (stamps == NULL) {
+		perror("Could not allocate memory for page stamps");
+		abort();
+	}
+	pm->page_stamps = stamps;
+	pm->window_start = start;
+	pm->window_len = len;
+
+	// Read page by page, so a single unreadable page does not prevent the
+	// rest of the window from being read.
+	uint64_t now = now_ms();
+	unsigned int readable = 0;
+	for (unsigned int i = 0; i < pages; i++) {
+		unsigned int offset = i * pm->page_size;
+		unsigned int n = len - offset < pm->page_size ? len - offset : pm->page_size;
+		if (procmem_read_page(pm, dst, offset, n)) {
+			readable += n;
+		}
+		pm->page_stamps[i] = now;
+	}
+	return readable;
+}
+
+bool procmem_refresh(struct procmem* pm, char* dst, unsigned int from, unsigned int to) {
+	if (to > pm->window_len) {
+		to = pm->window_len;
+	}
+	if (from >= to) {
+		return false;
+	}
+
+	uint64_t now = now_ms();
+	bool refreshed = false;
+	for (unsigned int i = from / pm->page_size; i <= (to - 1) / pm->page_size; i++) {
+		if (now - pm->page_stamps[i] < PROCMEM_TTL_MS) {
+			PERF_COUNT(PERF_CACHE_HITS, 1);
+			continue;
+		}
+		PERF_COUNT(PERF_CACHE_MISSES, 1);
+		unsigned int offset = i * pm->page_size;
+		unsigned int n = pm->window_len - offset < pm->page_size ? pm->window_len - offset : pm->page_size;
+		TRACE_BEGIN(TRACE_PAGE);
+		procmem_read_page(pm, dst, offset, n);
+		TRACE_END(TRACE_PAGE);
+		pm->page_stamps[i] = now;
+		refreshed = true;
+	}
+	return refreshed;
+}
+
+bool procmem_write(struct procmem* pm, uint64_t addr, const char* src, unsigned int len) {
+	if (!pm->writable) {
+		errno = EACCES;
+		return false;
+	}
+	unsigned int total = 0;
+	while (total < len) {
+		ssize_t n = pwrite(pm->fd, src + total, len - total, addr + total);
+		PERF_COUNT(PERF_SYSCALLS, 1);
+		if (n == -1 && errno == EINTR) {
+			continue;
+		}
+		if (n <= 0) {
+			return false;
+		}
+		total += n;
+	}
+	return true;
+}
@@ -0,0 +1,90 @@
+/*
+ * This file is part of hx - a hex editor for the terminal.
+ *
+ * Copyright (c) 2016 Kevin Pors. See LICENSE for details.
+ */
+
+#ifndef HX_PROCMEM_H
+#define HX_PROCMEM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Access to the memory of a running process, through /proc/PID/maps and
+ * /proc/PID/mem. The address space of a process is sparse: only the mapped
+ * regions listed in the maps file can be read. These regions are kept in an
+ * array sorted by address, so lookups can be done with a binary search.
+ *
+ * The memory of a process changes while we are looking at it. Therefore
+ * every page of the currently loaded window is timestamped when read, and
+ * pages older than PROCMEM_TTL_MS are read again when they are displayed.
+ */
+
+// Time in milliseconds a page read from the process is considered fresh.
+#define PROCMEM_TTL_MS 500
+
+/*
+ * One mapped region of the address space of a process.
+ */
+struct procmem_region {
+	uint64_t start;    // first address of the region.
+	uint64_t end;      // first address after the region.
+	char     perms[5]; // permissions, e.g. "r-xp".
+	char     name[64]; // mapped file or pseudo name like [heap], may be empty.
+};
+
+struct procmem {
+	int  pid;      // the process id.
+	int  fd;       // file descriptor of /proc/PID/mem.
+	bool writable; // whether fd was opened for writing as well.
+
+	struct procmem_region* regions; // mapped regions, sorted by address.
+	unsigned int region_count;      // amount of regions.
+
+	unsigned int page_size;    // size of a page (see sysconf(3)).
+	uint64_t  window_start;    // address of the window loaded by procmem_load.
+	unsigned int window_len;   // length of that window.
+	uint64_t* page_stamps;     // time (ms) every page in the window was read.
+};
+
+/*
+ * Opens the memory of the process `pid', and reads its memory map. Returns
+ * NULL when that fails, with errno set accordingly.
+ */
+struct procmem* procmem_open(int pid);
+
+/*
+ * Closes the process memory and frees the procmem struct.
+ */
+void procmem_free(struct procmem* pm);
+
+/*
+ * Finds the region containing `addr'. When `addr' is not mapped, the nearest
+ * region after it is returned when `dir' >= 0, or the nearest region before
+ * it when `dir' < 0. If there is no such region either, the nearest region
+ * in the other direction is returned. Returns NULL only if nothing is mapped.
+ */
+const struct procmem_region* procmem_region_at(struct procmem* pm, uint64_t addr, int dir);
+
+/*
+ * Loads `len' bytes at address `start' into `dst', which becomes the window
+ * tracked for procmem_refresh(). Pages which cannot be read (guard pages and
+ * the like) are filled with zeroes. Returns the amount of readable bytes.
+ */
+unsigned int procmem_load(struct procmem* pm, uint64_t start, char* dst, unsigned int len);
+
+/*
+ * Reads the pages overlapping [from, to) of the loaded window `dst' again,
+ * when they are older than PROCMEM_TTL_MS. Returns true if anything was
+ * read.
+ */
+bool procmem_refresh(struct procmem* pm, char* dst, unsigned int from, unsigned int to);
+
+/*
+ * Writes `len' bytes from `src' to address `addr' of the process. Returns
+ * false if that failed, with errno set.
+ */
+bool procmem_write(struct procmem* pm, uint64_t addr, const char* src, unsigned int len);
+
+#endif // HX_PROCMEM_H
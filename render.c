@@ -0,0 +1,243 @@
+/*
+ * This file is part of hx - a hex editor for the terminal.
+ *
+ * Copyright (c) 2016 Kevin Pors. See LICENSE for details.
+ */
+
+#include "render.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+// The SIMD encoders are compiled for their instruction set with the target
+// attribute, and only called when the CPU supports it.
+#if !defined(HX_NO_SIMD) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define RENDER_X86_SIMD
+#include <immintrin.h>
+#endif
+
+static const char hex_digits[] = "0123456789abcdef";
+
+// Like isprint() in the C locale, which hx runs in.
+#define RENDER_PRINTABLE(c) ((c) >= 0x20 && (c) < 0x7f)
+
+/*
+ * Appends `s', a string literal, to `dst' and advances it.
+ */
+#define RENDER_PUT(dst, s) do { \
+	memcpy((dst), (s), sizeof(s) - 1); \
+	(dst) += sizeof(s) - 1; \
+} while (0)
+
+/*
+ * Encodes bytes `from' up to `n' of `p', see render_encode().
+ */
+typedef void (*render_encode_fn)(const unsigned char* p, size_t from, size_t n,
+                                 char* hex, char* ascii, uint64_t* printable);
+
+static void render_encode_scalar(const unsigned char* p, size_t from, size_t n,
+                                 char* hex, char* ascii, uint64_t* printable) {
+	for (size_t i = from; i < n; i++) {
+		bool pr = RENDER_PRINTABLE(p[i]);
+		hex[2 * i] = hex_digits[p[i] >> 4];
+		hex[2 * i + 1] = hex_digits[p[i] & 0xf];
+		ascii[i] = pr ? p[i] : '.';
+		printable[i / 64] |= (uint64_t) pr << (i % 64);
+	}
+}
+
+#ifdef RENDER_X86_SIMD
+/*
+ * Encodes 16 bytes at a time: the nibbles of every byte index a table of the
+ * hex digits with pshufb, and interleaving the results yields the digits in
+ * order. Signed compares tell the printable bytes, since the bytes from 0x80
+ * are negative.
+ */
+__attribute__((target("ssse3")))
+static void render_encode_ssse3(const unsigned char* p, size_t from, size_t n,
+                                char* hex, char* ascii, uint64_t* printable) {
+	const __m128i digits = _mm_loadu_si128((const __m128i*) hex_digits);
+	const __m128i nibble = _mm_set1_epi8(0x0f);
+	const __m128i space = _mm_set1_epi8(0x1f);
+	const __m128i del = _mm_set1_epi8(0x7f);
+	const __m128i dot = _mm_set1_epi8('.');
+
+	size_t i = from;
+	for (; i + 16 <= n; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i*) (p + i));
+		__m128i hi = _mm_shuffle_epi8(digits, _mm_and_si128(_mm_srli_epi16(v, 4), nibble));
+		__m128i lo = _mm_shuffle_epi8(digits, _mm_and_si128(v, nibble));
+		_mm_storeu_si128((__m128i*) (hex + 2 * i), _mm_unpacklo_epi8(hi, lo));
+		_mm_storeu_si128((__m128i*) (hex + 2 * i + 16), _mm_unpackhi_epi8(hi, lo));
+
+		__m128i pr = _mm_and_si128(_mm_cmpgt_epi8(v, space), _mm_cmplt_epi8(v, del));
+		_mm_storeu_si128((__m128i*) (ascii + i), _mm_or_si128(_mm_and_si128(pr, v), _mm_andnot_si128(pr, dot)));
+		printable[i / 64] |= (uint64_t) (uint32_t) _mm_movemask_epi8(pr) << (i % 64);
+	}
+	render_encode_scalar(p, i, n, hex, ascii, printable);
+}
+
+/*
+ * Like render_encode_ssse3(), 32 bytes at a time. The AVX2 shuffles and
+ * interleaves work within the 128-bit lanes, so the two halves of the digits
+ * are put in order with a permute.
+ */
+__attribute__((target("avx2")))
+static void render_encode_avx2(const unsigned char* p, size_t from, size_t n,
+                               char* hex, char* ascii, uint64_t* printable) {
+	const __m256i digits = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*) hex_digits));
+	const __m256i nibble = _mm256_set1_epi8(0x0f);
+	const __m256i space = _mm256_set1_epi8(0x1f);
+	const __m256i del = _mm256_set1_epi8(0x7f);
+	const __m256i dot = _mm256_set1_epi8('.');
+
+	size_t i = from;
+	for (; i + 32 <= n; i += 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i*) (p + i));
+		__m256i hi = _mm256_shuffle_epi8(digits, _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble));
+		__m256i lo = _mm256_shuffle_epi8(digits, _mm256_and_si256(v, nibble));
+		__m256i first = _mm256_unpacklo_epi8(hi, lo);
+		__m256i second = _mm256_unpackhi_epi8(hi, lo);
+		_mm256_storeu_si256((__m256i*) (hex + 2 * i), _mm256_permute2x128_si256(first, second, 0x20));
+		_mm256_storeu_si256((__m256i*) (hex + 2 * i + 32), _mm256_permute2x128_si256(first, second, 0x31));
+
+		__m256i pr = _mm256_and_si256(_mm256_cmpgt_epi8(v, space), _mm256_cmpgt_epi8(del, v));
+		_mm256_storeu_si256((__m256i*) (ascii + i), _mm256_blendv_epi8(dot, v, pr));
+		printable[i / 64] |= (uint64_t) (uint32_t) _mm256_movemask_epi8(pr) << (i % 64);
+	}
+	render_encode_ssse3(p, i, n, hex, ascii, printable);
+}
+#endif
+
+static render_encode_fn encode_fn = NULL;
+static const char* encode_name = NULL;
+
+/*
+ * Picks the fastest encoder the CPU supports.
+ */
+static void render_select_encoder() {
+	encode_fn = render_encode_scalar;
+	encode_name = "scalar";
+#ifdef RENDER_X86_SIMD
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		encode_fn = render_encode_avx2;
+		encode_name = "avx2";
+	} else if (__builtin_cpu_supports("ssse3")) {
+		encode_fn = render_encode_ssse3;
+		encode_name = "ssse3";
+	}
+#endif
+}
+
+void render_encode(const unsigned char* p, size_t n, char* hex, char* ascii, uint64_t* printable) {
+	if (encode_fn == NULL) {
+		render_select_encoder();
+	}
+	memset(printable, 0, (n + 63) / 64 * sizeof(uint64_t));
+	encode_fn(p, 0, n, hex, ascii, printable);
+}
+
+const char* render_encoder() {
+	if (encode_fn == NULL) {
+		render_select_encoder();
+	}
+	return encode_name;
+}
+
+/*
+ * Writes the address like "%09" PRIx64 does.
+ */
+static char* render_address(uint64_t address, char* dst) {
+	int digits = 9;
+	while (digits < 16 && (address >> (digits * 4)) != 0) {
+		digits++;
+	}
+	for (int i = digits - 1; i >= 0; i--) {
+		*dst++ = hex_digits[(address >> (i * 4)) & 0xf];
+	}
+	return dst;
+}
+
+/*
+ * The body of every kernel. It's only called with constant `octets' and
+ * `grouping', so the compiler folds them into the code of every kernel.
+ */
+static inline size_t render_row(uint64_t address, const unsigned char* p, unsigned int cursor,
+                                char* dst, const unsigned int octets, const unsigned int grouping) {
+	char* start = dst;
+	char hex[2 * RENDER_KERNEL_MAX_OCTETS];
+	char ascii[RENDER_KERNEL_MAX_OCTETS];
+	uint64_t printable[(RENDER_KERNEL_MAX_OCTETS + 63) / 64];
+	render_encode(p, octets, hex, ascii, printable);
+
+	RENDER_PUT(dst, "\x1b[1;35m");
+	dst = render_address(address, dst);
+	RENDER_PUT(dst, "\x1b[0m:");
+
+	for (unsigned int i = 0; i < octets; i++) {
+		unsigned int pr = (printable[i / 64] >> (i % 64)) & 1;
+		if (i % grouping == 0) {
+			*dst++ = ' ';
+		}
+		if (i + 1 == cursor) {
+			RENDER_PUT(dst, "\x1b[7m");
+		}
+		// Printable bytes are colored: keep the color only for those.
+		memcpy(dst, "\x1b[1;34m", 7);
+		dst += 7 * pr;
+		dst[0] = hex[2 * i];
+		dst[1] = hex[2 * i + 1];
+		dst += 2;
+		RENDER_PUT(dst, "\x1b[0m");
+	}
+	RENDER_PUT(dst, "  ");
+
+	for (unsigned int i = 0; i < octets; i++) {
+		unsigned int pr = (printable[i / 64] >> (i % 64)) & 1;
+		memcpy(dst, i + 1 == cursor ? "\x1b[7m" : "\x1b[0m", 4);
+		// Yellow for printable bytes, cyan for the dots.
+		memcpy(dst + 4, "\x1b[3", 3);
+		dst[7] = "63"[pr];
+		dst[8] = 'm';
+		dst[9] = ascii[i];
+		dst += 10;
+	}
+	RENDER_PUT(dst, "\x1b[0m\x1b[K");
+
+	return dst - start;
+}
+
+/*
+ * Defines the kernel render_row_O_G for O octets per line grouped by G.
+ */
+#define RENDER_KERNEL(octets, grouping) \
+	static size_t render_row_##octets##_##grouping(uint64_t address, const unsigned char* p, \
+	                                               unsigned int cursor, char* dst) { \
+		return render_row(address, p, cursor, dst, octets, grouping); \
+	}
+
+RENDER_KERNEL(16, 2)
+RENDER_KERNEL(16, 4)
+RENDER_KERNEL(32, 4)
+RENDER_KERNEL(32, 8)
+
+static const struct {
+	unsigned int octets;
+	unsigned int grouping;
+	render_row_fn kernel;
+} render_kernels[] = {
+	{ 16, 2, render_row_16_2 },
+	{ 16, 4, render_row_16_4 },
+	{ 32, 4, render_row_32_4 },
+	{ 32, 8, render_row_32_8 },
+};
+
+render_row_fn render_kernel(unsigned int octets, unsigned int grouping) {
+	for (size_t i = 0; i < sizeof(render_kernels) / sizeof(render_kernels[0]); i++) {
+		if (render_kernels[i].octets == octets && render_kernels[i].grouping == grouping) {
+			return render_kernels[i].kernel;
+		}
+	}
+	return NULL;
+}
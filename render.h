@@ -0,0 +1,58 @@
+/*
+ * This file is part of hx - a hex editor for the terminal.
+ *
+ * Copyright (c) 2016 Kevin Pors. See LICENSE for details.
+ */
+
+#ifndef HX_RENDER_H
+#define HX_RENDER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Row kernels: functions rendering one full row of the contents (address,
+ * hex and ASCII columns) into a buffer, exactly like the generic loop in
+ * editor_render_contents() does. The kernels are generated for the common
+ * layouts, with the amount of octets and the grouping known at compile time,
+ * so the divisions disappear and the loops over a row can be unrolled.
+ */
+
+// The largest amount of octets per line there is a kernel for.
+#define RENDER_KERNEL_MAX_OCTETS 32
+
+// Bytes a kernel may write for a row of `octets' bytes: the address, and
+// at most 18 bytes for a hex cell and 10 for an ASCII cell.
+#define RENDER_ROW_SIZE(octets) (48 + (octets) * 28)
+
+/*
+ * Renders the row of `octets' bytes at `p' (see render_kernel()), starting
+ * at `address' in the file, into `dst'. `cursor' is the column of the cursor
+ * on the row (counting from 1), or 0 if it's not on this row. Returns the
+ * amount of bytes written, which is at most RENDER_ROW_SIZE(octets).
+ */
+typedef size_t (*render_row_fn)(uint64_t address, const unsigned char* p, unsigned int cursor, char* dst);
+
+/*
+ * Returns the kernel for rows of `octets' bytes grouped by `grouping', or
+ * NULL when there is none for that layout.
+ */
+render_row_fn render_kernel(unsigned int octets, unsigned int grouping);
+
+/*
+ * Encodes `n' bytes at `p' for display: the two hex digits of every byte go
+ * to `hex' (2 * n bytes), the byte itself or a dot when it's not printable
+ * to `ascii' (n bytes), and whether it's printable to bit i % 64 of word
+ * i / 64 of `printable'. A whole row is encoded with a few SSSE3 or AVX2
+ * shuffles when the CPU has those, with results identical to the scalar
+ * code used otherwise (or when compiled with -DHX_NO_SIMD).
+ */
+void render_encode(const unsigned char* p, size_t n, char* hex, char* ascii, uint64_t* printable);
+
+/*
+ * Returns the name of the encoder render_encode() uses: "avx2", "ssse3" or
+ * "scalar".
+ */
+const char* render_encoder();
+
+#endif // HX_RENDER_H
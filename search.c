@@ -0,0 +1,195 @@
+/*
+ * This file is part of hx - a hex editor for the terminal.
+ *
+ * Copyright (c) 2016 Kevin Pors. See LICENSE for details.
+ */
+
+#include "search.h"
+
+#include <limits.h>
+#include <stdint.h>
+#include <string.h>
+
+// Like the encoders in render.c, the gather is compiled for AVX2 with the
+// target attribute, and only called when the CPU supports it.
+#if !defined(HX_NO_SIMD) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SEARCH_X86_SIMD
+#include <immintrin.h>
+#endif
+
+typedef size_t (*search_fn)(const unsigned char* p, size_t len, size_t from, size_t stride,
+                            const unsigned char* pattern, size_t n);
+
+static size_t search_strided_scalar(const unsigned char* p, size_t len, size_t from, size_t stride,
+                                    const unsigned char* pattern, size_t n) {
+	size_t at = from;
+	while (at < len && len - at >= n) {
+		if (memcmp(p + at, pattern, n) == 0) {
+			return at;
+		}
+		if (len - at <= stride) {
+			break;
+		}
+		at += stride;
+	}
+	return len;
+}
+
+static size_t search_strided_back_scalar(const unsigned char* p, size_t len, size_t from, size_t stride,
+                                         const unsigned char* pattern, size_t n) {
+	size_t at = from;
+	for (;;) {
+		if (at < len && len - at >= n && memcmp(p + at, pattern, n) == 0) {
+			return at;
+		}
+		if (at < stride) {
+			return len;
+		}
+		at -= stride;
+	}
+}
+
+#ifdef SEARCH_X86_SIMD
+/*
+ * Broadcasts the first (up to) four bytes of the pattern, and a mask of
+ * those bytes. Comparing the masked gathered words with the prefix tells
+ * which offsets may match.
+ */
+__attribute__((target("avx2")))
+static void search_prefix(const unsigned char* pattern, size_t n, __m256i* prefix, __m256i* mask) {
+	uint32_t word = 0;
+	uint32_t bytes = 0;
+	size_t k = n < 4 ? n : 4;
+	memcpy(&word, pattern, k);
+	memset(&bytes, 0xff, k);
+	*prefix = _mm256_set1_epi32((int) word);
+	*mask = _mm256_set1_epi32((int) bytes);
+}
+
+/*
+ * Gathers the words at eight offsets `stride' apart from `p', and returns a
+ * bit for every one of them which starts like the pattern.
+ */
+__attribute__((target("avx2")))
+static unsigned int search_gather(const unsigned char* p, __m256i index, __m256i prefix, __m256i mask) {
+	__m256i v = _mm256_i32gather_epi32((const int*) p, index, 1);
+	__m256i eq = _mm256_cmpeq_epi32(_mm256_and_si256(v, mask), prefix);
+	return _mm256_movemask_ps(_mm256_castsi256_ps(eq));
+}
+
+__attribute__((target("avx2")))
+static size_t search_strided_avx2(const unsigned char* p, size_t len, size_t from, size_t stride,
+                                  const unsigned char* pattern, size_t n) {
+	__m256i prefix;
+	__m256i mask;
+	search_prefix(pattern, n, &prefix, &mask);
+	__m256i index = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+	                                   _mm256_set1_epi32((int) stride));
+
+	size_t at = from;
+	// All four bytes of the last of the eight words must be there.
+	while (at < len && len - at >= 7 * stride + 4) {
+		unsigned int bits = search_gather(p + at, index, prefix, mask);
+		while (bits != 0) {
+			size_t candidate = at + __builtin_ctz(bits) * stride;
+			if (len - candidate >= n && memcmp(p + candidate, pattern, n) == 0) {
+				return candidate;
+			}
+			bits &= bits - 1;
+		}
+		at += 8 * stride;
+	}
+	return search_strided_scalar(p, len, at, stride, pattern, n);
+}
+
+__attribute__((target("avx2")))
+static size_t search_strided_back_avx2(const unsigned char* p, size_t len, size_t from, size_t stride,
+                                       const unsigned char* pattern, size_t n) {
+	__m256i prefix;
+	__m256i mask;
+	search_prefix(pattern, n, &prefix, &mask);
+	__m256i index = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+	                                   _mm256_set1_epi32((int) stride));
+
+	size_t at = from;
+	// Right at the end there are less than four bytes to gather.
+	while (at < len && len - at < 4) {
+		if (len - at >= n && memcmp(p + at, pattern, n) == 0) {
+			return at;
+		}
+		if (at < stride) {
+			return len;
+		}
+		at -= stride;
+	}
+
+	while (at < len && at >= 7 * stride) {
+		size_t base = at - 7 * stride;
+		unsigned int bits = search_gather(p + base, index, prefix, mask);
+		while (bits != 0) {
+			unsigned int i = 31 - __builtin_clz(bits);
+			size_t candidate = base + i * stride;
+			if (len - candidate >= n && memcmp(p + candidate, pattern, n) == 0) {
+				return candidate;
+			}
+			bits &= ~(1u << i);
+		}
+		if (base < stride) {
+			return len;
+		}
+		at = base - stride;
+	}
+	return search_strided_back_scalar(p, len, at, stride, pattern, n);
+}
+#endif
+
+static search_fn forward_fn = NULL;
+static search_fn back_fn = NULL;
+static const char* search_name = NULL;
+
+/*
+ * Picks the fastest implementation the CPU supports.
+ */
+static void search_select() {
+	forward_fn = search_strided_scalar;
+	back_fn = search_strided_back_scalar;
+	search_name = "scalar";
+#ifdef SEARCH_X86_SIMD
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		forward_fn = search_strided_avx2;
+		back_fn = search_strided_back_avx2;
+		search_name = "avx2";
+	}
+#endif
+}
+
+size_t search_strided(const unsigned char* p, size_t len, size_t from, size_t stride,
+                      const unsigned char* pattern, size_t n) {
+	if (forward_fn == NULL) {
+		search_select();
+	}
+	// The offsets of eight records must fit the 32 bit indices of a gather.
+	if (stride > INT_MAX / 8) {
+		return search_strided_scalar(p, len, from, stride, pattern, n);
+	}
+	return forward_fn(p, len, from, stride, pattern, n);
+}
+
+size_t search_strided_back(const unsigned char* p, size_t len, size_t from, size_t stride,
+                           const unsigned char* pattern, size_t n) {
+	if (back_fn == NULL) {
+		search_select();
+	}
+	if (stride > INT_MAX / 8) {
+		return search_strided_back_scalar(p, len, from, stride, pattern, n);
+	}
+	return back_fn(p, len, from, stride, pattern, n);
+}
+
+const char* search_implementation() {
+	if (forward_fn == NULL) {
+		search_select();
+	}
+	return search_name;
+}
@@ -0,0 +1,42 @@
+/*
+ * This file is part of hx - a hex editor for the terminal.
+ *
+ * Copyright (c) 2016 Kevin Pors. See LICENSE for details.
+ */
+
+#ifndef HX_SEARCH_H
+#define HX_SEARCH_H
+
+#include <stddef.h>
+
+/*
+ * Strided searches: a pattern is only compared at every `stride'th offset,
+ * like a field at a fixed offset of an array of fixed size records. With
+ * AVX2, the first four bytes at eight of those offsets are gathered and
+ * compared at once, so only the records starting with the right bytes are
+ * compared completely.
+ */
+
+/*
+ * Finds the first of the offsets `from', `from' + `stride', `from' + 2 *
+ * `stride' and so on in the `len' bytes at `p' where all `n' bytes of
+ * `pattern' match. Returns `len' when the pattern matches at none of them.
+ * The `stride' must be at least 1.
+ */
+size_t search_strided(const unsigned char* p, size_t len, size_t from, size_t stride,
+                      const unsigned char* pattern, size_t n);
+
+/*
+ * Like search_strided(), but goes backwards: the offsets `from', `from' -
+ * `stride' and so on are compared, down to the start of `p'.
+ */
+size_t search_strided_back(const unsigned char* p, size_t len, size_t from, size_t stride,
+                           const unsigned char* pattern, size_t n);
+
+/*
+ * Returns the name of the implementation search_strided() uses: "avx2" or
+ * "scalar".
+ */
+const char* search_implementation();
+
+#endif // HX_SEARCH_H
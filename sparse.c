@@ -0,0 +1,187 @@
+/*
+ * This file is part of hx - a hex editor for the terminal.
+ *
+ * Copyright (c) 2016 Kevin Pors. See LICENSE for details.
+ */
+
+// SEEK_DATA and SEEK_HOLE are not part of POSIX. pread() and pwrite() are
+// part of POSIX.1-2008.
+#ifdef __linux__
+#define _GNU_SOURCE
+#else
+#define _XOPEN_SOURCE 700
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "sparse.h"
+#include "mem.h"
+#include "perf.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*
+ * Appends the extent [start, end) to the map.
+ */
+static void sparse_map_add(struct sparse_map* map, uint64_t start, uint64_t end) {
+	if (map->count == map->cap) {
+		map->cap = map->cap == 0 ? 64 : map->cap * 2;
+		map->extents = mem_realloc(MEM_INDEX, map->extents, map->cap * sizeof(struct sparse_extent));
+		if (map->extents == NULL) {
+			perror("Could not allocate memory for the extent map");
+			abort();
+		}
+	}
+	map->extents[map->count].start = start;
+	map->extents[map->count].end = end;
+	map->count++;
+}
+
+struct sparse_map* sparse_map_scan(int fd, uint64_t size) {
+#ifdef SEEK_DATA
+	struct sparse_map* map = mem_alloc(MEM_INDEX, sizeof(struct sparse_map));
+	if (map == NULL) {
+		perror("Could not allocate memory for the extent map");
+		abort();
+	}
+	map->extents = NULL;
+	map->count = 0;
+	map->cap = 0;
+
+	uint64_t offset = 0;
+	while (offset < size) {
+		off_t data = lseek(fd, offset, SEEK_DATA);
+		PERF_COUNT(PERF_SYSCALLS, 1);
+		if (data == -1) {
+			if (errno == ENXIO) {
+				// No more data, the file ends in a hole.
+				break;
+			}
+			// SEEK_DATA is not supported by the file system.
+			sparse_map_free(map);
+			return NULL;
+		}
+		off_t hole = lseek(fd, data, SEEK_HOLE);
+		PERF_COUNT(PERF_SYSCALLS, 1);
+		if (hole == -1) {
+			sparse_map_free(map);
+			return NULL;
+		}
+		sparse_map_add(map, data, (uint64_t) hole < size ? (uint64_t) hole : size);
+		offset = hole;
+	}
+	lseek(fd, 0, SEEK_SET);
+	PERF_COUNT(PERF_SYSCALLS, 1);
+
+	// File systems without hole support report a single extent spanning the
+	// whole file. Not worth keeping a map for.
+	if (map->count == 1 && map->extents[0].start == 0 && map->extents[0].end == size) {
+		sparse_map_free(map);
+		return NULL;
+	}
+	return map;
+#else
+	(void) fd;
+	(void) size;
+	return NULL;
+#endif
+}
+
+void sparse_map_free(struct sparse_map* map) {
+	mem_free(map->extents);
+	mem_free(map);
+}
+
+bool sparse_map_read(struct sparse_map* map, int fd, char* dst) {
+	for (unsigned int i = 0; i < map->count; i++) {
+		uint64_t offset = map->extents[i].start;
+		while (offset < map->extents[i].end) {
+			ssize_t n = pread(fd, dst + offset, map->extents[i].end - offset, offset);
+			PERF_COUNT(PERF_SYSCALLS, 1);
+			if (n == -1 && errno == EINTR) {
+				continue;
+			}
+			if (n <= 0) {
+				if (n == 0) {
+					// The file was truncated while reading.
+					errno = EIO;
+				}
+				return false;
+			}
+			offset += n;
+		}
+	}
+	return true;
+}
+
+const struct sparse_extent* sparse_map_find(struct sparse_map* map, uint64_t offset, int dir) {
+	// Binary search for the first extent starting after offset.
+	unsigned int lo = 0;
+	unsigned int hi = map->count;
+	while (lo < hi) {
+		unsigned int mid = lo + (hi - lo) / 2;
+		if (map->extents[mid].start <= offset) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	if (dir > 0) {
+		return lo < map->count ? &map->extents[lo] : NULL;
+	}
+	// Skip the extent containing offset itself, if any.
+	if (lo > 0 && map->extents[lo - 1].start == offset) {
+		lo--;
+	}
+	return lo > 0 ? &map->extents[lo - 1] : NULL;
+}
+
+void sparse_map_shift(struct sparse_map* map, uint64_t offset, int amount) {
+	for (unsigned int i = 0; i < map->count; i++) {
+		struct sparse_extent* ext = &map->extents[i];
+		if (ext->start > offset) {
+			ext->start += amount;
+		}
+		if (ext->end > offset) {
+			ext->end += amount;
+		}
+	}
+}
+
+/*
+ * Returns true if the `len' bytes at `p' are all zero.
+ */
+static bool is_zero(const char* p, unsigned int len) {
+	// Comparing the buffer with itself shifted by one byte only needs to
+	// check the first byte explicitly.
+	return len == 0 || (p[0] == 0 && memcmp(p, p + 1, len - 1) == 0);
+}
+
+bool sparse_write(int fd, const char* src, uint64_t len, unsigned int blksize) {
+	for (uint64_t offset = 0; offset < len; offset += blksize) {
+		unsigned int n = len - offset < blksize ? len - offset : blksize;
+		if (is_zero(src + offset, n)) {
+			continue;
+		}
+		unsigned int total = 0;
+		while (total < n) {
+			ssize_t w = pwrite(fd, src + offset + total, n - total, offset + total);
+			PERF_COUNT(PERF_SYSCALLS, 1);
+			if (w == -1 && errno == EINTR) {
+				continue;
+			}
+			if (w <= 0) {
+				return false;
+			}
+			total += w;
+		}
+	}
+
+	// Skipped blocks at the end are not written at all, so set the size.
+	PERF_COUNT(PERF_SYSCALLS, 1);
+	return ftruncate(fd, len) == 0;
+}
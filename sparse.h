@@ -0,0 +1,72 @@
+/*
+ * This file is part of hx - a hex editor for the terminal.
+ *
+ * Copyright (c) 2016 Kevin Pors. See LICENSE for details.
+ */
+
+#ifndef HX_SPARSE_H
+#define HX_SPARSE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Support for sparse files. Sparse files (like VM images) contain holes:
+ * ranges which were never written and take no space on disk. They read as
+ * zeroes. The data extents of such a file are found with SEEK_DATA and
+ * SEEK_HOLE (see lseek(2)) and kept in an array sorted by offset. Only these
+ * extents are read; the rest of the buffer is left zeroed.
+ */
+
+/*
+ * A range of the file containing data, i.e. not a hole.
+ */
+struct sparse_extent {
+	uint64_t start; // first offset of the extent.
+	uint64_t end;   // first offset after the extent.
+};
+
+struct sparse_map {
+	struct sparse_extent* extents; // data extents, sorted by offset.
+	unsigned int count;            // amount of extents.
+	unsigned int cap;              // capacity of the extents array.
+};
+
+/*
+ * Builds the map of data extents of the file `fd' which is `size' bytes
+ * long. Returns NULL when the file has no holes, or when the file system
+ * cannot tell.
+ */
+struct sparse_map* sparse_map_scan(int fd, uint64_t size);
+
+/*
+ * Frees the map.
+ */
+void sparse_map_free(struct sparse_map* map);
+
+/*
+ * Reads only the data extents of `fd' into `dst', which must be zeroed.
+ * Returns false if reading failed, with errno set.
+ */
+bool sparse_map_read(struct sparse_map* map, int fd, char* dst);
+
+/*
+ * Finds the first extent starting after `offset' when `dir' > 0, or the last
+ * extent starting before `offset' otherwise. Returns NULL if there is none.
+ */
+const struct sparse_extent* sparse_map_find(struct sparse_map* map, uint64_t offset, int dir);
+
+/*
+ * Adjusts the map for `amount' bytes inserted (positive) or deleted
+ * (negative) at `offset'.
+ */
+void sparse_map_shift(struct sparse_map* map, uint64_t offset, int amount);
+
+/*
+ * Writes `len' bytes from `src' to the empty file `fd', skipping blocks of
+ * `blksize' bytes which only contain zeroes, so they become holes. Returns
+ * false if writing failed, with errno set.
+ */
+bool sparse_write(int fd, const char* src, uint64_t len, unsigned int blksize);
+
+#endif // HX_SPARSE_H
@@ -0,0 +1,242 @@
+/*
+ * This file is part of hx - a hex editor for the terminal.
+ *
+ * Copyright (c) 2016 Kevin Pors. See LICENSE for details.
+ */
+
+// The threads and sysconf(_SC_NPROCESSORS_ONLN) need more than the POSIX.1
+// the Makefile limits us to by defining _POSIX_SOURCE.
+#define _XOPEN_SOURCE 700
+#define _POSIX_C_SOURCE 200809L
+
+#include "strscan.h"
+#include "mem.h"
+#include "trace.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Maximum amount of threads, and the minimum amount of bytes per thread.
+#define STRINGS_MAX_THREADS 8
+#define STRINGS_MIN_CHUNK (1024 * 1024)
+
+// Every byte of a word set to the same value.
+#define ONES  UINT64_C(0x0101010101010101)
+#define HIGHS UINT64_C(0x8080808080808080)
+
+/*
+ * Returns true if any byte of `x' is less than `n' (n <= 128).
+ */
+static inline bool has_less(uint64_t x, unsigned int n) {
+	return ((x - ONES * n) & ~x & HIGHS) != 0;
+}
+
+/*
+ * Returns true if all eight bytes of `x' are printable ASCII (0x20 - 0x7e).
+ */
+static inline bool all_printable(uint64_t x) {
+	return (x & HIGHS) == 0
+		&& !has_less(x, 0x20)
+		&& !has_less(x ^ (ONES * 0x7f), 1);
+}
+
+static inline bool printable(unsigned char c) {
+	return c >= 0x20 && c <= 0x7e;
+}
+
+/*
+ * The strings found by one thread. Strings are only reported by the thread
+ * whose chunk they start in, so the results of the threads can simply be
+ * concatenated.
+ */
+struct strings_job {
+	const unsigned char* data;  // the whole buffer.
+	size_t len;                 // length of the whole buffer.
+	size_t start;               // start of the chunk.
+	size_t end;                 // end of the chunk.
+	unsigned int minlen;        // minimum string length in characters.
+	uint64_t base;              // offset of the buffer.
+
+	struct string_entry* found[2]; // strings found, per encoding.
+	size_t count[2];
+	size_t cap[2];
+};
+
+static void strings_add(struct strings_job* job, enum string_encoding enc, size_t offset, size_t len) {
+	if (job->count[enc] == job->cap[enc]) {
+		job->cap[enc] = job->cap[enc] == 0 ? 256 : job->cap[enc] * 2;
+		job->found[enc] = mem_realloc(MEM_INDEX, job->found[enc], job->cap[enc] * sizeof(struct string_entry));
+		if (job->found[enc] == NULL) {
+			perror("Could not allocate memory for strings");
+			abort();
+		}
+	}
+	struct string_entry* s = &job->found[enc][job->count[enc]++];
+	s->offset = job->base + offset;
+	s->length = len > UINT32_MAX ? UINT32_MAX : len;
+	s->encoding = enc;
+}
+
+/*
+ * Finds the ASCII strings starting in the chunk of `job'. A string may run
+ * past the end of the chunk.
+ */
+static void strings_scan_ascii(struct strings_job* job) {
+	const unsigned char* p = job->data;
+	size_t i = job->start;
+
+	// A run continuing from the previous chunk belongs to that chunk.
+	if (i > 0 && printable(p[i - 1])) {
+		while (i < job->end && printable(p[i])) {
+			i++;
+		}
+	}
+
+	while (i < job->end) {
+		if (!printable(p[i])) {
+			i++;
+			continue;
+		}
+		size_t start = i;
+		// Extend the run a word at a time, then byte by byte.
+		uint64_t w;
+		while (i + sizeof(w) <= job->len) {
+			memcpy(&w, p + i, sizeof(w));
+			if (!all_printable(w)) {
+				break;
+			}
+			i += sizeof(w);
+		}
+		while (i < job->len && printable(p[i])) {
+			i++;
+		}
+		if (i - start >= job->minlen) {
+			strings_add(job, STRING_ASCII, start, i - start);
+		}
+	}
+}
+
+/*
+ * Returns true if a UTF-16LE encoded printable character is at `i'.
+ */
+static inline bool utf16_char(const unsigned char* p, size_t len, size_t i) {
+	return i + 1 < len && printable(p[i]) && p[i + 1] == 0;
+}
+
+/*
+ * Finds the UTF-16LE strings starting in the chunk of `job'.
+ */
+static void strings_scan_utf16(struct strings_job* job) {
+	const unsigned char* p = job->data;
+	for (size_t i = job->start; i < job->end; i++) {
+		if (!utf16_char(p, job->len, i)) {
+			continue;
+		}
+		// Strings preceded by another character continue from the
+		// previous chunk.
+		if (i >= 2 && utf16_char(p, job->len, i - 2)) {
+			continue;
+		}
+		size_t start = i;
+		while (utf16_char(p, job->len, i)) {
+			i += 2;
+		}
+		if ((i - start) / 2 >= job->minlen) {
+			strings_add(job, STRING_UTF16LE, start, i - start);
+		}
+		// The loop increment skips the zero byte following the string.
+		i--;
+	}
+}
+
+static void* strings_worker(void* arg) {
+	struct strings_job* job = arg;
+	TRACE_BEGIN(TRACE_STRINGS);
+	strings_scan_ascii(job);
+	strings_scan_utf16(job);
+	TRACE_END(TRACE_STRINGS);
+	return NULL;
+}
+
+struct string_index* strings_extract(const char* data, size_t len, unsigned int minlen, uint64_t base) {
+	if (minlen == 0) {
+		minlen = 1;
+	}
+
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	size_t threads = cpus < 1 ? 1 : (size_t) cpus;
+	if (threads > STRINGS_MAX_THREADS) {
+		threads = STRINGS_MAX_THREADS;
+	}
+	if (threads > len / STRINGS_MIN_CHUNK) {
+		threads = len / STRINGS_MIN_CHUNK > 0 ? len / STRINGS_MIN_CHUNK : 1;
+	}
+
+	struct strings_job jobs[STRINGS_MAX_THREADS];
+	pthread_t tids[STRINGS_MAX_THREADS];
+	bool started[STRINGS_MAX_THREADS];
+	memset(jobs, 0, sizeof(jobs));
+	for (size_t t = 0; t < threads; t++) {
+		jobs[t].data = (const unsigned char*) data;
+		jobs[t].len = len;
+		jobs[t].start = len / threads * t;
+		jobs[t].end = t == threads - 1 ? len : len / threads * (t + 1);
+		jobs[t].minlen = minlen;
+		jobs[t].base = base;
+		// The first chunk is scanned by this thread. When a thread cannot
+		// be created, its chunk is scanned here as well.
+		started[t] = t > 0 && pthread_create(&tids[t], NULL, strings_worker, &jobs[t]) == 0;
+	}
+	for (size_t t = 0; t < threads; t++) {
+		if (started[t]) {
+			pthread_join(tids[t], NULL);
+		} else {
+			strings_worker(&jobs[t]);
+		}
+	}
+
+	struct string_index* idx = mem_alloc(MEM_INDEX, sizeof(struct string_index));
+	if (idx == NULL) {
+		perror("Could not allocate memory for strings");
+		abort();
+	}
+	size_t total = 0;
+	for (size_t t = 0; t < threads; t++) {
+		total += jobs[t].count[STRING_ASCII] + jobs[t].count[STRING_UTF16LE];
+	}
+	idx->entries = mem_alloc(MEM_INDEX, (total + 1) * sizeof(struct string_entry));
+	if (idx->entries == NULL) {
+		perror("Could not allocate memory for strings");
+		abort();
+	}
+	idx->count = 0;
+
+	// The strings of every chunk are sorted per encoding, and the chunks
+	// are in order. Merge both encodings chunk by chunk.
+	for (size_t t = 0; t < threads; t++) {
+		struct strings_job* job = &jobs[t];
+		size_t a = 0;
+		size_t u = 0;
+		while (a < job->count[STRING_ASCII] || u < job->count[STRING_UTF16LE]) {
+			bool take_ascii = u == job->count[STRING_UTF16LE]
+				|| (a < job->count[STRING_ASCII]
+				    && job->found[STRING_ASCII][a].offset <= job->found[STRING_UTF16LE][u].offset);
+			idx->entries[idx->count++] = take_ascii
+				? job->found[STRING_ASCII][a++]
+				: job->found[STRING_UTF16LE][u++];
+		}
+		mem_free(job->found[STRING_ASCII]);
+		mem_free(job->found[STRING_UTF16LE]);
+	}
+
+	return idx;
+}
+
+void strings_free(struct string_index* idx) {
+	mem_free(idx->entries);
+	mem_free(idx);
+}
@@ -0,0 +1,47 @@
+/*
+ * This file is part of hx - a hex editor for the terminal.
+ *
+ * Copyright (c) 2016 Kevin Pors. See LICENSE for details.
+ */
+
+#ifndef HX_STRSCAN_H
+#define HX_STRSCAN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Extraction of strings from a buffer, like strings(1) does: runs of at
+ * least a minimum amount of printable ASCII characters, either as plain
+ * bytes or encoded as UTF-16LE (every character followed by a zero byte).
+ * The buffer is divided in chunks which are scanned by multiple threads.
+ */
+
+enum string_encoding {
+	STRING_ASCII,
+	STRING_UTF16LE,
+};
+
+struct string_entry {
+	uint64_t offset;   // offset of the first byte of the string.
+	uint32_t length;   // length in bytes (twice the characters for UTF-16LE).
+	uint8_t  encoding; // one of enum string_encoding.
+};
+
+struct string_index {
+	struct string_entry* entries; // the strings found, sorted by offset.
+	size_t count;                 // amount of strings found.
+};
+
+/*
+ * Extracts the strings of at least `minlen' characters from the `len' bytes
+ * at `data'. The offsets of the strings are relative to `base'.
+ */
+struct string_index* strings_extract(const char* data, size_t len, unsigned int minlen, uint64_t base);
+
+/*
+ * Frees the index.
+ */
+void strings_free(struct string_index* idx);
+
+#endif // HX_STRSCAN_H
@@ -0,0 +1,1099 @@
+/*
+ * This file is part of hx - a hex editor for the terminal.
+ *
+ * Copyright (c) 2016 Kevin Pors. See LICENSE for details.
+ */
+
+#include "template.h"
+#include "mem.h"
+#include "perf.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Maximum length of names and of a line.
+#define TPL_NAME 24
+#define TPL_LINE 256
+
+// Maximum depth of the stack evaluating a count.
+#define TPL_STACK 16
+
+// Amount of arrays whose element offsets are cached.
+#define TPL_CACHE_SLOTS 16
+
+enum tpl_kind {
+	TPL_UNSIGNED,
+	TPL_SIGNED,
+	TPL_FLOAT,
+	TPL_CHAR,
+	TPL_STRUCT,
+};
+
+/*
+ * Counts are compiled to postfix: numbers and fields push a value, the
+ * operators pop two and push the result.
+ */
+enum tpl_opcode {
+	TPL_OP_NUMBER,
+	TPL_OP_FIELD, // value of the field with index `value' in the same struct.
+	TPL_OP_ADD,
+	TPL_OP_SUB,
+	TPL_OP_MUL,
+	TPL_OP_DIV,
+};
+
+struct tpl_op {
+	enum tpl_opcode code;
+	uint64_t value;
+};
+
+struct tpl_field {
+	char name[TPL_NAME];
+	char type[TPL_NAME];  // type as written in the template.
+	enum tpl_kind kind;
+	unsigned int width;   // size of a number.
+	bool big_endian;
+	int struct_id;        // the struct, for TPL_STRUCT.
+	bool array;
+	bool until_end;       // an array without a count.
+	unsigned int expr_first; // the count, in the ops of the template.
+	unsigned int expr_len;
+};
+
+struct tpl_struct {
+	char name[TPL_NAME];
+	unsigned int first;  // first field, in the fields of the template.
+	unsigned int count;  // amount of fields.
+	int64_t size;        // size, or -1 if it depends on the data.
+	unsigned int depth;  // levels of fields, including those of nested structs.
+};
+
+/*
+ * The offsets of the elements of an array of structs of varying sizes,
+ * as far as they are known: offsets[i] is where element i starts, and
+ * offsets[known] where the last known one ends.
+ */
+struct tpl_cache {
+	int field;        // index of the field, or -1 if unused.
+	uint64_t base;    // offset of the array.
+	uint64_t* offsets;
+	uint64_t known;
+	uint64_t cap;
+	bool complete;    // whether the end of the array was found.
+	uint64_t used;    // when it was last used, to evict the oldest.
+};
+
+struct template {
+	struct tpl_struct* structs;
+	unsigned int struct_count;
+	struct tpl_field* fields;
+	unsigned int field_count;
+	struct tpl_op* ops;
+	unsigned int op_count;
+	int root; // the struct made of the fields outside of the structs.
+
+	struct tpl_cache cache[TPL_CACHE_SLOTS];
+	uint64_t clock;
+	// Nonzero while an array is being walked to fill its cache. Arrays
+	// within its elements are walked without it, so filling one slot never
+	// evicts the other.
+	unsigned int walking;
+};
+
+// Tokens of a line.
+enum tpl_token {
+	TPL_TOK_END,
+	TPL_TOK_NAME,
+	TPL_TOK_NUMBER,
+	TPL_TOK_PUNCT,
+};
+
+struct tpl_parser {
+	struct template* t;
+	unsigned int struct_cap;
+	unsigned int field_cap;
+	unsigned int op_cap;
+
+	// Fields outside of the structs, appended to the fields at the end.
+	struct tpl_field* root_fields;
+	unsigned int root_count;
+	unsigned int root_cap;
+
+	bool big_endian;  // set with `endian'.
+	int open;         // struct being defined, or -1.
+	unsigned int lineno;
+
+	const char* p;    // position in the line.
+	enum tpl_token tok;
+	char text[TPL_NAME];
+	uint64_t number;
+	char punct;
+	unsigned int stack; // depth of the stack while compiling a count.
+	unsigned int stack_max;
+
+	char* err;
+	size_t errlen;
+};
+
+/*
+ * Makes room for one more of the `count' items of `size' bytes at `p'.
+ */
+static void* tpl_grow(void* p, unsigned int count, unsigned int* cap, size_t size) {
+	if (count < *cap) {
+		return p;
+	}
+	*cap = *cap == 0 ? 16 : *cap * 2;
+	p = mem_realloc(MEM_OTHER, p, *cap * size);
+	if (p == NULL) {
+		perror("Could not allocate memory for the template");
+		abort();
+	}
+	return p;
+}
+
+static bool tpl_error(struct tpl_parser* ps, const char* fmt, ...) {
+	int n = snprintf(ps->err, ps->errlen, "line %u: ", ps->lineno);
+	if (n >= 0 && (size_t) n < ps->errlen) {
+		va_list ap;
+		va_start(ap, fmt);
+		vsnprintf(ps->err + n, ps->errlen - n, fmt, ap);
+		va_end(ap);
+	}
+	return false;
+}
+
+/*
+ * Reads the next token of the line. Comments start with a '#'.
+ */
+static bool tpl_lex(struct tpl_parser* ps) {
+	while (isspace((unsigned char) *ps->p)) {
+		ps->p++;
+	}
+	char c = *ps->p;
+	if (c == '\0' || c == '#') {
+		ps->tok = TPL_TOK_END;
+		return true;
+	}
+	if (isalpha((unsigned char) c) || c == '_') {
+		size_t n = 0;
+		while (isalnum((unsigned char) ps->p[n]) || ps->p[n] == '_') {
+			n++;
+		}
+		if (n >= TPL_NAME) {
+			return tpl_error(ps, "name '%.*s' is too long", (int) n, ps->p);
+		}
+		memcpy(ps->text, ps->p, n);
+		ps->text[n] = '\0';
+		ps->p += n;
+		ps->tok = TPL_TOK_NAME;
+		return true;
+	}
+	if (isdigit((unsigned char) c)) {
+		char* end;
+		errno = 0;
+		unsigned long long v = strtoull(ps->p, &end, 0);
+		if (errno != 0 || v > INT64_MAX || isalnum((unsigned char) *end)) {
+			return tpl_error(ps, "invalid number");
+		}
+		ps->number = v;
+		ps->p = end;
+		ps->tok = TPL_TOK_NUMBER;
+		return true;
+	}
+	if (strchr("{}[]()+-*/", c) != NULL) {
+		ps->punct = c;
+		ps->p++;
+		ps->tok = TPL_TOK_PUNCT;
+		return true;
+	}
+	return tpl_error(ps, "unexpected '%c'", c);
+}
+
+static bool tpl_is_punct(struct tpl_parser* ps, char c) {
+	return ps->tok == TPL_TOK_PUNCT && ps->punct == c;
+}
+
+static bool tpl_expect_end(struct tpl_parser* ps) {
+	if (!tpl_lex(ps)) {
+		return false;
+	}
+	if (ps->tok != TPL_TOK_END) {
+		return tpl_error(ps, "expected the end of the line");
+	}
+	return true;
+}
+
+static int tpl_find_struct(struct template* t, const char* name) {
+	for (unsigned int i = 0; i < t->struct_count; i++) {
+		if (strcmp(t->structs[i].name, name) == 0) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+/*
+ * Returns the fields of the struct being defined, and their amount.
+ */
+static struct tpl_field* tpl_open_fields(struct tpl_parser* ps, unsigned int* count) {
+	if (ps->open < 0) {
+		*count = ps->root_count;
+		return ps->root_fields;
+	}
+	struct tpl_struct* s = &ps->t->structs[ps->open];
+	*count = s->count;
+	return &ps->t->fields[s->first];
+}
+
+static void tpl_emit(struct tpl_parser* ps, enum tpl_opcode code, uint64_t value) {
+	struct template* t = ps->t;
+	t->ops = tpl_grow(t->ops, t->op_count, &ps->op_cap, sizeof(struct tpl_op));
+	t->ops[t->op_count].code = code;
+	t->ops[t->op_count].value = value;
+	t->op_count++;
+	if (code == TPL_OP_NUMBER || code == TPL_OP_FIELD) {
+		if (++ps->stack > ps->stack_max) {
+			ps->stack_max = ps->stack;
+		}
+	} else {
+		ps->stack--;
+	}
+}
+
+static bool tpl_expr(struct tpl_parser* ps);
+
+/*
+ * factor := number | field | '(' expr ')'
+ */
+static bool tpl_factor(struct tpl_parser* ps) {
+	if (ps->tok == TPL_TOK_NUMBER) {
+		tpl_emit(ps, TPL_OP_NUMBER, ps->number);
+		return tpl_lex(ps);
+	}
+	if (ps->tok == TPL_TOK_NAME) {
+		unsigned int count;
+		struct tpl_field* fields = tpl_open_fields(ps, &count);
+		for (unsigned int i = 0; i < count; i++) {
+			if (strcmp(fields[i].name, ps->text) != 0) {
+				continue;
+			}
+			if (fields[i].array || fields[i].kind == TPL_STRUCT || fields[i].kind == TPL_FLOAT) {
+				return tpl_error(ps, "'%s' is not an integer", ps->text);
+			}
+			tpl_emit(ps, TPL_OP_FIELD, i);
+			return tpl_lex(ps);
+		}
+		return tpl_error(ps, "no field '%s' before this one", ps->text);
+	}
+	if (tpl_is_punct(ps, '(')) {
+		if (!tpl_lex(ps) || !tpl_expr(ps)) {
+			return false;
+		}
+		if (!tpl_is_punct(ps, ')')) {
+			return tpl_error(ps, "expected ')'");
+		}
+		return tpl_lex(ps);
+	}
+	return tpl_error(ps, "expected a number or a field");
+}
+
+/*
+ * term := factor { ('*' | '/') factor }
+ */
+static bool tpl_term(struct tpl_parser* ps) {
+	if (!tpl_factor(ps)) {
+		return false;
+	}
+	while (tpl_is_punct(ps, '*') || tpl_is_punct(ps, '/')) {
+		enum tpl_opcode code = ps->punct == '*' ? TPL_OP_MUL : TPL_OP_DIV;
+		if (!tpl_lex(ps) || !tpl_factor(ps)) {
+			return false;
+		}
+		tpl_emit(ps, code, 0);
+	}
+	return true;
+}
+
+/*
+ * expr := term { ('+' | '-') term }
+ */
+static bool tpl_expr(struct tpl_parser* ps) {
+	if (!tpl_term(ps)) {
+		return false;
+	}
+	while (tpl_is_punct(ps, '+') || tpl_is_punct(ps, '-')) {
+		enum tpl_opcode code = ps->punct == '+' ? TPL_OP_ADD : TPL_OP_SUB;
+		if (!tpl_lex(ps) || !tpl_term(ps)) {
+			return false;
+		}
+		tpl_emit(ps, code, 0);
+	}
+	return true;
+}
+
+/*
+ * Resolves the type `name' of field `f'. Structs take precedence, so a
+ * struct may be called `table' without the `le' being taken for a suffix.
+ */
+static bool tpl_type(struct tpl_parser* ps, const char* name, struct tpl_field* f) {
+	static const struct {
+		const char* name;
+		enum tpl_kind kind;
+		unsigned int width;
+	} numbers[] = {
+		{ "u8",  TPL_UNSIGNED, 1 }, { "u16", TPL_UNSIGNED, 2 },
+		{ "u32", TPL_UNSIGNED, 4 }, { "u64", TPL_UNSIGNED, 8 },
+		{ "i8",  TPL_SIGNED,   1 }, { "i16", TPL_SIGNED,   2 },
+		{ "i32", TPL_SIGNED,   4 }, { "i64", TPL_SIGNED,   8 },
+		{ "f32", TPL_FLOAT,    4 }, { "f64", TPL_FLOAT,    8 },
+		{ "char", TPL_CHAR,    1 },
+	};
+
+	snprintf(f->type, sizeof(f->type), "%s", name);
+	f->big_endian = ps->big_endian;
+	f->struct_id = tpl_find_struct(ps->t, name);
+	if (f->struct_id >= 0) {
+		f->kind = TPL_STRUCT;
+		f->width = 0;
+		return true;
+	}
+
+	char base[TPL_NAME];
+	snprintf(base, sizeof(base), "%s", name);
+	size_t n = strlen(base);
+	if (n > 2 && (strcmp(base + n - 2, "le") == 0 || strcmp(base + n - 2, "be") == 0)) {
+		f->big_endian = base[n - 2] == 'b';
+		base[n - 2] = '\0';
+	}
+	for (size_t i = 0; i < sizeof(numbers) / sizeof(numbers[0]); i++) {
+		if (strcmp(numbers[i].name, base) == 0) {
+			f->kind = numbers[i].kind;
+			f->width = numbers[i].width;
+			return true;
+		}
+	}
+	return tpl_error(ps, "unknown type '%s'", name);
+}
+
+/*
+ * Returns the size of field `f' if it does not depend on the data, or -1.
+ */
+static int64_t tpl_static_size(struct template* t, const struct tpl_field* f) {
+	int64_t elem = f->kind == TPL_STRUCT ? t->structs[f->struct_id].size : (int64_t) f->width;
+	if (elem < 0 || !f->array) {
+		return elem;
+	}
+	if (f->until_end || f->expr_len != 1 || t->ops[f->expr_first].code != TPL_OP_NUMBER) {
+		return -1;
+	}
+	uint64_t count = t->ops[f->expr_first].value;
+	if (elem > 0 && count > (uint64_t) (INT64_MAX / elem)) {
+		return -1;
+	}
+	return elem * (int64_t) count;
+}
+
+/*
+ * Works out the size and depth of the struct `s' once all its fields are
+ * known.
+ */
+static bool tpl_close_struct(struct tpl_parser* ps, struct tpl_struct* s) {
+	struct template* t = ps->t;
+	if (s->count == 0) {
+		return tpl_error(ps, "struct '%s' has no fields", s->name);
+	}
+	s->size = 0;
+	s->depth = 1;
+	for (unsigned int i = 0; i < s->count; i++) {
+		const struct tpl_field* f = &t->fields[s->first + i];
+		int64_t size = tpl_static_size(t, f);
+		if (size < 0 || s->size < 0 || size > INT64_MAX - s->size) {
+			s->size = -1;
+		} else {
+			s->size += size;
+		}
+		if (f->kind == TPL_STRUCT && t->structs[f->struct_id].depth + 1 > s->depth) {
+			s->depth = t->structs[f->struct_id].depth + 1;
+		}
+	}
+	if (s->depth >= TEMPLATE_MAX_DEPTH) {
+		return tpl_error(ps, "structs are nested too deeply");
+	}
+	return true;
+}
+
+/*
+ * Parses a field: TYPE NAME or TYPE NAME[COUNT], with the type in the
+ * current token.
+ */
+static bool tpl_field(struct tpl_parser* ps) {
+	struct tpl_field f;
+	memset(&f, 0, sizeof(f));
+	if (!tpl_type(ps, ps->text, &f)) {
+		return false;
+	}
+	if (!tpl_lex(ps)) {
+		return false;
+	}
+	if (ps->tok != TPL_TOK_NAME) {
+		return tpl_error(ps, "expected the name of the field");
+	}
+	unsigned int count;
+	struct tpl_field* fields = tpl_open_fields(ps, &count);
+	for (unsigned int i = 0; i < count; i++) {
+		if (strcmp(fields[i].name, ps->text) == 0) {
+			return tpl_error(ps, "field '%s' is defined twice", ps->text);
+		}
+	}
+	if (count >= TEMPLATE_MAX_FIELDS) {
+		return tpl_error(ps, "more than %d fields", TEMPLATE_MAX_FIELDS);
+	}
+	snprintf(f.name, sizeof(f.name), "%s", ps->text);
+
+	if (!tpl_lex(ps)) {
+		return false;
+	}
+	if (tpl_is_punct(ps, '[')) {
+		f.array = true;
+		if (!tpl_lex(ps)) {
+			return false;
+		}
+		if (tpl_is_punct(ps, ']')) {
+			f.until_end = true;
+		} else {
+			f.expr_first = ps->t->op_count;
+			ps->stack = 0;
+			ps->stack_max = 0;
+			if (!tpl_expr(ps)) {
+				return false;
+			}
+			if (ps->stack_max > TPL_STACK) {
+				return tpl_error(ps, "the count is too complex");
+			}
+			f.expr_len = ps->t->op_count - f.expr_first;
+			if (!tpl_is_punct(ps, ']')) {
+				return tpl_error(ps, "expected ']'");
+			}
+		}
+		if (!tpl_lex(ps)) {
+			return false;
+		}
+	}
+	if (ps->tok != TPL_TOK_END) {
+		return tpl_error(ps, "expected the end of the line");
+	}
+
+	struct template* t = ps->t;
+	if (ps->open < 0) {
+		ps->root_fields = tpl_grow(ps->root_fields, ps->root_count, &ps->root_cap, sizeof(f));
+		ps->root_fields[ps->root_count++] = f;
+	} else {
+		t->fields = tpl_grow(t->fields, t->field_count, &ps->field_cap, sizeof(f));
+		t->fields[t->field_count++] = f;
+		t->structs[ps->open].count++;
+	}
+	return true;
+}
+
+static bool tpl_line(struct tpl_parser* ps, const char* line) {
+	struct template* t = ps->t;
+	ps->p = line;
+	if (!tpl_lex(ps)) {
+		return false;
+	}
+	if (ps->tok == TPL_TOK_END) {
+		return true;
+	}
+
+	if (tpl_is_punct(ps, '}')) {
+		if (ps->open < 0) {
+			return tpl_error(ps, "'}' without a struct");
+		}
+		if (!tpl_expect_end(ps) || !tpl_close_struct(ps, &t->structs[ps->open])) {
+			return false;
+		}
+		ps->open = -1;
+		return true;
+	}
+	if (ps->tok != TPL_TOK_NAME) {
+		return tpl_error(ps, "expected a field or a struct");
+	}
+
+	if (strcmp(ps->text, "endian") == 0) {
+		if (!tpl_lex(ps)) {
+			return false;
+		}
+		if (ps->tok != TPL_TOK_NAME || (strcmp(ps->text, "big") != 0 && strcmp(ps->text, "little") != 0)) {
+			return tpl_error(ps, "expected 'big' or 'little'");
+		}
+		ps->big_endian = ps->text[0] == 'b';
+		return tpl_expect_end(ps);
+	}
+
+	if (strcmp(ps->text, "struct") == 0) {
+		if (ps->open >= 0) {
+			return tpl_error(ps, "structs cannot be defined within a struct");
+		}
+		if (!tpl_lex(ps)) {
+			return false;
+		}
+		if (ps->tok != TPL_TOK_NAME) {
+			return tpl_error(ps, "expected the name of the struct");
+		}
+		if (tpl_find_struct(t, ps->text) >= 0) {
+			return tpl_error(ps, "struct '%s' is defined twice", ps->text);
+		}
+		t->structs = tpl_grow(t->structs, t->struct_count, &ps->struct_cap, sizeof(struct tpl_struct));
+		struct tpl_struct* s = &t->structs[t->struct_count];
+		memset(s, 0, sizeof(*s));
+		snprintf(s->name, sizeof(s->name), "%s", ps->text);
+		s->first = t->field_count;
+		if (!tpl_lex(ps)) {
+			return false;
+		}
+		if (!tpl_is_punct(ps, '{')) {
+			return tpl_error(ps, "expected '{'");
+		}
+		if (!tpl_expect_end(ps)) {
+			return false;
+		}
+		ps->open = t->struct_count++;
+		return true;
+	}
+
+	return tpl_field(ps);
+}
+
+struct template* template_load(const char* path, char* err, size_t errlen) {
+	FILE* fp = fopen(path, "r");
+	if (fp == NULL) {
+		snprintf(err, errlen, "%s", strerror(errno));
+		return NULL;
+	}
+
+	struct template* t = mem_alloc(MEM_OTHER, sizeof(struct template));
+	if (t == NULL) {
+		perror("Could not allocate memory for the template");
+		abort();
+	}
+	memset(t, 0, sizeof(*t));
+	for (int i = 0; i < TPL_CACHE_SLOTS; i++) {
+		t->cache[i].field = -1;
+	}
+
+	struct tpl_parser ps;
+	memset(&ps, 0, sizeof(ps));
+	ps.t = t;
+	ps.open = -1;
+	ps.err = err;
+	ps.errlen = errlen;
+
+	char line[TPL_LINE];
+	bool ok = true;
+	while (ok && fgets(line, sizeof(line), fp) != NULL) {
+		ps.lineno++;
+		if (strchr(line, '\n') == NULL && !feof(fp)) {
+			ok = tpl_error(&ps, "line is too long");
+			break;
+		}
+		ok = tpl_line(&ps, line);
+	}
+	fclose(fp);
+
+	if (ok && ps.open >= 0) {
+		ok = tpl_error(&ps, "struct '%s' is not closed", t->structs[ps.open].name);
+	}
+	if (ok && ps.root_count == 0) {
+		ok = tpl_error(&ps, "no fields outside of a struct");
+	}
+	if (ok) {
+		// The file itself is a struct of the fields outside of the structs.
+		t->structs = tpl_grow(t->structs, t->struct_count, &ps.struct_cap, sizeof(struct tpl_struct));
+		struct tpl_struct* root = &t->structs[t->struct_count];
+		memset(root, 0, sizeof(*root));
+		snprintf(root->name, sizeof(root->name), "file");
+		root->first = t->field_count;
+		for (unsigned int i = 0; i < ps.root_count; i++) {
+			t->fields = tpl_grow(t->fields, t->field_count, &ps.field_cap, sizeof(struct tpl_field));
+			t->fields[t->field_count++] = ps.root_fields[i];
+			root->count++;
+		}
+		ps.open = t->struct_count++;
+		ok = tpl_close_struct(&ps, root);
+		t->root = ps.open;
+	}
+	mem_free(ps.root_fields);
+
+	if (!ok) {
+		template_free(t);
+		return NULL;
+	}
+	return t;
+}
+
+void template_free(struct template* t) {
+	if (t == NULL) {
+		return;
+	}
+	for (int i = 0; i < TPL_CACHE_SLOTS; i++) {
+		mem_free(t->cache[i].offsets);
+	}
+	mem_free(t->structs);
+	mem_free(t->fields);
+	mem_free(t->ops);
+	mem_free(t);
+}
+
+void template_invalidate(struct template* t) {
+	for (int i = 0; i < TPL_CACHE_SLOTS; i++) {
+		t->cache[i].field = -1;
+		t->cache[i].used = 0;
+	}
+}
+
+/*
+ * Reads the number of field `f' at `at' as unsigned. Numbers not completely
+ * within the data read as 0.
+ */
+static uint64_t tpl_read(const unsigned char* data, uint64_t len, uint64_t at, const struct tpl_field* f) {
+	if (at >= len || len - at < f->width) {
+		return 0;
+	}
+	uint64_t v = 0;
+	for (unsigned int i = 0; i < f->width; i++) {
+		unsigned char b = f->big_endian ? data[at + i] : data[at + f->width - 1 - i];
+		v = (v << 8) | b;
+	}
+	return v;
+}
+
+/*
+ * Sign extends the `width' bytes number `v'.
+ */
+static int64_t tpl_signed(uint64_t v, unsigned int width) {
+	unsigned int shift = 64 - 8 * width;
+	return shift == 0 ? (int64_t) v : (int64_t) (v << shift) >> shift;
+}
+
+/*
+ * Evaluates the count of array `f', one of the fields `members' of a struct
+ * laid out at `offsets'. Division by zero and negative counts give 0.
+ */
+static uint64_t tpl_eval(struct template* t, const unsigned char* data, uint64_t len,
+                         const struct tpl_field* f, const struct tpl_field* members,
+                         const uint64_t* offsets) {
+	int64_t stack[TPL_STACK];
+	unsigned int sp = 0;
+	for (unsigned int i = 0; i < f->expr_len; i++) {
+		const struct tpl_op* op = &t->ops[f->expr_first + i];
+		if (op->code == TPL_OP_NUMBER) {
+			stack[sp++] = (int64_t) op->value;
+			continue;
+		}
+		if (op->code == TPL_OP_FIELD) {
+			const struct tpl_field* m = &members[op->value];
+			uint64_t v = tpl_read(data, len, offsets[op->value], m);
+			stack[sp++] = m->kind == TPL_SIGNED ? tpl_signed(v, m->width) : (int64_t) v;
+			continue;
+		}
+		// Wrapping around is fine, the result only has to be defined.
+		uint64_t a = (uint64_t) stack[sp - 2];
+		uint64_t b = (uint64_t) stack[sp - 1];
+		int64_t r;
+		switch (op->code) {
+		case TPL_OP_ADD: r = (int64_t) (a + b); break;
+		case TPL_OP_SUB: r = (int64_t) (a - b); break;
+		case TPL_OP_MUL: r = (int64_t) (a * b); break;
+		default:
+			if (stack[sp - 1] == 0 || (stack[sp - 2] == INT64_MIN && stack[sp - 1] == -1)) {
+				r = 0;
+			} else {
+				r = stack[sp - 2] / stack[sp - 1];
+			}
+			break;
+		}
+		stack[--sp - 1] = r;
+	}
+	return sp == 1 && stack[0] > 0 ? (uint64_t) stack[0] : 0;
+}
+
+static uint64_t tpl_element_at(struct template* t, const unsigned char* data, uint64_t len,
+                               const struct tpl_field* f, uint64_t base, uint64_t count,
+                               uint64_t offset, uint64_t* index, uint64_t* start);
+
+/*
+ * Lays out the fields of struct `sid' at `base': field i starts at
+ * offsets[i], and the struct ends at offsets[count].
+ */
+static void tpl_layout(struct template* t, const unsigned char* data, uint64_t len,
+                       int sid, uint64_t base, uint64_t* offsets);
+
+static uint64_t tpl_struct_size(struct template* t, const unsigned char* data, uint64_t len,
+                                int sid, uint64_t at) {
+	const struct tpl_struct* s = &t->structs[sid];
+	if (s->size >= 0) {
+		return s->size;
+	}
+	uint64_t offsets[TEMPLATE_MAX_FIELDS + 1];
+	tpl_layout(t, data, len, sid, at, offsets);
+	return offsets[s->count] - at;
+}
+
+/*
+ * Returns the size of the i'th of the fields `members', laid out at
+ * `offsets' as far as field i.
+ */
+static uint64_t tpl_field_size(struct template* t, const unsigned char* data, uint64_t len,
+                               const struct tpl_field* members, const uint64_t* offsets,
+                               unsigned int i) {
+	const struct tpl_field* f = &members[i];
+	uint64_t at = offsets[i];
+	int64_t elem = f->kind == TPL_STRUCT ? t->structs[f->struct_id].size : (int64_t) f->width;
+	if (!f->array) {
+		return elem >= 0 ? (uint64_t) elem : tpl_struct_size(t, data, len, f->struct_id, at);
+	}
+
+	uint64_t count = f->until_end ? UINT64_MAX : tpl_eval(t, data, len, f, members, offsets);
+	if (elem == 0) {
+		return 0;
+	}
+	if (elem > 0) {
+		if (f->until_end) {
+			count = at < len ? (len - at) / elem : 0;
+		}
+		return count > UINT64_MAX / elem ? UINT64_MAX : count * elem;
+	}
+	uint64_t index;
+	uint64_t start;
+	return tpl_element_at(t, data, len, f, at, count, UINT64_MAX, &index, &start) - at;
+}
+
+static void tpl_layout(struct template* t, const unsigned char* data, uint64_t len,
+                       int sid, uint64_t base, uint64_t* offsets) {
+	const struct tpl_struct* s = &t->structs[sid];
+	const struct tpl_field* members = &t->fields[s->first];
+	uint64_t at = base;
+	for (unsigned int i = 0; i < s->count; i++) {
+		offsets[i] = at;
+		uint64_t size = tpl_field_size(t, data, len, members, offsets, i);
+		at = size > UINT64_MAX - at ? UINT64_MAX : at + size;
+	}
+	offsets[s->count] = at;
+}
+
+/*
+ * Returns the cache of the array `field' at `base', evicting the one used
+ * longest ago if it is not cached yet.
+ */
+static struct tpl_cache* tpl_cache_get(struct template* t, int field, uint64_t base) {
+	struct tpl_cache* victim = &t->cache[0];
+	for (int i = 0; i < TPL_CACHE_SLOTS; i++) {
+		struct tpl_cache* c = &t->cache[i];
+		if (c->field == field && c->base == base) {
+			PERF_COUNT(PERF_CACHE_HITS, 1);
+			c->used = ++t->clock;
+			return c;
+		}
+		if (c->used < victim->used) {
+			victim = c;
+		}
+	}
+	PERF_COUNT(PERF_CACHE_MISSES, 1);
+	if (victim->offsets == NULL) {
+		victim->cap = 64;
+		victim->offsets = mem_alloc(MEM_INDEX, victim->cap * sizeof(uint64_t));
+		if (victim->offsets == NULL) {
+			perror("Could not allocate memory for the template");
+			abort();
+		}
+	}
+	victim->field = field;
+	victim->base = base;
+	victim->offsets[0] = base;
+	victim->known = 0;
+	victim->complete = false;
+	victim->used = ++t->clock;
+	return victim;
+}
+
+static void tpl_cache_push(struct tpl_cache* c, uint64_t end) {
+	if (c->known + 1 >= c->cap) {
+		c->cap *= 2;
+		c->offsets = mem_realloc(MEM_INDEX, c->offsets, c->cap * sizeof(uint64_t));
+		if (c->offsets == NULL) {
+			perror("Could not allocate memory for the template");
+			abort();
+		}
+	}
+	c->offsets[++c->known] = end;
+}
+
+/*
+ * Finds the element at `offset' of the array of `count' structs `f' of
+ * varying sizes at `base'. Sets `index' and `start' to the element, and
+ * returns where it ends. If the array ends before `offset', these are the
+ * amount of elements and the end of the array instead.
+ */
+static uint64_t tpl_element_at(struct template* t, const unsigned char* data, uint64_t len,
+                               const struct tpl_field* f, uint64_t base, uint64_t count,
+                               uint64_t offset, uint64_t* index, uint64_t* start) {
+	int sid = f->struct_id;
+	if (t->walking > 0) {
+		uint64_t i = 0;
+		uint64_t at = base;
+		while (i < count && at < len) {
+			uint64_t size = tpl_struct_size(t, data, len, sid, at);
+			if (size == 0) {
+				break;
+			}
+			uint64_t end = size > UINT64_MAX - at ? UINT64_MAX : at + size;
+			if (offset < end) {
+				*index = i;
+				*start = at;
+				return end;
+			}
+			at = end;
+			i++;
+		}
+		*index = i;
+		*start = at;
+		return at;
+	}
+
+	struct tpl_cache* c = tpl_cache_get(t, f - t->fields, base);
+	t->walking++;
+	while (!c->complete && c->offsets[c->known] <= offset) {
+		uint64_t at = c->offsets[c->known];
+		if (c->known >= count || at >= len) {
+			c->complete = true;
+			break;
+		}
+		uint64_t size = tpl_struct_size(t, data, len, sid, at);
+		if (size == 0) {
+			c->complete = true;
+			break;
+		}
+		tpl_cache_push(c, size > UINT64_MAX - at ? UINT64_MAX : at + size);
+	}
+	t->walking--;
+
+	uint64_t end = c->offsets[c->known];
+	if (offset >= end) {
+		*index = c->known;
+		*start = end;
+		return end;
+	}
+	// The last element starting at or before the offset.
+	uint64_t lo = 0;
+	uint64_t hi = c->known - 1;
+	while (lo < hi) {
+		uint64_t mid = lo + (hi - lo + 1) / 2;
+		if (c->offsets[mid] <= offset) {
+			lo = mid;
+		} else {
+			hi = mid - 1;
+		}
+	}
+	*index = lo;
+	*start = c->offsets[lo];
+	return c->offsets[lo + 1];
+}
+
+uint64_t template_size(struct template* t, const unsigned char* data, uint64_t len) {
+	return tpl_struct_size(t, data, len, t->root, 0);
+}
+
+bool template_find(struct template* t, const unsigned char* data, uint64_t len,
+                   uint64_t offset, struct template_path* path) {
+	path->depth = 0;
+	path->ordinal = 0;
+	if (offset >= len) {
+		return false;
+	}
+
+	int sid = t->root;
+	uint64_t base = 0;
+	uint64_t offsets[TEMPLATE_MAX_FIELDS + 1];
+	tpl_layout(t, data, len, sid, base, offsets);
+
+	struct template_level* level = &path->levels[path->depth++];
+	level->name = "";
+	level->type = t->structs[sid].name;
+	level->index = -1;
+	level->offset = 0;
+	level->size = offsets[t->structs[sid].count];
+
+	for (;;) {
+		const struct tpl_struct* s = &t->structs[sid];
+		const struct tpl_field* members = &t->fields[s->first];
+		unsigned int i = 0;
+		while (i < s->count && offsets[i + 1] <= offset) {
+			i++;
+		}
+		if (i == s->count || path->depth == TEMPLATE_MAX_DEPTH) {
+			return false;
+		}
+
+		const struct tpl_field* f = &members[i];
+		level = &path->levels[path->depth++];
+		level->name = f->name;
+		level->type = f->type;
+		level->index = -1;
+		level->offset = offsets[i];
+		level->size = offsets[i + 1] - offsets[i];
+		path->struct_id = sid;
+		path->struct_offset = base;
+		path->ordinal += i;
+
+		if (f->kind != TPL_STRUCT) {
+			// An array of numbers is shown as a single field.
+			if (f->array) {
+				level->index = (offset - offsets[i]) / f->width;
+			}
+			return true;
+		}
+
+		uint64_t start = offsets[i];
+		if (f->array) {
+			uint64_t index;
+			int64_t elem = t->structs[f->struct_id].size;
+			if (elem > 0) {
+				index = (offset - start) / elem;
+				start += index * elem;
+			} else {
+				uint64_t count = f->until_end ? UINT64_MAX : tpl_eval(t, data, len, f, members, offsets);
+				uint64_t end = tpl_element_at(t, data, len, f, start, count, offset, &index, &start);
+				if (offset >= end) {
+					return false;
+				}
+			}
+			// Numbering the fields of the elements one after the other.
+			level->index = index;
+			path->ordinal += index * t->structs[f->struct_id].count;
+		}
+		sid = f->struct_id;
+		base = start;
+		tpl_layout(t, data, len, sid, base, offsets);
+	}
+}
+
+/*
+ * Formats the type of field `f' of `size' bytes, with the amount of
+ * elements for an array.
+ */
+static void tpl_format_type(struct template* t, const unsigned char* data, uint64_t len,
+                            const struct tpl_field* members, const uint64_t* offsets,
+                            unsigned int i, char* buf, size_t buflen) {
+	const struct tpl_field* f = &members[i];
+	if (!f->array) {
+		snprintf(buf, buflen, "%s", f->type);
+		return;
+	}
+	uint64_t size = offsets[i + 1] - offsets[i];
+	int64_t elem = f->kind == TPL_STRUCT ? t->structs[f->struct_id].size : (int64_t) f->width;
+	uint64_t count = 0;
+	if (elem > 0) {
+		count = size / elem;
+	} else if (elem < 0) {
+		uint64_t n = f->until_end ? UINT64_MAX : tpl_eval(t, data, len, f, members, offsets);
+		uint64_t start;
+		tpl_element_at(t, data, len, f, offsets[i], n, UINT64_MAX, &count, &start);
+	}
+	snprintf(buf, buflen, "%s[%" PRIu64 "]", f->type, count);
+}
+
+/*
+ * Formats the value of field `f' of `size' bytes at `at': a number, or a
+ * preview of an array. Structs have no value of their own.
+ */
+static void tpl_format_value(const unsigned char* data, uint64_t len, const struct tpl_field* f,
+                             uint64_t at, uint64_t size, char* buf, size_t buflen) {
+	buf[0] = '\0';
+	if (f->kind == TPL_STRUCT || size == 0) {
+		return;
+	}
+	if (at >= len || (!f->array && len - at < f->width)) {
+		snprintf(buf, buflen, "?");
+		return;
+	}
+
+	if (f->array) {
+		uint64_t n = len - at < size ? len - at : size;
+		uint64_t i = 0;
+		size_t w = 0;
+		if (f->kind == TPL_CHAR) {
+			buf[w++] = '"';
+			for (; i < n && w + 5 < buflen; i++) {
+				buf[w++] = isprint(data[at + i]) ? data[at + i] : '.';
+			}
+			buf[w++] = '"';
+		} else {
+			for (; i < n && w + 7 < buflen; i++) {
+				w += snprintf(buf + w, buflen - w, "%s%02x", i > 0 ? " " : "", data[at + i]);
+			}
+		}
+		if (i < size) {
+			memcpy(buf + w, "...", 3);
+			w += 3;
+		}
+		buf[w] = '\0';
+		return;
+	}
+
+	uint64_t v = tpl_read(data, len, at, f);
+	switch (f->kind) {
+	case TPL_UNSIGNED:
+		snprintf(buf, buflen, "0x%" PRIx64 " (%" PRIu64 ")", v, v);
+		break;
+	case TPL_SIGNED:
+		snprintf(buf, buflen, "%" PRId64, tpl_signed(v, f->width));
+		break;
+	case TPL_FLOAT:
+		if (f->width == 4) {
+			uint32_t bits = (uint32_t) v;
+			float x;
+			memcpy(&x, &bits, sizeof(x));
+			snprintf(buf, buflen, "%g", x);
+		} else {
+			double x;
+			memcpy(&x, &v, sizeof(x));
+			snprintf(buf, buflen, "%g", x);
+		}
+		break;
+	default:
+		if (isprint((int) v)) {
+			snprintf(buf, buflen, "'%c'", (int) v);
+		} else {
+			snprintf(buf, buflen, "0x%02x", (unsigned int) v);
+		}
+		break;
+	}
+}
+
+unsigned int template_members(struct template* t, const unsigned char* data, uint64_t len,
+                              const struct template_path* path,
+                              struct template_member* members, unsigned int max) {
+	if (path->depth < 2) {
+		return 0;
+	}
+	const struct tpl_struct* s = &t->structs[path->struct_id];
+	const struct tpl_field* fields = &t->fields[s->first];
+	uint64_t offsets[TEMPLATE_MAX_FIELDS + 1];
+	tpl_layout(t, data, len, path->struct_id, path->struct_offset, offsets);
+
+	unsigned int n = 0;
+	for (unsigned int i = 0; i < s->count && n < max; i++) {
+		struct template_member* m = &members[n++];
+		m->name = fields[i].name;
+		m->offset = offsets[i];
+		m->size = offsets[i + 1] - offsets[i];
+		tpl_format_type(t, data, len, fields, offsets, i, m->type, sizeof(m->type));
+		tpl_format_value(data, len, &fields[i], m->offset, m->size, m->value, sizeof(m->value));
+	}
+	return n;
+}
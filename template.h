@@ -0,0 +1,121 @@
+/*
+ * This file is part of hx - a hex editor for the terminal.
+ *
+ * Copyright (c) 2016 Kevin Pors. See LICENSE for details.
+ */
+
+#ifndef HX_TEMPLATE_H
+#define HX_TEMPLATE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Structure templates describe the layout of a file format, so its fields
+ * can be shown on top of the hex view. A template is a text file like this:
+ *
+ *     # Frames of some protocol.
+ *     endian big
+ *     struct frame {
+ *         u8   type
+ *         u16  length
+ *         char payload[length - 3]
+ *     }
+ *     u32le magic
+ *     frame frames[]
+ *
+ * The fields outside of the structs make up the file itself, starting at
+ * offset 0. The types are u8 to u64, i8 to i64, f32, f64 and char, with an
+ * `le' or `be' suffix to override the endianness set with `endian', or a
+ * struct defined earlier. The count of an array is an expression of numbers,
+ * fields before it in the same struct, + - * / and parentheses. An array
+ * without a count repeats until the end of the data.
+ *
+ * Nothing is decoded up front. Looking up the field at an offset only lays
+ * out the structs on the way to it. Finding an element of an array of
+ * structs of varying sizes means sizing all elements before it, so the
+ * offsets of those are cached.
+ */
+
+// Maximum nesting of structs, including the file itself.
+#define TEMPLATE_MAX_DEPTH 16
+
+// Maximum amount of fields of a struct.
+#define TEMPLATE_MAX_FIELDS 64
+
+struct template;
+
+/*
+ * One level of the path to the field at an offset.
+ */
+struct template_level {
+	const char* name;   // name of the field, "" for the file itself.
+	const char* type;   // name of the type (of the elements, for an array).
+	int64_t  index;     // index of the element at the offset, or -1 if not an array.
+	uint64_t offset;    // offset of the field.
+	uint64_t size;      // size of the field.
+};
+
+/*
+ * The path from the file itself to the innermost field at an offset.
+ */
+struct template_path {
+	struct template_level levels[TEMPLATE_MAX_DEPTH];
+	unsigned int depth;   // amount of levels, the last one is the innermost field.
+	unsigned int ordinal; // numbers the fields, so neighbours differ in parity.
+
+	int      struct_id;     // the struct the innermost field is part of,
+	uint64_t struct_offset; // and its offset (see template_members).
+};
+
+/*
+ * A field of a struct, with its value formatted.
+ */
+struct template_member {
+	const char* name;
+	char     type[24];  // the type, like "u16be" or "frame[3]".
+	uint64_t offset;
+	uint64_t size;
+	char     value[40]; // the value of a number, or a preview of an array.
+};
+
+/*
+ * Loads the template at `path'. Returns NULL when it cannot be read or is
+ * invalid, with a message in `err'.
+ */
+struct template* template_load(const char* path, char* err, size_t errlen);
+
+/*
+ * Frees the template.
+ */
+void template_free(struct template* t);
+
+/*
+ * Forgets what was cached about the data. Must be called whenever the data
+ * changes.
+ */
+void template_invalidate(struct template* t);
+
+/*
+ * Returns the size of the file according to the template, for the `len'
+ * bytes of `data'.
+ */
+uint64_t template_size(struct template* t, const unsigned char* data, uint64_t len);
+
+/*
+ * Finds the innermost field at `offset' in the `len' bytes of `data'.
+ * Returns false if the offset is not covered by the template.
+ */
+bool template_find(struct template* t, const unsigned char* data, uint64_t len,
+                   uint64_t offset, struct template_path* path);
+
+/*
+ * Formats the fields of the struct the innermost field of `path' is part
+ * of, at most `max'. Returns the amount of fields.
+ */
+unsigned int template_members(struct template* t, const unsigned char* data, uint64_t len,
+                              const struct template_path* path,
+                              struct template_member* members, unsigned int max);
+
+#endif // HX_TEMPLATE_H
@@ -0,0 +1,165 @@
+/*
+ * This file is part of hx - a hex editor for the terminal.
+ *
+ * Copyright (c) 2016 Kevin Pors. See LICENSE for details.
+ */
+
+// clock_gettime() is part of POSIX.1-2008. The Makefile defines
+// _POSIX_SOURCE, which would otherwise limit us to POSIX.1.
+#define _XOPEN_SOURCE 700
+#define _POSIX_C_SOURCE 200809L
+
+#include "trace.h"
+
+#include <fcntl.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// Amount of events buffered per thread before they're written.
+#define TRACE_BUFFER_SIZE 4096
+
+static const char* trace_names[TRACE_EVENTS] = {
+	[TRACE_OPEN]    = "open",
+	[TRACE_LOAD]    = "load",
+	[TRACE_PAGE]    = "page",
+	[TRACE_RELOAD]  = "reload",
+	[TRACE_RENDER]  = "render",
+	[TRACE_SEARCH]  = "search",
+	[TRACE_SAVE]    = "save",
+	[TRACE_UNDO]    = "undo",
+	[TRACE_REDO]    = "redo",
+	[TRACE_ENTROPY] = "entropy",
+	[TRACE_STRINGS] = "strings",
+};
+
+/*
+ * The events of one thread, which are only touched by that thread.
+ */
+struct trace_buffer {
+	uint32_t thread;
+	unsigned int count;
+	struct trace_record records[TRACE_BUFFER_SIZE];
+};
+
+bool trace_enabled = false;
+
+static int trace_fd = -1;
+static pthread_key_t trace_key;    // the trace_buffer of every thread.
+static uint32_t trace_threads = 0; // amount of threads which recorded events.
+
+static void trace_flush(struct trace_buffer* buf) {
+	if (buf->count == 0 || trace_fd == -1) {
+		return;
+	}
+	// A single write, so the buffer is appended in one piece.
+	ssize_t len = buf->count * sizeof(struct trace_record);
+	if (write(trace_fd, buf->records, len) != len) {
+		// Keep going without tracing rather than interrupting the user.
+		__atomic_store_n(&trace_enabled, false, __ATOMIC_RELAXED);
+	}
+	buf->count = 0;
+}
+
+/*
+ * Called when a thread which recorded events exits.
+ */
+static void trace_thread_exit(void* arg) {
+	struct trace_buffer* buf = arg;
+	trace_flush(buf);
+	free(buf);
+}
+
+bool trace_open(const char* path) {
+	trace_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+	if (trace_fd == -1) {
+		return false;
+	}
+	ssize_t len = strlen(TRACE_MAGIC);
+	if (write(trace_fd, TRACE_MAGIC, len) != len
+	    || pthread_key_create(&trace_key, trace_thread_exit) != 0) {
+		close(trace_fd);
+		trace_fd = -1;
+		return false;
+	}
+	// Released after the file and the key, which the threads use then.
+	__atomic_store_n(&trace_enabled, true, __ATOMIC_RELEASE);
+	return true;
+}
+
+void trace_close() {
+	if (trace_fd == -1) {
+		return;
+	}
+	struct trace_buffer* buf = pthread_getspecific(trace_key);
+	if (buf != NULL) {
+		trace_flush(buf);
+	}
+	__atomic_store_n(&trace_enabled, false, __ATOMIC_RELAXED);
+	close(trace_fd);
+	trace_fd = -1;
+}
+
+void trace_record(enum trace_event event, char phase) {
+	struct trace_buffer* buf = pthread_getspecific(trace_key);
+	if (buf == NULL) {
+		buf = malloc(sizeof(struct trace_buffer));
+		if (buf == NULL) {
+			return;
+		}
+		buf->thread = __atomic_add_fetch(&trace_threads, 1, __ATOMIC_RELAXED);
+		buf->count = 0;
+		pthread_setspecific(trace_key, buf);
+	}
+
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	struct trace_record* r = &buf->records[buf->count++];
+	r->ns = (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+	r->thread = buf->thread;
+	r->event = event;
+	r->phase = phase;
+	r->unused = 0;
+
+	if (buf->count == TRACE_BUFFER_SIZE) {
+		trace_flush(buf);
+	}
+}
+
+bool trace_convert(const char* path, FILE* out) {
+	FILE* fp = fopen(path, "rb");
+	if (fp == NULL) {
+		return false;
+	}
+	char magic[sizeof(TRACE_MAGIC)] = {0};
+	if (fread(magic, 1, strlen(TRACE_MAGIC), fp) != strlen(TRACE_MAGIC)
+	    || strcmp(magic, TRACE_MAGIC) != 0) {
+		fclose(fp);
+		return false;
+	}
+
+	// Timestamps are made relative to the first event.
+	fprintf(out, "{\"traceEvents\":[\n");
+	struct trace_record r;
+	uint64_t first = 0;
+	bool any = false;
+	while (fread(&r, sizeof(r), 1, fp) == 1) {
+		if (r.event >= TRACE_EVENTS || (r.phase != 'B' && r.phase != 'E')) {
+			continue;
+		}
+		if (!any) {
+			first = r.ns;
+		}
+		uint64_t ns = r.ns > first ? r.ns - first : 0;
+		fprintf(out, "%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%" PRIu64 ".%03u,\"pid\":1,\"tid\":%" PRIu32 "}",
+			any ? ",\n" : "", trace_names[r.event], r.phase,
+			ns / 1000, (unsigned int) (ns % 1000), r.thread);
+		any = true;
+	}
+	fprintf(out, "\n],\"displayTimeUnit\":\"ms\"}\n");
+	fclose(fp);
+	return true;
+}
@@ -0,0 +1,94 @@
+/*
+ * This file is part of hx - a hex editor for the terminal.
+ *
+ * Copyright (c) 2016 Kevin Pors. See LICENSE for details.
+ */
+
+#ifndef HX_TRACE_H
+#define HX_TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Event tracing, to find out where the time goes when hx stalls: timestamped
+ * begin and end events of opening, loading, rendering, searching, saving and
+ * so on are written to a binary trace file (see hx --trace).
+ *
+ * Every thread records its events in a buffer of its own, so recording takes
+ * no locks. A thread writes its buffer to the file with a single write when
+ * it's full, when the thread exits, and (for the main thread) at the end. The
+ * file is opened with O_APPEND, so buffers of different threads never mix.
+ *
+ * The trace file starts with TRACE_MAGIC, followed by struct trace_record
+ * entries in the byte order of the machine. Use trace_convert() (hx
+ * --trace-json) to turn it into JSON for a trace viewer like the one in
+ * Chrome (chrome://tracing) or Perfetto.
+ */
+
+#define TRACE_MAGIC "hx-trace 1\n"
+
+enum trace_event {
+	TRACE_OPEN,    // opening the file, device or process.
+	TRACE_LOAD,    // reading a window of the file (or process) into the buffer.
+	TRACE_PAGE,    // reading a stale page of process memory again.
+	TRACE_RELOAD,  // reloading the changed parts of the file.
+	TRACE_RENDER,  // rendering and drawing a frame.
+	TRACE_SEARCH,  // searching the buffer.
+	TRACE_SAVE,    // writing the buffer.
+	TRACE_UNDO,    // undoing an action.
+	TRACE_REDO,    // redoing an action.
+	TRACE_ENTROPY, // computing block statistics (worker threads).
+	TRACE_STRINGS, // extracting strings (worker threads).
+	TRACE_EVENTS,  // amount of events.
+};
+
+struct trace_record {
+	uint64_t ns;     // monotonic clock, in nanoseconds.
+	uint32_t thread; // the thread, numbered from 1 in order of first event.
+	uint16_t event;  // enum trace_event.
+	uint8_t  phase;  // 'B' for begin, 'E' for end.
+	uint8_t  unused;
+};
+
+// Whether events are recorded. Read and written atomically, since it's
+// turned off on whichever thread fails to write its events.
+extern bool trace_enabled;
+
+#define TRACE_BEGIN(event) do { \
+	if (__atomic_load_n(&trace_enabled, __ATOMIC_ACQUIRE)) { \
+		trace_record((event), 'B'); \
+	} \
+} while (0)
+
+#define TRACE_END(event) do { \
+	if (__atomic_load_n(&trace_enabled, __ATOMIC_ACQUIRE)) { \
+		trace_record((event), 'E'); \
+	} \
+} while (0)
+
+/*
+ * Starts tracing to `path'. Returns false if the file cannot be created,
+ * with errno set.
+ */
+bool trace_open(const char* path);
+
+/*
+ * Writes the events of the calling thread and stops tracing.
+ */
+void trace_close();
+
+/*
+ * Records an event of the calling thread. Use TRACE_BEGIN and TRACE_END,
+ * which do nothing when tracing is disabled.
+ */
+void trace_record(enum trace_event event, char phase);
+
+/*
+ * Converts the trace file `path' to the JSON trace event format on `out'.
+ * Returns false if it's not a trace file.
+ */
+bool trace_convert(const char* path, FILE* out);
+
+#endif // HX_TRACE_H
@@ -5,6 +5,7 @@
  */
 
 #include "undo.h"
+#include "mem.h"
 
 #include <stdlib.h>
 #include <stdio.h>
@@ -24,7 +25,7 @@ const char* action_type_name(enum action_type type) {
 
 
 struct action_list* action_list_init() {
-	struct action_list* list = malloc(sizeof(struct action_list));
+	struct action_list* list = mem_alloc(MEM_UNDO, sizeof(struct action_list));
 	if (list == NULL) {
 		perror("Could not allocate memory for action list");
 		abort();
@@ -32,13 +33,15 @@ struct action_list* action_list_init() {
 	list->head = NULL;
 	list->tail = NULL;
 	list->curr = NULL;
+	// Actions are small and numerous, so they're allocated in bulk.
+	mem_pool_init(&list->pool, MEM_UNDO, sizeof(struct action), 256);
 	return list;
 }
 
 void action_list_add(struct action_list* list, enum action_type type, int offset, unsigned char c) {
 	assert(list != NULL);
 
-	struct action* action = malloc(sizeof(struct action));
+	struct action* action = mem_pool_get(&list->pool);
 	if (action == NULL) {
 		perror("Could not allocate memory for action");
 		abort();
@@ -108,7 +111,7 @@ void action_list_delete(struct action_list* list, struct action* action) {
 		struct action* temp = node;
 		if (list->curr == temp) curr_removed = true;
 		node = temp->next;
-		free(temp);
+		mem_pool_put(&list->pool, temp);
 		temp = NULL;
 	}
 
@@ -129,16 +132,9 @@ void action_list_delete(struct action_list* list, struct action* action) {
 void action_list_free(struct action_list* list) {
 	assert(list != NULL);
 
-	struct action* node = list->head;
-	while (node != NULL) {
-		struct action* temp = node;
-		node = node->next;
-		free(temp);
-	}
-	// after removing all linked nodes from the head,
-	// dont forget to remove the head as well:
-	free(node);
-	free(list);
+	// All actions go at once with the pool.
+	mem_pool_release(&list->pool);
+	mem_free(list);
 }
 
 
@@ -7,6 +7,8 @@
 #ifndef HX_UNDO_H
 #define HX_UNDO_H
 
+#include "mem.h"
+
 /*
  * Contains definitions and functions to allow undo/redo actions.
  * It's basically a double-linked list, where the tail is the last
@@ -64,6 +66,7 @@ struct action_list {
 	struct action* curr;  // Current position within the list.
 	enum curr_pos curr_status; // Meta position of curr.
 	struct action* tail;  // Tail/end of the list.
+	struct mem_pool pool; // where the actions are allocated from.
 };
 
 /*
@@ -4,6 +4,7 @@
  * Copyright (c) 2016 Kevin Pors. See LICENSE for details.
  */
 #include "util.h"
+#include "perf.h"
 
 #include <ctype.h>
 #include <errno.h>
@@ -21,6 +22,13 @@
 // data garbling. See enable/disable_raw_mode().
 static struct termios orig_termios;
 
+// Key codes are read from replay_fd instead of stdin when it's not -1, and
+// written to record_fd when that's not -1. See read_key_replay() and
+// read_key_record().
+static int  replay_fd = -1;
+static int  record_fd = -1;
+static bool exit_at_end = false;
+
 int hex2bin(const char* s) {
 	int ret=0;
 	for(int i = 0; i < 2; i++) {
@@ -90,14 +98,23 @@ int str2int(const char* s, int min, int max, int def) {
 	return x;
 }
 
+void read_key_replay(int fd, bool exit_at_end_of_input) {
+	replay_fd = fd;
+	exit_at_end = exit_at_end_of_input;
+}
+
+void read_key_record(int fd) {
+	record_fd = fd;
+}
+
 /*
  * Reads keypresses from stdin, and processes them accordingly. Escape sequences
  * will be read properly as well (e.g. DEL will be the bytes 0x1b, 0x5b, 0x33, 0x7e).
  * The returned integer will contain either one of the enum values, or the key pressed.
  *
- * read_key() will only return the correct key code, or -1 when anything fails.
+ * read_key_stdin() will only return the correct key code, or -1 when anything fails.
  */
-int read_key() {
+static int read_key_stdin() {
 	char c;
 	ssize_t nread;
 	// check == 0 to see if EOF.
@@ -177,11 +194,47 @@ int read_key() {
 	return c;
 }
 
+int read_key() {
+	int c = -1;
+	if (replay_fd != -1) {
+		// Recorded key codes are two bytes, little endian.
+		unsigned char code[2];
+		ssize_t nread = read(replay_fd, code, sizeof(code));
+		if (nread == -1 && errno == EINTR) {
+			return -1;
+		}
+		if (nread == sizeof(code)) {
+			c = code[0] | code[1] << 8;
+		} else if (exit_at_end) {
+			// End of the recording.
+			exit(0);
+		} else {
+			close(replay_fd);
+			replay_fd = -1;
+		}
+	}
+	if (replay_fd == -1) {
+		c = read_key_stdin();
+	}
+	if (c != -1) {
+		perf_key_read();
+	}
+
+	if (c != -1 && record_fd != -1) {
+		unsigned char code[2] = { c & 0xff, (c >> 8) & 0xff };
+		if (write(record_fd, code, sizeof(code)) != sizeof(code)) {
+			// Stop recording rather than writing a corrupt recording.
+			close(record_fd);
+			record_fd = -1;
+		}
+	}
+	return c;
+}
+
 bool get_window_size(int* rows, int* cols) {
 	struct winsize ws;
 	if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) != 0) {
-		perror("Failed to query terminal size");
-		exit(1);
+		return false;
 	}
 
 	*rows = ws.ws_row;
@@ -250,8 +303,47 @@ void clear_screen() {
 	// clear the colors, move the cursor up-left, clear the screen.
 	char stuff[80];
 	int bw = snprintf(stuff, 80, "\x1b[0m\x1b[H\x1b[2J");
+	PERF_COUNT(PERF_SYSCALLS, 1);
 	if (write(STDOUT_FILENO, stuff, bw) == -1) {
 		perror("Unable to clear screen");
 	}
 }
 
+// Number of bytes compared at once by the run scanners: four words, which
+// compilers turn into vector compares where available.
+#define RUN_STRIDE (4 * sizeof(uint64_t))
+
+/*
+ * Returns true if the RUN_STRIDE bytes at `p' all equal the byte repeated in
+ * `pattern'. memcpy() is used since `p' may not be aligned.
+ */
+static inline bool run_stride_equal(const char* p, uint64_t pattern) {
+	uint64_t w[4];
+	memcpy(w, p, sizeof(w));
+	return ((w[0] ^ pattern) | (w[1] ^ pattern) | (w[2] ^ pattern) | (w[3] ^ pattern)) == 0;
+}
+
+size_t run_length(const char* p, size_t len, unsigned char byte) {
+	uint64_t pattern = UINT64_C(0x0101010101010101) * byte;
+	size_t i = 0;
+	while (i + RUN_STRIDE <= len && run_stride_equal(p + i, pattern)) {
+		i += RUN_STRIDE;
+	}
+	// The run ends somewhere in the next stride (if any).
+	while (i < len && (unsigned char) p[i] == byte) {
+		i++;
+	}
+	return i;
+}
+
+size_t run_length_back(const char* p, size_t len, unsigned char byte) {
+	uint64_t pattern = UINT64_C(0x0101010101010101) * byte;
+	size_t i = len;
+	while (i >= RUN_STRIDE && run_stride_equal(p + i - RUN_STRIDE, pattern)) {
+		i -= RUN_STRIDE;
+	}
+	while (i > 0 && (unsigned char) p[i - 1] == byte) {
+		i--;
+	}
+	return len - i;
+}
@@ -8,6 +8,7 @@
 #define HX_UTIL_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <termios.h>
 
 // Key enumeration, returned by read_key().
@@ -17,6 +18,8 @@ enum key_codes {
 	KEY_CTRL_D    = 0x04,
 	KEY_CTRL_F    = 0x06,
 	KEY_CTRL_H    = 0x08,
+	KEY_CTRL_I    = 0x09, // TAB, to go forward in the jump list.
+	KEY_CTRL_O    = 0x0f, // SI, to go back in the jump list.
 	KEY_CTRL_Q    = 0x11, // DC1, to exit the program.
 	KEY_CTRL_R    = 0x12, // DC2, to redo an action.
 	KEY_CTRL_S    = 0x13, // DC3, to save the current buffer.
@@ -66,7 +69,26 @@ void enable_raw_mode();
 void disable_raw_mode();
 void clear_screen();
 int  read_key();
+
+/*
+ * Makes read_key() return the key codes recorded in `fd' by read_key_record()
+ * instead of reading stdin. At the end of the recording, read_key() continues
+ * with stdin, or exits the program when `exit_at_end_of_input' is set.
+ */
+void read_key_replay(int fd, bool exit_at_end_of_input);
+
+/*
+ * Makes read_key() write every key code it returns to `fd' as well, to record
+ * the session. Pass -1 to stop recording.
+ */
+void read_key_record(int fd);
+
 int  hex2bin(const char* s);
+
+/*
+ * Queries the size of the terminal on stdout into `rows' and `cols'. Returns
+ * false (leaving both untouched) when stdout is not a terminal.
+ */
 bool get_window_size(int* rows, int* cols);
 
 /*
@@ -99,4 +121,17 @@ int clampi(int i, int min, int max);
  */
 int str2int(const char* s, int min, int max, int def);
 
+/*
+ * Returns the amount of bytes equal to `byte' at the start of the `len' bytes
+ * at `p', i.e. the length of the run of `byte' starting at `p'. The bytes
+ * are compared a word at a time, so long runs are skipped quickly.
+ */
+size_t run_length(const char* p, size_t len, unsigned char byte);
+
+/*
+ * Like run_length(), but returns the length of the run of `byte' ending at
+ * the last of the `len' bytes at `p'.
+ */
+size_t run_length_back(const char* p, size_t len, unsigned char byte);
+
 #endif // HX_UTIL_H
@@ -0,0 +1,148 @@
+/*
+ * This file is part of hx - a hex editor for the terminal.
+ *
+ * Copyright (c) 2016 Kevin Pors. See LICENSE for details.
+ */
+
+// inotify, F_SETOWN and O_ASYNC are not part of plain POSIX.
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
+
+#include "watch.h"
+#include "mem.h"
+
+#ifdef __linux__
+
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+// Events on the file itself which indicate a change of the contents, or
+// that the file we were watching is gone (deleted or renamed over).
+#define WATCH_FILE_MASK (IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF)
+// Events on the parent directory which may mean our file was (re)created.
+#define WATCH_DIR_MASK  (IN_CREATE | IN_MOVED_TO | IN_CLOSE_WRITE)
+
+static int   watch_fd = -1;       // the inotify instance.
+static int   watch_wd_file = -1;  // watch descriptor of the file.
+static int   watch_wd_dir = -1;   // watch descriptor of the parent directory.
+static char* watch_path = NULL;   // the path of the file being watched.
+static char* watch_base = NULL;   // points to the base name inside watch_path.
+
+bool watch_file(const char* filename) {
+	watch_close();
+
+	watch_fd = inotify_init();
+	if (watch_fd == -1) {
+		return false;
+	}
+
+	// Deliver a SIGIO to this process as soon as events are available.
+	int flags = fcntl(watch_fd, F_GETFL);
+	if (fcntl(watch_fd, F_SETOWN, getpid()) == -1
+	    || fcntl(watch_fd, F_SETFL, flags | O_ASYNC | O_NONBLOCK) == -1) {
+		watch_close();
+		return false;
+	}
+
+	watch_path = mem_alloc(MEM_OTHER, strlen(filename) + 1);
+	if (watch_path == NULL) {
+		perror("Could not allocate memory for the watched path");
+		abort();
+	}
+	strcpy(watch_path, filename);
+
+	// Split the path in a directory and the base name. The directory is
+	// watched to detect files being replaced by a rename.
+	char* slash = strrchr(watch_path, '/');
+	if (slash == NULL) {
+		watch_base = watch_path;
+		watch_wd_dir = inotify_add_watch(watch_fd, ".", WATCH_DIR_MASK);
+	} else {
+		watch_base = slash + 1;
+		*slash = '\0';
+		watch_wd_dir = inotify_add_watch(watch_fd, slash == watch_path ? "/" : watch_path, WATCH_DIR_MASK);
+		*slash = '/';
+	}
+
+	// The file may not exist yet (new file), which is fine. The directory
+	// watch will notice when it's created.
+	watch_wd_file = inotify_add_watch(watch_fd, watch_path, WATCH_FILE_MASK);
+
+	return watch_wd_file != -1 || watch_wd_dir != -1;
+}
+
+bool watch_poll() {
+	if (watch_fd == -1) {
+		return false;
+	}
+
+	// Buffer aligned for struct inotify_event, as recommended by inotify(7).
+	char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	bool changed = false;
+	bool rearm = false;
+
+	ssize_t nread;
+	while ((nread = read(watch_fd, buf, sizeof(buf))) > 0) {
+		for (char* ptr = buf; ptr < buf + nread; ) {
+			const struct inotify_event* ev = (const struct inotify_event*) ptr;
+			ptr += sizeof(struct inotify_event) + ev->len;
+
+			if (ev->wd == watch_wd_file) {
+				if (ev->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+					rearm = true;
+				}
+				changed = true;
+			} else if (ev->wd == watch_wd_dir && ev->len > 0
+			           && strcmp(ev->name, watch_base) == 0) {
+				// Our file was created or replaced in the directory.
+				rearm = true;
+				changed = true;
+			}
+		}
+	}
+
+	if (rearm) {
+		// The inode we were watching is gone. Watch whatever currently
+		// lives at the path (if anything).
+		if (watch_wd_file != -1) {
+			inotify_rm_watch(watch_fd, watch_wd_file);
+		}
+		watch_wd_file = inotify_add_watch(watch_fd, watch_path, WATCH_FILE_MASK);
+	}
+
+	return changed;
+}
+
+void watch_close() {
+	if (watch_fd != -1) {
+		close(watch_fd);
+	}
+	watch_fd = -1;
+	watch_wd_file = -1;
+	watch_wd_dir = -1;
+	mem_free(watch_path);
+	watch_path = NULL;
+	watch_base = NULL;
+}
+
+#else
+
+bool watch_file(const char* filename) {
+	(void) filename;
+	return false;
+}
+
+bool watch_poll() {
+	return false;
+}
+
+void watch_close() {
+}
+
+#endif
@@ -0,0 +1,42 @@
+/*
+ * This file is part of hx - a hex editor for the terminal.
+ *
+ * Copyright (c) 2016 Kevin Pors. See LICENSE for details.
+ */
+
+#ifndef HX_WATCH_H
+#define HX_WATCH_H
+
+#include <stdbool.h>
+
+/*
+ * Watching a file for modifications by other processes. On Linux this is
+ * implemented using inotify. The inotify file descriptor is put in async
+ * mode, so the kernel sends a SIGIO to the process whenever an event is
+ * queued. Like SIGWINCH, that signal interrupts the blocking read() in
+ * read_key(), so the main loop can react on it by calling watch_poll().
+ *
+ * On other platforms these functions are no-ops, and watch_file() will
+ * return false.
+ */
+
+/*
+ * Starts watching `filename' for changes. The directory containing the file
+ * is watched as well, so we can keep track of the file when it is replaced
+ * (i.e. written to a temp file and renamed), which many tools do. Returns
+ * false if watching is not possible.
+ */
+bool watch_file(const char* filename);
+
+/*
+ * Drains all pending events and returns true when the watched file was
+ * modified, replaced or deleted since the last call.
+ */
+bool watch_poll();
+
+/*
+ * Stops watching and releases the resources.
+ */
+void watch_close();
+
+#endif // HX_WATCH_H